@@ -44,7 +44,7 @@
 #define LLPC_INTERFACE_MAJOR_VERSION 38
 
 /// LLPC minor interface version.
-#define LLPC_INTERFACE_MINOR_VERSION 1
+#define LLPC_INTERFACE_MINOR_VERSION 10
 
 #ifndef LLPC_CLIENT_INTERFACE_MAJOR_VERSION
 #if VFX_INSIDE_SPVGEN
@@ -64,6 +64,14 @@
 //* %Version History
 //* | %Version | Change Description                                                                                    |
 //* | -------- | ----------------------------------------------------------------------------------------------------- |
+//* |    38.10 | Added pfnGetValueV2Func, pfnReleaseValueFunc and pfnStoreValueAsyncFunc to ShaderCacheCreateInfo      |
+//* |     38.9 | Added CompactShaderCache to ICompiler and GetPipelineCacheHash to IPipelineDumper                     |
+//* |     38.8 | Added GetShaderCacheStats to ICompiler and GetStats to IShaderCache                                   |
+//* |     38.7 | Added BuildGraphicsPipelineView and BuildComputePipelineView to ICompiler                             |
+//* |     38.6 | Added BuildGraphicsPipelineFast and BuildComputePipelineFast to ICompiler                             |
+//* |     38.5 | Added BuildGraphicsPipelines to ICompiler                                                             |
+//* |     38.4 | Added asynchronous pipeline builds with BuildGraphicsPipelineAsync and BuildComputePipelineAsync      |
+//* |     38.3 | Added GetContextPoolStats to ICompiler                                                                |
 //* |     38.2 | Added scalarThreshold to PipelineShaderOptions                                                        |
 //* |     38.1 | Added unrollThreshold to PipelineShaderOptions                                                        |
 //* |     38.0 | Removed CreateShaderCache in ICompiler and pShaderCache in pipeline build info                        |
@@ -507,6 +515,30 @@ public:
     /// @returns Hash code associated this compute pipeline.
     static uint64_t VKAPI_CALL GetPipelineHash(const ComputePipelineBuildInfo* pPipelineInfo);
 
+    /// Calculates the hash code that the shader cache keys a graphics pipeline by, from the shader binaries of its
+    /// stages, without building their shader modules. The pModuleData of the shader infos is ignored.
+    ///
+    /// @param [in]  pPipelineInfo  Info to build this graphics pipeline
+    /// @param [in]  pShaderBins    Shader binaries, indexed by graphics shader stage (empty for absent stages)
+    /// @param [in]  trimDebugInfo  Whether the compiler trims debug instructions from the shader binaries it caches
+    ///
+    /// @returns Cache hash code associated this graphics pipeline.
+    static uint64_t VKAPI_CALL GetPipelineCacheHash(const GraphicsPipelineBuildInfo* pPipelineInfo,
+                                                    const BinaryData*                pShaderBins,
+                                                    bool                             trimDebugInfo);
+
+    /// Calculates the hash code that the shader cache keys a compute pipeline by, from the shader binary of its
+    /// compute shader, without building its shader module. The pModuleData of the shader info is ignored.
+    ///
+    /// @param [in]  pPipelineInfo  Info to build this compute pipeline
+    /// @param [in]  pShaderBin     Compute shader binary
+    /// @param [in]  trimDebugInfo  Whether the compiler trims debug instructions from the shader binaries it caches
+    ///
+    /// @returns Cache hash code associated this compute pipeline.
+    static uint64_t VKAPI_CALL GetPipelineCacheHash(const ComputePipelineBuildInfo* pPipelineInfo,
+                                                    const BinaryData*               pShaderBin,
+                                                    bool                            trimDebugInfo);
+
     /// Gets graphics pipeline name.
     ///
     /// @param [in]  pPipelineInfo  Info to build this graphics pipeline
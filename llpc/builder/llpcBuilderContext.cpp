@@ -216,6 +216,13 @@ void BuilderContext::PreparePassManager(
     pPassMgr->add(pTargetLibInfoPass);
 }
 
+// =====================================================================================================================
+// Returns true if the target passes stop early to emit LLVM IR, because of "-emit-llvm" or "-emit-llvm-bc"
+bool BuilderContext::EmittingLlvmIr()
+{
+    return EmitLlvm || EmitLlvmBc;
+}
+
 // =====================================================================================================================
 // Adds target passes to pass manager, depending on "-filetype" and "-emit-llvm" options
 void BuilderContext::AddTargetPasses(
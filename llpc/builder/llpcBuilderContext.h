@@ -105,9 +105,15 @@ public:
     // Adds target passes to pass manager, depending on "-filetype" and "-emit-llvm" options
     void AddTargetPasses(Llpc::PassManager& passMgr, Timer* pCodeGenTimer, raw_pwrite_stream& outStream);
 
+    // Returns true if the target passes stop early to emit LLVM IR, because of "-emit-llvm" or "-emit-llvm-bc"
+    static bool EmittingLlvmIr();
+
     void SetBuildRelocatableElf(bool buildRelocatableElf) { m_buildRelocatableElf = buildRelocatableElf; }
     bool BuildingRelocatableElf() { return m_buildRelocatableElf; }
 
+    void SetGenericColorExport(bool genericColorExport) { m_genericColorExport = genericColorExport; }
+    bool GenericColorExport() { return m_genericColorExport; }
+
     // Utility method to create a start/stop timer pass
     static ModulePass* CreateStartStopTimer(Timer* pTimer, bool starting);
 
@@ -132,6 +138,8 @@ private:
     TargetMachine*             m_pTargetMachine = nullptr;    // Target machine
     TargetInfo*                m_pTargetInfo = nullptr;       // Target info
     bool                       m_buildRelocatableElf = false; // Flag indicating whether we are building relocatable ELF
+    bool                       m_genericColorExport = false;  // Flag indicating whether fragment color outputs are
+                                                              //  exported without regard to the color target formats
 };
 
 } // Llpc
@@ -347,20 +347,27 @@ void BuilderImplInOut::MarkGenericInputOutputUsage(
         }
     }
 
-    if ((isOutput == false) || (m_shaderStage != ShaderStageGeometry))
+    // NOTE: When building relocatable ELF, the outputs of the last pre-rasterization stage and the inputs of the
+    // fragment shader are not matched against each other. All locations below the ones used are kept on both sides,
+    // so that they are mapped to themselves.
+    bool keepAllLocations = false;
+    if (GetBuilderContext()->BuildingRelocatableElf())
     {
-        bool keepAllLocations = false;
-        if (GetBuilderContext()->BuildingRelocatableElf())
+        // NOTE: The rasterization stream of GS is not known yet, so locations are kept for all streams.
+        if (isOutput &&
+            (m_shaderStage != ShaderStageFragment) &&
+            (GetPipelineState()->GetNextShaderStage(m_shaderStage) == ShaderStageInvalid))
         {
-            if (m_shaderStage == ShaderStageVertex && isOutput)
-            {
-                keepAllLocations = true;
-            }
-            if (m_shaderStage == ShaderStageFragment && !isOutput)
-            {
-                keepAllLocations = true;
-            }
+            keepAllLocations = true;
+        }
+        if (m_shaderStage == ShaderStageFragment && !isOutput)
+        {
+            keepAllLocations = true;
         }
+    }
+
+    if ((isOutput == false) || (m_shaderStage != ShaderStageGeometry))
+    {
         uint32_t startLocation = (keepAllLocations ? 0 : location);
         // Non-GS-output case.
         for (uint32_t i = startLocation; i < location + locationCount; ++i)
@@ -371,10 +378,11 @@ void BuilderImplInOut::MarkGenericInputOutputUsage(
     else
     {
         // GS output. We include the stream ID with the location in the map key.
-        for (uint32_t i = 0; i < locationCount; ++i)
+        uint32_t startLocation = (keepAllLocations ? 0 : location);
+        for (uint32_t i = startLocation; i < location + locationCount; ++i)
         {
             GsOutLocInfo outLocInfo = {};
-            outLocInfo.location = location + i;
+            outLocInfo.location = i;
             outLocInfo.streamId = inOutInfo.GetStreamId();
             (*pInOutLocMap)[outLocInfo.u32All] = InvalidValue;
         }
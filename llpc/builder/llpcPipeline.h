@@ -94,6 +94,8 @@ struct Options
     NggSubgroupSizingType nggSubgroupSizing;       // NGG subgroup sizing type
     uint32_t              nggVertsPerSubgroup;     // How to determine NGG verts per subgroup
     uint32_t              nggPrimsPerSubgroup;     // How to determine NGG prims per subgroup
+    uint32_t              fastCompile;             // If set, only a minimal set of optimizations is run, for a fast
+                                                   //   build at the expense of shader performance
 };
 
 // Middle-end per-shader options to pass to SetShaderOptions.
@@ -530,19 +532,35 @@ public:
     typedef std::function<uint32_t(
         const Module*               pModule,      // [in] Module
         uint32_t                    stageMask,    // Shader stage mask
-        ArrayRef<ArrayRef<uint8_t>> stageHashes   // Per-stage hash of in/out usage
+        ArrayRef<uint64_t>          stageHashes,  // Per-stage inter-shader data tracking hash
+        uint32_t                    hashStageMask // Mask of shader stages that have an inter-shader data tracking hash
     )> CheckShaderCacheFunc;
 
+    // Typedef of function passed in to Generate to run a task asynchronously, e.g. as a job on a thread pool of the
+    // front-end. Returns a function that waits for the task to finish, running it on the calling thread if it has not
+    // been started yet.
+    typedef std::function<std::function<void()>(
+        std::function<void()>       task          // Task to run
+    )> RunAsyncFunc;
+
     // Generate pipeline module by running patch, middle-end optimization and backend codegen passes.
     // The output is normally ELF, but IR disassembly if an option is used to stop compilation early.
     // Output is written to outStream.
+    // If pFragmentOutStream is not nullptr, and the pipeline has a fragment shader as well as other hardware
+    // stages, the fragment shader may be split out and code-generated as a task run by runAsyncFunc concurrently
+    // with the rest of the pipeline. Its output is then written to pFragmentOutStream, and the front-end is
+    // responsible for merging it with the output written to outStream.
     // Like other Builder methods, on error, this calls report_fatal_error, which you can catch by setting
     // a diagnostic handler with LLVMContext::setDiagnosticHandler.
     virtual void Generate(
         std::unique_ptr<Module>   pipelineModule,       // IR pipeline module
         raw_pwrite_stream&        outStream,            // [in/out] Stream to write ELF or IR disassembly output
         CheckShaderCacheFunc      checkShaderCacheFunc, // Function to check shader cache in graphics pipeline
-        ArrayRef<Timer*>          timers) = 0;          // Timers for: patch passes, llvm optimizations, codegen
+        ArrayRef<Timer*>          timers,               // Timers for: patch passes, llvm optimizations, codegen
+        raw_pwrite_stream*        pFragmentOutStream,   // [in/out] Stream to write separately generated fragment
+                                                        //    shader output, or nullptr to disallow
+        RunAsyncFunc              runAsyncFunc) = 0;    // Function to run the fragment shader code generation
+                                                        //    asynchronously
 
     // -----------------------------------------------------------------------------------------------------------------
     // Non-compiling methods
@@ -37,7 +37,12 @@
 #include "llpcPatch.h"
 #include "llpcPipelineState.h"
 #include "llpcTargetInfo.h"
+#include "llvm/ADT/ScopeExit.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Linker/Linker.h"
@@ -183,17 +188,149 @@ Module* PipelineState::Link(
     return pPipelineModule;
 }
 
+// =====================================================================================================================
+// Returns true if the function is the entry-point of a hardware shader stage, as identified by its calling convention.
+static bool IsShaderEntryPoint(
+    const Function& func)   // [in] Function to check
+{
+    if (func.isDeclaration())
+    {
+        return false;
+    }
+
+    switch (func.getCallingConv())
+    {
+    case CallingConv::AMDGPU_LS:
+    case CallingConv::AMDGPU_HS:
+    case CallingConv::AMDGPU_ES:
+    case CallingConv::AMDGPU_GS:
+    case CallingConv::AMDGPU_VS:
+    case CallingConv::AMDGPU_PS:
+    case CallingConv::AMDGPU_CS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// =====================================================================================================================
+// Returns true if the patched pipeline module has a fragment shader and at least one other hardware stage, so the
+// fragment shader can be code-generated separately from the rest of the pipeline.
+static bool CanSplitFragmentShader(
+    const Module& module)   // [in] Patched pipeline module
+{
+    bool hasFragment = false;
+    bool hasNonFragment = false;
+    for (const Function& func : module)
+    {
+        if (IsShaderEntryPoint(func))
+        {
+            if (func.getCallingConv() == CallingConv::AMDGPU_PS)
+            {
+                hasFragment = true;
+            }
+            else
+            {
+                hasNonFragment = true;
+            }
+        }
+    }
+    return hasFragment && hasNonFragment;
+}
+
+// =====================================================================================================================
+// Remove the body of either the fragment shader entry-point, or of all the other hardware stage entry-points, so
+// that codegen on the module only generates code for the remaining ones. The PAL metadata in the module is left
+// alone; the front-end picks the fragment shader parts of it out of the fragment shader ELF when merging.
+static void RemoveShaderEntryPoints(
+    Module& module,         // [in/out] Patched pipeline module
+    bool    removeFragment) // True to remove the fragment shader, false to remove all other hardware stages
+{
+    for (Function& func : module)
+    {
+        if (IsShaderEntryPoint(func) && ((func.getCallingConv() == CallingConv::AMDGPU_PS) == removeFragment))
+        {
+            func.deleteBody();
+        }
+    }
+}
+
+// =====================================================================================================================
+// Run backend codegen on just the fragment shader of a patched pipeline module that is supplied as bitcode. This is
+// run asynchronously with the rest of the pipeline, so it uses its own LLVM context and target machine.
+// Returns an error message, or an empty string on success.
+static std::string GenerateFragmentShader(
+    StringRef           bitcode,    // Bitcode of the patched pipeline module
+    StringRef           gpuName,    // LLVM GPU name (e.g. "gfx900")
+    raw_pwrite_stream&  outStream)  // [in/out] Stream to write fragment shader ELF output
+{
+    std::string errMsg;
+    LLVMContext context;
+
+    // Collect errors rather than passing them to the client's diagnostic handler, which lives on the other thread.
+    context.setDiagnosticHandlerCallBack(
+        [](const DiagnosticInfo& diagInfo, void* pErrMsg)
+        {
+            if (diagInfo.getSeverity() == DS_Error)
+            {
+                raw_string_ostream errStream(*static_cast<std::string*>(pErrMsg));
+                DiagnosticPrinterRawOStream printStream(errStream);
+                diagInfo.print(printStream);
+                printStream << "\n";
+            }
+        },
+        &errMsg);
+
+#if LLPC_ENABLE_EXCEPTION
+    try
+#endif
+    {
+        Expected<std::unique_ptr<Module>> moduleOrErr = parseBitcodeFile(MemoryBufferRef(bitcode, ""), context);
+        if (!moduleOrErr)
+        {
+            errMsg = toString(moduleOrErr.takeError());
+        }
+        else
+        {
+            std::unique_ptr<Module> fragmentModule = std::move(*moduleOrErr);
+            RemoveShaderEntryPoints(*fragmentModule, false);
+
+            std::unique_ptr<BuilderContext> builderContext(BuilderContext::Create(context, gpuName));
+            std::unique_ptr<Llpc::PassManager> codeGenPassMgr(Llpc::PassManager::Create());
+            builderContext->AddTargetPasses(*codeGenPassMgr, nullptr, outStream);
+            codeGenPassMgr->run(*fragmentModule);
+        }
+    }
+#if LLPC_ENABLE_EXCEPTION
+    catch (const char*)
+    {
+        if (errMsg.empty())
+        {
+            errMsg = "LLVM fatal error";
+        }
+    }
+#endif
+
+    return errMsg;
+}
+
 // =====================================================================================================================
 // Generate pipeline module by running patch, middle-end optimization and backend codegen passes.
 // The output is normally ELF, but IR disassembly if an option is used to stop compilation early.
 // Output is written to outStream.
+// If pFragmentOutStream is not nullptr, and the pipeline has a fragment shader as well as other hardware stages,
+// the fragment shader is code-generated as a task run by runAsyncFunc and written to pFragmentOutStream instead.
 // Like other Builder methods, on error, this calls report_fatal_error, which you can catch by setting
 // a diagnostic handler with LLVMContext::setDiagnosticHandler.
 void PipelineState::Generate(
     std::unique_ptr<Module>         pipelineModule,       // IR pipeline module
     raw_pwrite_stream&              outStream,            // [in/out] Stream to write ELF or IR disassembly output
     Pipeline::CheckShaderCacheFunc  checkShaderCacheFunc, // Function to check shader cache in graphics pipeline
-    ArrayRef<Timer*>                timers)               // Timers for: patch passes, llvm optimizations, codegen
+    ArrayRef<Timer*>                timers,               // Timers for: patch passes, llvm optimizations, codegen
+    raw_pwrite_stream*              pFragmentOutStream,   // [in/out] Stream to write separately generated fragment
+                                                          //    shader output, or nullptr to disallow
+    Pipeline::RunAsyncFunc          runAsyncFunc)         // Function to run the fragment shader code generation
+                                                          //    asynchronously
 {
     uint32_t passIndex = 1000;
     Timer* pPatchTimer = (timers.size() >= 1) ? timers[0] : nullptr;
@@ -247,6 +384,38 @@ void PipelineState::Generate(
     patchPassMgr->run(*pipelineModule);
     patchPassMgr.reset(nullptr);
 
+    // If allowed, split the fragment shader out and code-generate it as an asynchronous task, concurrently with the
+    // other hardware stages. The task gets its own copy of the module via bitcode, so it can use its own LLVM context.
+    // This is not done when dumping, or when the output is IR rather than ISA.
+    SmallString<0> pipelineBitcode;
+    std::string fragmentErrMsg;
+    std::function<void()> waitFragmentCodeGen;
+    auto waitFragmentCodeGenOnExit = make_scope_exit([&waitFragmentCodeGen]()
+    {
+        if (waitFragmentCodeGen)
+        {
+            waitFragmentCodeGen();
+        }
+    });
+
+    if ((pFragmentOutStream != nullptr) &&
+        runAsyncFunc &&
+        (BuilderContext::GetLlpcOuts() == nullptr) &&
+        (BuilderContext::EmittingLlvmIr() == false) &&
+        (GetBuilderContext()->BuildingRelocatableElf() == false) &&
+        CanSplitFragmentShader(*pipelineModule))
+    {
+        raw_svector_ostream bitcodeStream(pipelineBitcode);
+        WriteBitcodeToFile(*pipelineModule, bitcodeStream);
+        RemoveShaderEntryPoints(*pipelineModule, true);
+
+        std::string gpuName = GetBuilderContext()->GetTargetMachine()->getTargetCPU().str();
+        waitFragmentCodeGen = runAsyncFunc([&pipelineBitcode, &fragmentErrMsg, gpuName, pFragmentOutStream]()
+        {
+            fragmentErrMsg = GenerateFragmentShader(pipelineBitcode, gpuName, *pFragmentOutStream);
+        });
+    }
+
     // A separate "whole pipeline" pass manager for code generation.
     std::unique_ptr<PassManager> codeGenPassMgr(PassManager::Create());
     codeGenPassMgr->SetPassIndex(&passIndex);
@@ -256,6 +425,16 @@ void PipelineState::Generate(
 
     // Run the target backend codegen passes.
     codeGenPassMgr->run(*pipelineModule);
+
+    if (waitFragmentCodeGen)
+    {
+        waitFragmentCodeGen();
+        waitFragmentCodeGen = nullptr;
+        if (fragmentErrMsg.empty() == false)
+        {
+            report_fatal_error(Twine("Failed to generate fragment shader: ") + fragmentErrMsg);
+        }
+    }
 }
 
 // =====================================================================================================================
@@ -143,7 +143,9 @@ public:
     void Generate(std::unique_ptr<Module>   pipelineModule,
                   raw_pwrite_stream&        outStream,
                   CheckShaderCacheFunc      checkShaderCacheFunc,
-                  ArrayRef<Timer*>          timers) override final;
+                  ArrayRef<Timer*>          timers,
+                  raw_pwrite_stream*        pFragmentOutStream,
+                  RunAsyncFunc              runAsyncFunc) override final;
 
     // Compute the ExportFormat (as an opaque int) of the specified color export location with the specified output
     // type. Only the number of elements of the type is significant.
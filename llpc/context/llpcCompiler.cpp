@@ -56,6 +56,7 @@
 #include "llpcElfReader.h"
 #include "llpcElfWriter.h"
 #include "llpcFile.h"
+#include "llpcInternal.h"
 #include "llpcPassManager.h"
 #include "llpcPipelineDumper.h"
 #include "llpcSpirvLower.h"
@@ -108,6 +109,13 @@ opt<bool> UseRelocatableShaderElf("use-relocatable-shader-elf",
                                          "be used with caution."),
                                     init(false));
 
+// -relocatable-generic-color-export: builds the fragment shader of a relocatable pipeline without regard to the color
+// target formats, so that pipelines differing only in those formats share the same relocatable fragment shader ELF.
+opt<bool> RelocatableGenericColorExport("relocatable-generic-color-export",
+                                        desc("Export full 32-bit colors from relocatable fragment shaders, so that "
+                                             "they do not depend on the color target formats"),
+                                        init(false));
+
 // -relocatable-shader-elf-limit=<n>: Limits the number of pipelines that will be compiled using relocatable shader ELF.
 // This is to be used for debugging by doing a binary search to identify a pipeline that is being miscompiled when using
 // relocatable shader ELF modules.
@@ -119,9 +127,41 @@ opt<int> RelocatableShaderElfLimit("relocatable-shader-elf-limit", cl::desc("Max
 // 0 - Disable
 // 1 - Runtime cache
 // 2 - Cache to disk
-static opt<uint32_t> ShaderCacheMode("shader-cache-mode",
-                                     desc("Shader cache mode, 0 - disable, 1 - runtime cache, 2 - cache to disk "),
-                                     init(0));
+opt<uint32_t> ShaderCacheMode("shader-cache-mode",
+                              desc("Shader cache mode, 0 - disable, 1 - runtime cache, 2 - cache to disk "),
+                              init(0));
+
+// -shader-cache-file-map: map the on-disk shader cache file into memory instead of reading all of it at start-up
+static opt<bool> ShaderCacheFileMap("shader-cache-file-map",
+                                    desc("Map the on-disk shader cache file into memory instead of reading it, and "
+                                         "check the CRC of each cached shader on its first use"),
+                                    init(false));
+
+// -shader-cache-memory-budget: maximum size of the shader data held by the shader cache, in MB
+static opt<uint32_t> ShaderCacheMemoryBudget("shader-cache-memory-budget",
+                                             desc("Maximum size in MB of the shader data held by the shader cache, "
+                                                  "beyond which the least recently used shaders are evicted "
+                                                  "(0 - no limit)"),
+                                             init(0));
+
+// -shader-cache-file-budget: maximum size of the on-disk shader cache file, in MB
+static opt<uint32_t> ShaderCacheFileBudget("shader-cache-file-budget",
+                                           desc("Maximum size in MB of the on-disk shader cache file, beyond which "
+                                                "shaders are evicted and the file is compacted (0 - no limit)"),
+                                           init(0));
+
+// -shader-cache-compress: compress the shader data stored in the shader cache
+static opt<bool> ShaderCacheCompress("shader-cache-compress",
+                                     desc("Compress the shader data stored in the shader cache with zlib, "
+                                          "decompressing it on each use"),
+                                     init(false));
+
+// -shader-cache-shared: share the on-disk shader cache with other processes
+static opt<bool> ShaderCacheShared("shader-cache-shared",
+                                   desc("Share the on-disk shader cache with other processes, storing each shader in "
+                                        "its own file of a directory shared by all executables. The directory is "
+                                        "not bounded by -shader-cache-file-budget"),
+                                   init(false));
 
 // -executable-name: executable file name
 static opt<std::string> ExecutableName("executable-name",
@@ -162,6 +202,30 @@ opt<bool> TrimDebugInfo("trim-debug-info", cl::desc("Trim debug information in S
 // -enable-per-stage-cache: Enable shader cache per shader stage
 opt<bool> EnablePerStageCache("enable-per-stage-cache", cl::desc("Enable shader cache per shader stage"), init(true));
 
+// -enable-parallel-stage-lower: Translate and lower the SPIR-V shader stages of a graphics pipeline concurrently
+opt<bool> EnableParallelStageLower("enable-parallel-stage-lower",
+                                   cl::desc("Translate and lower the shader stages of a graphics pipeline in parallel, "
+                                            "each in its own context"),
+                                   init(false));
+
+// -enable-parallel-codegen: Code-generate the fragment shader of a graphics pipeline concurrently with the other stages
+opt<bool> EnableParallelCodeGen("enable-parallel-codegen",
+                                cl::desc("Generate code for the fragment shader and the other shader stages of a "
+                                         "graphics pipeline in parallel, and merge the ELFs"),
+                                init(false));
+
+// -async-build-thread-count: count of worker threads for asynchronous pipeline builds
+opt<uint32_t> AsyncBuildThreadCount("async-build-thread-count",
+                                    cl::desc("Count of worker threads for asynchronous pipeline builds. 0 means the "
+                                             "count of hardware threads."),
+                                    init(0));
+
+extern opt<int> ContextPoolLimit;
+
+extern opt<bool> ContextPoolOverflow;
+
+extern opt<int> ContextPoolMaxIdle;
+
 extern opt<bool> EnableOuts;
 
 extern opt<bool> EnableErrs;
@@ -183,7 +247,7 @@ namespace Llpc
 {
 
 llvm::sys::Mutex       Compiler::m_contextPoolMutex;
-std::vector<Context*>* Compiler::m_pContextPool = nullptr;
+ContextPool*           Compiler::m_pContextPool = nullptr;
 
 // Enumerates modes used in shader replacement
 enum ShaderReplaceMode
@@ -332,6 +396,144 @@ bool VKAPI_CALL ICompiler::IsVertexFormatSupported(
     return (dfmt != BufDataFormatInvalid);
 }
 
+// =====================================================================================================================
+// Represents an asynchronous pipeline build job, which runs on the compiler's thread pool.
+class PipelineBuildJob : public IPipelineBuildJob
+{
+public:
+    PipelineBuildJob(std::function<Result()> build)
+        :
+        m_job(std::make_shared<ThreadPoolJob>([this, build]{ m_result = build(); }))
+    {
+    }
+
+    // Gets the job to submit to the thread pool
+    std::shared_ptr<ThreadPoolJob> GetJob() const { return m_job; }
+
+    // Polls the state of the job
+    virtual Result Poll()
+    {
+        if (m_job->IsCancelled())
+        {
+            return Result::ErrorUnavailable;
+        }
+        return m_job->IsFinished() ? m_result : Result::Delayed;
+    }
+
+    // Waits for the job to finish, running it on this thread if it has not started yet
+    virtual Result Wait()
+    {
+        m_job->Wait();
+        return Poll();
+    }
+
+    // Cancels the job if it has not started yet
+    virtual bool Cancel() { return m_job->Cancel(); }
+
+    // Frees the job, after cancelling it or waiting for it
+    virtual void Destroy()
+    {
+        m_job->Cancel();
+        m_job->Wait();
+        delete this;
+    }
+
+private:
+    std::shared_ptr<ThreadPoolJob>  m_job;                      // Job run by the thread pool
+    Result                          m_result = Result::Success; // Result of the build, valid once finished
+};
+
+// =====================================================================================================================
+// Represents a read-only view of a pipeline binary. The view either refers to the storage of the shader cache entry
+// that the binary was found in, holding a reference to the storage so that it stays alive even if the entry is evicted,
+// or owns the binary.
+class PipelineBinaryView : public IPipelineBinaryView
+{
+public:
+    // Constructs a view of a binary in the storage of a shader cache entry
+    PipelineBinaryView(std::shared_ptr<void> storage, BinaryData binary)
+        :
+        m_storage(std::move(storage)),
+        m_binary(binary)
+    {
+    }
+
+    // Constructs a view that owns the binary
+    PipelineBinaryView(ElfPackage&& elf)
+        :
+        m_elf(std::move(elf))
+    {
+        m_binary.codeSize = m_elf.size();
+        m_binary.pCode = m_elf.data();
+    }
+
+    // Gets the pipeline binary
+    virtual BinaryData GetBinary() const { return m_binary; }
+
+    // Adds a reference to the view
+    virtual void AddRef() { ++m_refCount; }
+
+    // Releases a reference to the view, freeing it when the last reference is released
+    virtual void Release()
+    {
+        if (--m_refCount == 0)
+        {
+            delete this;
+        }
+    }
+
+private:
+    std::shared_ptr<void>   m_storage;          // Cache storage holding the binary, if it is not owned by the view
+    ElfPackage              m_elf;              // Binary owned by the view
+    BinaryData              m_binary = {};      // Pipeline binary
+    std::atomic<uint32_t>   m_refCount{ 1 };    // Reference count
+};
+
+// =====================================================================================================================
+// Gets the hash code that a fast build of a pipeline is cached under, from the cache hash code of the pipeline.
+static MetroHash::Hash GetFastCompileCacheHash(
+    const MetroHash::Hash& cacheHash)   // [in] Cache hash code of the pipeline
+{
+    static const char FastCompileTag[] = "fast-compile";
+
+    MetroHash64 hasher;
+    hasher.Update(cacheHash);
+    hasher.Update(reinterpret_cast<const uint8_t*>(FastCompileTag), sizeof(FastCompileTag));
+
+    MetroHash::Hash hash = {};
+    hasher.Finalize(hash.bytes);
+    return hash;
+}
+
+// =====================================================================================================================
+// Represents a SPIR-V shader stage that is used by more than one pipeline of a batch build, which is translated and
+// lowered once for all of those pipelines.
+struct SharedShaderStage
+{
+    const GraphicsPipelineBuildInfo*    pPipelineInfo = nullptr;    // First pipeline that uses the stage
+    const PipelineShaderInfo*           pShaderInfo = nullptr;      // Shader info of the stage in that pipeline
+    uint32_t                            useCount = 0;               // Count of uses of the stage in the batch
+    Result                              result = Result::Success;   // Result of lowering the stage
+    bool                                isLowered = false;          // Whether the lowered module is set up
+    ElfPackage                          bitcode;                    // Lowered LLVM bitcode
+    ShaderModuleEntry                   shaderEntry = {};           // Entry of the lowered shader module
+    ShaderModuleDataEx                  moduleDataEx = {};          // Lowered shader module, as MultiLlvmBc
+};
+
+// =====================================================================================================================
+// Represents an entry-point of a SPIR-V shader module that is translated and lowered to LLVM bitcode, possibly
+// concurrently with the other entry-points of the module.
+struct ShaderModuleEntryBuild
+{
+    ShaderEntryName                     entryName = {};             // Entry-point to build
+    Result                              result = Result::Success;   // Result of the build
+    ElfPackage                          bitcode;                    // Lowered LLVM bitcode
+    uint32_t                            passIndex = 0;              // Pass index of the lowering passes
+    ShaderModuleEntryData               entryData = {};             // Entry data, except for the shader entry
+    std::vector<ResourceNodeData>       resNodeDatas;               // Resource nodes used by the entry-point
+    std::vector<FsOutInfo>              fsOutInfos;                 // Fragment shader outputs of the entry-point
+};
+
 // =====================================================================================================================
 Compiler::Compiler(
     GfxIpVersion      gfxIp,        // Graphics IP version info
@@ -361,7 +563,7 @@ Compiler::Compiler(
         {
             std::lock_guard<sys::Mutex> lock(m_contextPoolMutex);
 
-            m_pContextPool = new std::vector<Context*>();
+            m_pContextPool = new ContextPool();
         }
     }
 
@@ -374,6 +576,11 @@ Compiler::Compiler(
     auxCreateInfo.hash            = m_optionHash;
     auxCreateInfo.pExecutableName = cl::ExecutableName.c_str();
     auxCreateInfo.pCacheFilePath  = cl::ShaderCacheFileDir.c_str();
+    auxCreateInfo.mapCacheFile    = cl::ShaderCacheFileMap;
+    auxCreateInfo.memoryBudget    = static_cast<size_t>(cl::ShaderCacheMemoryBudget) * 1024 * 1024;
+    auxCreateInfo.fileBudget      = static_cast<size_t>(cl::ShaderCacheFileBudget) * 1024 * 1024;
+    auxCreateInfo.compressShaders = cl::ShaderCacheCompress;
+    auxCreateInfo.shareCacheDir   = cl::ShaderCacheShared;
     if (cl::ShaderCacheFileDir.empty())
     {
 #ifdef WIN_OS
@@ -393,36 +600,28 @@ Compiler::Compiler(
 Compiler::~Compiler()
 {
     bool shutdown = false;
+
+    // Shut down the thread pool for asynchronous builds, which cancels builds that have not started yet.
+    m_threadPool.reset();
+
     {
         // Free context pool
         std::lock_guard<sys::Mutex> lock(m_contextPoolMutex);
 
         // Keep the max allowed count of contexts that reside in the pool so that we can speed up the creatoin of
         // compiler next time.
-        for (auto it = m_pContextPool->begin(); it != m_pContextPool->end();)
-        {
-            auto   pContext             = *it;
-            size_t maxResidentContexts  = 0;
+        size_t maxResidentContexts  = 0;
 
-            // This is just a W/A for Teamcity. Setting AMD_RESIDENT_CONTEXTS could reduce more than 40 minutes of
-            // CTS running time.
-            char*  pMaxResidentContexts = getenv("AMD_RESIDENT_CONTEXTS");
+        // This is just a W/A for Teamcity. Setting AMD_RESIDENT_CONTEXTS could reduce more than 40 minutes of
+        // CTS running time.
+        char*  pMaxResidentContexts = getenv("AMD_RESIDENT_CONTEXTS");
 
-            if (pMaxResidentContexts != nullptr)
-            {
-                maxResidentContexts = strtoul(pMaxResidentContexts, nullptr, 0);
-            }
-
-            if ((pContext->IsInUse() == false) && (m_pContextPool->size() > maxResidentContexts))
-            {
-                it = m_pContextPool->erase(it);
-                delete pContext;
-            }
-            else
-            {
-                ++it;
-            }
+        if (pMaxResidentContexts != nullptr)
+        {
+            maxResidentContexts = strtoul(pMaxResidentContexts, nullptr, 0);
         }
+
+        m_pContextPool->Trim(maxResidentContexts);
     }
 
     // Restore default output
@@ -449,10 +648,13 @@ Compiler::~Compiler()
 
     if (shutdown)
     {
+        {
+            std::lock_guard<sys::Mutex> lock(m_contextPoolMutex);
+            delete m_pContextPool;
+            m_pContextPool = nullptr;
+        }
         ShaderCacheManager::Shutdown();
         llvm_shutdown();
-        delete m_pContextPool;
-        m_pContextPool = nullptr;
     }
 }
 
@@ -473,13 +675,13 @@ Result Compiler::BuildShaderModule(
     Result result = Result::Success;
     void* pAllocBuf = nullptr;
     const void* pCacheData = nullptr;
+    std::shared_ptr<void> cacheStorage;
     size_t allocSize = 0;
     ShaderModuleDataEx moduleDataEx = {};
     // For trimming debug info
     uint8_t* pTrimmedCode = nullptr;
 
     ElfPackage moduleBinary;
-    raw_svector_ostream moduleBinaryStream(moduleBinary);
     std::vector<ShaderEntryName> entryNames;
     SmallVector<ShaderModuleEntryData, 4> moduleEntryDatas;
     SmallVector<ShaderModuleEntry, 4> moduleEntries;
@@ -489,49 +691,59 @@ Result Compiler::BuildShaderModule(
     ShaderEntryState cacheEntryState = ShaderEntryState::New;
     CacheEntryHandle hEntry = nullptr;
 
-    // Calculate the hash code of input data
-    MetroHash::Hash hash = {};
-    MetroHash64::Hash(reinterpret_cast<const uint8_t*>(pShaderInfo->shaderBin.pCode),
-        pShaderInfo->shaderBin.codeSize,
-        hash.bytes);
-
-    memcpy(moduleDataEx.common.hash, &hash, sizeof(hash));
-
-    TimerProfiler timerProfiler(MetroHash::Compact64(&hash),
-                                "LLPC ShaderModule",
-                                TimerProfiler::ShaderModuleTimerEnableMask);
-
     // Check the type of input shader binary
+    MetroHash::Hash hash = {};
+    MetroHash::Hash cacheHash = {};
     if (ShaderModuleHelper::IsSpirvBinary(&pShaderInfo->shaderBin))
     {
-        uint32_t debugInfoSize = 0;
+        // Verify the SPIR-V binary, collect its info, trim debug info and calculate the hash codes of the input data
+        // and of the (trimmed) cached data, all in a single pass over the binary.
+        if (cl::TrimDebugInfo)
+        {
+            pTrimmedCode = new uint8_t[pShaderInfo->shaderBin.codeSize];
+        }
 
-        moduleDataEx.common.binType = BinaryType::Spirv;
-        if (ShaderModuleHelper::VerifySpirvBinary(&pShaderInfo->shaderBin) != Result::Success)
+        uint32_t codeSize = 0;
+        if (ShaderModuleHelper::ScanSpirvBinary(&pShaderInfo->shaderBin,
+                                                &moduleDataEx.common.usage,
+                                                entryNames,
+                                                cl::TrimDebugInfo,
+                                                pTrimmedCode,
+                                                &codeSize,
+                                                &hash,
+                                                &cacheHash) != Result::Success)
         {
             LLPC_ERRS("Unsupported SPIR-V instructions are found!\n");
             result = Result::Unsupported;
         }
-        if (result == Result::Success)
+
+        moduleDataEx.common.binType = BinaryType::Spirv;
+        moduleDataEx.common.binCode.pCode = (pTrimmedCode != nullptr) ? pTrimmedCode : pShaderInfo->shaderBin.pCode;
+        moduleDataEx.common.binCode.codeSize = codeSize;
+    }
+    else
+    {
+        // Calculate the hash code of input data
+        MetroHash64::Hash(reinterpret_cast<const uint8_t*>(pShaderInfo->shaderBin.pCode),
+            pShaderInfo->shaderBin.codeSize,
+            hash.bytes);
+
+        if (ShaderModuleHelper::IsLlvmBitcode(&pShaderInfo->shaderBin))
         {
-            ShaderModuleHelper::CollectInfoFromSpirvBinary(&pShaderInfo->shaderBin, &moduleDataEx.common.usage,
-                                                           entryNames, &debugInfoSize);
+            moduleDataEx.common.binType = BinaryType::LlvmBc;
+            moduleDataEx.common.binCode = pShaderInfo->shaderBin;
         }
-        moduleDataEx.common.binCode.codeSize = pShaderInfo->shaderBin.codeSize;
-        if (cl::TrimDebugInfo)
+        else
         {
-            moduleDataEx.common.binCode.codeSize -= debugInfoSize;
+            result = Result::ErrorInvalidShader;
         }
     }
-    else if (ShaderModuleHelper::IsLlvmBitcode(&pShaderInfo->shaderBin))
-    {
-        moduleDataEx.common.binType = BinaryType::LlvmBc;
-        moduleDataEx.common.binCode = pShaderInfo->shaderBin;
-    }
-    else
-    {
-        result = Result::ErrorInvalidShader;
-    }
+
+    memcpy(moduleDataEx.common.hash, &hash, sizeof(hash));
+
+    TimerProfiler timerProfiler(MetroHash::Compact64(&hash),
+                                "LLPC ShaderModule",
+                                TimerProfiler::ShaderModuleTimerEnableMask);
 
     if (moduleDataEx.common.binType == BinaryType::Spirv)
     {
@@ -543,23 +755,6 @@ Result Compiler::BuildShaderModule(
                 &hash);
         }
 
-        // Trim debug info
-        if (cl::TrimDebugInfo)
-        {
-            pTrimmedCode = new uint8_t[moduleDataEx.common.binCode.codeSize];
-            ShaderModuleHelper::TrimSpirvDebugInfo(&pShaderInfo->shaderBin, moduleDataEx.common.binCode.codeSize, pTrimmedCode);
-            moduleDataEx.common.binCode.pCode = pTrimmedCode;
-        }
-        else
-        {
-            moduleDataEx.common.binCode.pCode = pShaderInfo->shaderBin.pCode;
-        }
-
-        // Calculate SPIR-V cache hash
-        MetroHash::Hash cacheHash = {};
-        MetroHash64::Hash(reinterpret_cast<const uint8_t*>(moduleDataEx.common.binCode.pCode),
-            moduleDataEx.common.binCode.codeSize,
-            cacheHash.bytes);
         static_assert(sizeof(moduleDataEx.common.cacheHash) == sizeof(cacheHash), "Unexpected value!");
         memcpy(moduleDataEx.common.cacheHash, cacheHash.dwords, sizeof(cacheHash));
 
@@ -567,6 +762,7 @@ Result Compiler::BuildShaderModule(
         bool enableOpt = cl::EnableShaderModuleOpt;
         enableOpt = enableOpt || pShaderInfo->options.enableOpt;
         enableOpt = moduleDataEx.common.usage.useSpecConstant ? false : enableOpt;
+        enableOpt = (result == Result::Success) ? enableOpt : false;
 
         if (enableOpt)
         {
@@ -576,115 +772,75 @@ Result Compiler::BuildShaderModule(
             cacheEntryState = m_shaderCache->FindShader(cacheHash, true, &hEntry);
             if (cacheEntryState == ShaderEntryState::Ready)
             {
-                result = m_shaderCache->RetrieveShader(hEntry, &pCacheData, &allocSize);
+                result = m_shaderCache->RetrieveShader(hEntry, &pCacheData, &allocSize, &cacheStorage);
+                if (result != Result::Success)
+                {
+                    // The shader module was evicted from the cache after it was looked up, so build it again without
+                    // caching it.
+                    result          = Result::Success;
+                    cacheEntryState = ShaderEntryState::Unavailable;
+                    hEntry          = nullptr;
+                }
             }
             if (cacheEntryState != ShaderEntryState::Ready)
             {
-                Context* pContext = AcquireContext();
-
-                pContext->setDiagnosticHandler(std::make_unique<LlpcDiagnosticHandler>());
-                pContext->SetBuilder(pContext->GetBuilderContext()->CreateBuilder(nullptr, true));
+                // Translate and lower the entry-points concurrently, each on its own context. Timers and output
+                // printing are not thread-safe, so the entry-points are built serially if either is on.
+                const bool serial = (entryNames.size() < 2) || EnableOuts() || TimerProfiler::IsEnabled();
+                std::vector<ShaderModuleEntryBuild> entryBuilds(entryNames.size());
+                std::vector<std::shared_ptr<ThreadPoolJob>> entryJobs;
+                for (uint32_t i = 0; i < entryNames.size(); ++i)
+                {
+                    ShaderModuleEntryBuild* pEntryBuild = &entryBuilds[i];
+                    TimerProfiler* pTimerProfiler = serial ? &timerProfiler : nullptr;
+                    pEntryBuild->entryName = entryNames[i];
+                    entryJobs.push_back(std::make_shared<ThreadPoolJob>(
+                        [this, &moduleDataEx, pTimerProfiler, pEntryBuild]
+                        {
+                            pEntryBuild->result = BuildShaderModuleEntry(&moduleDataEx.common,
+                                                                         pTimerProfiler,
+                                                                         pEntryBuild);
+                        }));
+                    if (serial == false)
+                    {
+                        GetThreadPool()->Submit(entryJobs.back(), JobPriority::Normal);
+                    }
+                }
 
+                // Wait for the entry-points in order (running any that have not been started yet on this thread),
+                // and append their bitcode to the module binary in the order of the entry-points. Once one has
+                // failed, those that have not been started yet are cancelled.
                 for (uint32_t i = 0; i < entryNames.size(); ++i)
                 {
-                    ShaderModuleEntry moduleEntry = {};
-                    ShaderModuleEntryData moduleEntryData = {};
+                    if (result != Result::Success)
+                    {
+                        entryJobs[i]->Cancel();
+                    }
+                    entryJobs[i]->Wait();
 
-                    moduleEntryData.pShaderEntry = &moduleEntry;
-                    moduleEntryData.stage = entryNames[i].stage;
-                    moduleEntryData.pEntryName = entryNames[i].pName;
-                    moduleEntry.entryOffset = moduleBinary.size();
+                    ShaderModuleEntryBuild* pEntryBuild = &entryBuilds[i];
+                    if ((result != Result::Success) || (pEntryBuild->result != Result::Success))
+                    {
+                        result = (result != Result::Success) ? result : pEntryBuild->result;
+                        continue;
+                    }
+
+                    ShaderModuleEntry moduleEntry = {};
                     MetroHash::Hash entryNamehash = {};
                     MetroHash64::Hash(reinterpret_cast<const uint8_t*>(entryNames[i].pName),
                         strlen(entryNames[i].pName),
                         entryNamehash.bytes);
                     memcpy(moduleEntry.entryNameHash, entryNamehash.dwords, sizeof(entryNamehash));
+                    moduleEntry.entryOffset = moduleBinary.size();
+                    moduleEntry.entrySize = pEntryBuild->bitcode.size();
+                    moduleEntry.passIndex = pEntryBuild->passIndex;
+                    moduleBinary.append(pEntryBuild->bitcode.begin(), pEntryBuild->bitcode.end());
 
-                    // Create empty modules and set target machine in each.
-                    Module* pModule = new Module(
-                        (Twine("llpc") + GetShaderStageName(static_cast<ShaderStage>(entryNames[i].stage))).str(),
-                        *pContext);
-
-                    pContext->SetModuleTargetMachine(pModule);
-
-                    uint32_t passIndex = 0;
-                    std::unique_ptr<PassManager> lowerPassMgr(PassManager::Create());
-                    lowerPassMgr->SetPassIndex(&passIndex);
-
-                    // Set the shader stage in the Builder.
-                    pContext->GetBuilder()->SetShaderStage(static_cast<ShaderStage>(entryNames[i].stage));
-
-                    // Start timer for translate.
-                    timerProfiler.AddTimerStartStopPass(&*lowerPassMgr, TimerTranslate, true);
-
-                    // SPIR-V translation, then dump the result.
-                    PipelineShaderInfo shaderInfo = {};
-                    shaderInfo.pModuleData = &moduleDataEx.common;
-                    shaderInfo.entryStage = entryNames[i].stage;
-                    shaderInfo.pEntryTarget = entryNames[i].pName;
-                    lowerPassMgr->add(CreateSpirvLowerTranslator(static_cast<ShaderStage>(entryNames[i].stage),
-                                                                &shaderInfo));
-                    bool collectDetailUsage = ((entryNames[i].stage == ShaderStageFragment) ||
-                                               (entryNames[i].stage == ShaderStageCompute)) ? true : false;
-                    auto pResCollectPass = static_cast<SpirvLowerResourceCollect*>(
-                                           CreateSpirvLowerResourceCollect(collectDetailUsage));
-                    lowerPassMgr->add(pResCollectPass);
-                    if (EnableOuts())
-                    {
-                        lowerPassMgr->add(createPrintModulePass(outs(), "\n"
-                            "===============================================================================\n"
-                            "// LLPC SPIRV-to-LLVM translation results\n"));
-                    }
-
-                    // Stop timer for translate.
-                    timerProfiler.AddTimerStartStopPass(&*lowerPassMgr, TimerTranslate, false);
-
-                    // Per-shader SPIR-V lowering passes.
-                    SpirvLower::AddPasses(pContext,
-                                          static_cast<ShaderStage>(entryNames[i].stage),
-                                          *lowerPassMgr,
-                                          timerProfiler.GetTimer(TimerLower),
-                                          cl::ForceLoopUnrollCount);
-
-                    lowerPassMgr->add(createBitcodeWriterPass(moduleBinaryStream));
-
-                    // Run the passes.
-                    bool success = RunPasses(&*lowerPassMgr, pModule);
-                    if (success == false)
-                    {
-                        LLPC_ERRS("Failed to translate SPIR-V or run per-shader passes\n");
-                        result = Result::ErrorInvalidShader;
-                        delete pModule;
-                        break;
-                    }
-
-                    moduleEntry.entrySize = moduleBinary.size() - moduleEntry.entryOffset;
+                    entryResourceNodeDatas[i] = std::move(pEntryBuild->resNodeDatas);
+                    fsOutInfos.append(pEntryBuild->fsOutInfos.begin(), pEntryBuild->fsOutInfos.end());
 
-                    moduleEntry.passIndex = passIndex;
-                    if (pResCollectPass->DetailUsageValid())
-                    {
-                        auto& resNodeDatas = pResCollectPass->GetResourceNodeDatas();
-                        moduleEntryData.resNodeDataCount = resNodeDatas.size();
-                        for (auto resNodeData : resNodeDatas)
-                        {
-                            ResourceNodeData data = {};
-                            data.type = resNodeData.second;
-                            data.set = resNodeData.first.value.set;
-                            data.binding = resNodeData.first.value.binding;
-                            data.arraySize = resNodeData.first.value.arraySize;
-                            entryResourceNodeDatas[i].push_back(data);
-                        }
-
-                        moduleEntryData.pushConstSize = pResCollectPass->GetPushConstSize();
-                        auto& fsOutInfosFromPass = pResCollectPass->GetFsOutInfos();
-                        for (auto& fsOutInfo : fsOutInfosFromPass)
-                        {
-                            fsOutInfos.push_back(fsOutInfo);
-                        }
-                    }
                     moduleEntries.push_back(moduleEntry);
-                    moduleEntryDatas.push_back(moduleEntryData);
-                    delete pModule;
+                    moduleEntryDatas.push_back(pEntryBuild->entryData);
                 }
 
                 if (result == Result::Success)
@@ -693,8 +849,6 @@ Result Compiler::BuildShaderModule(
                     moduleDataEx.common.binCode.pCode = moduleBinary.data();
                     moduleDataEx.common.binCode.codeSize = moduleBinary.size();
                 }
-
-                pContext->setDiagnosticHandlerCallBack(nullptr);
             }
             moduleDataEx.extra.entryCount = entryNames.size();
         }
@@ -833,14 +987,126 @@ Result Compiler::BuildShaderModule(
         {
             m_shaderCache->ResetShader(hEntry);
         }
+        delete[] pTrimmedCode;
+    }
+
+    return result;
+}
+
+// =====================================================================================================================
+// Translates and lowers one entry-point of a SPIR-V shader module to LLVM bitcode, on a context of its own.
+Result Compiler::BuildShaderModuleEntry(
+    const ShaderModuleData* pModuleData,      // [in] SPIR-V shader module data
+    TimerProfiler*          pTimerProfiler,   // [in] Timer profiler of the shader module build, or nullptr if the
+                                              //      entry-point is built concurrently with others
+    ShaderModuleEntryBuild* pEntryBuild       // [in/out] Entry-point to build, and the result of the build
+    ) const
+{
+    Result result = Result::Success;
+    const ShaderStage entryStage = pEntryBuild->entryName.stage;
+
+    Context* pContext = AcquireContext(true);
+    pContext->setDiagnosticHandler(std::make_unique<LlpcDiagnosticHandler>());
+    pContext->SetBuilder(pContext->GetBuilderContext()->CreateBuilder(nullptr, true));
+
+    pEntryBuild->entryData.stage = entryStage;
+    pEntryBuild->entryData.pEntryName = pEntryBuild->entryName.pName;
+
+    // Create empty module and set target machine in it.
+    Module* pModule = new Module((Twine("llpc") + GetShaderStageName(entryStage)).str(), *pContext);
+    pContext->SetModuleTargetMachine(pModule);
+
+    {
+        raw_svector_ostream bitcodeStream(pEntryBuild->bitcode);
+        std::unique_ptr<PassManager> lowerPassMgr(PassManager::Create());
+        lowerPassMgr->SetPassIndex(&pEntryBuild->passIndex);
+
+        // Set the shader stage in the Builder.
+        pContext->GetBuilder()->SetShaderStage(entryStage);
+
+        // Start timer for translate.
+        if (pTimerProfiler != nullptr)
+        {
+            pTimerProfiler->AddTimerStartStopPass(&*lowerPassMgr, TimerTranslate, true);
+        }
+
+        // SPIR-V translation, then dump the result.
+        PipelineShaderInfo shaderInfo = {};
+        shaderInfo.pModuleData = pModuleData;
+        shaderInfo.entryStage = entryStage;
+        shaderInfo.pEntryTarget = pEntryBuild->entryName.pName;
+        lowerPassMgr->add(CreateSpirvLowerTranslator(entryStage, &shaderInfo));
+        bool collectDetailUsage = ((entryStage == ShaderStageFragment) ||
+                                   (entryStage == ShaderStageCompute)) ? true : false;
+        auto pResCollectPass = static_cast<SpirvLowerResourceCollect*>(
+                               CreateSpirvLowerResourceCollect(collectDetailUsage));
+        lowerPassMgr->add(pResCollectPass);
+        if (EnableOuts())
+        {
+            lowerPassMgr->add(createPrintModulePass(outs(), "\n"
+                "===============================================================================\n"
+                "// LLPC SPIRV-to-LLVM translation results\n"));
+        }
+
+        // Stop timer for translate.
+        if (pTimerProfiler != nullptr)
+        {
+            pTimerProfiler->AddTimerStartStopPass(&*lowerPassMgr, TimerTranslate, false);
+        }
+
+        // Per-shader SPIR-V lowering passes.
+        SpirvLower::AddPasses(pContext,
+                              entryStage,
+                              *lowerPassMgr,
+                              (pTimerProfiler != nullptr) ? pTimerProfiler->GetTimer(TimerLower) : nullptr,
+                              cl::ForceLoopUnrollCount);
+
+        lowerPassMgr->add(createBitcodeWriterPass(bitcodeStream));
+
+        // Run the passes.
+        bool success = RunPasses(&*lowerPassMgr, pModule);
+        if (success == false)
+        {
+            LLPC_ERRS("Failed to translate SPIR-V or run per-shader passes\n");
+            result = Result::ErrorInvalidShader;
+        }
+        else if (pResCollectPass->DetailUsageValid())
+        {
+            auto& resNodeDatas = pResCollectPass->GetResourceNodeDatas();
+            pEntryBuild->entryData.resNodeDataCount = resNodeDatas.size();
+            for (auto resNodeData : resNodeDatas)
+            {
+                ResourceNodeData data = {};
+                data.type = resNodeData.second;
+                data.set = resNodeData.first.value.set;
+                data.binding = resNodeData.first.value.binding;
+                data.arraySize = resNodeData.first.value.arraySize;
+                pEntryBuild->resNodeDatas.push_back(data);
+            }
+
+            pEntryBuild->entryData.pushConstSize = pResCollectPass->GetPushConstSize();
+            auto& fsOutInfosFromPass = pResCollectPass->GetFsOutInfos();
+            for (auto& fsOutInfo : fsOutInfosFromPass)
+            {
+                pEntryBuild->fsOutInfos.push_back(fsOutInfo);
+            }
+        }
     }
 
+    delete pModule;
+    pContext->setDiagnosticHandlerCallBack(nullptr);
+    ReleaseContext(pContext);
+
     return result;
 }
 
 // =====================================================================================================================
 // Builds a pipeline by building relocatable elf files and linking them together.  The relocatable elf files will be
 // cached for future use.
+//
+// Each relocatable elf is built from a unit of shader stages. The pre-rasterization stages of a graphics pipeline (VS,
+// TCS, TES and GS) form one unit, so that they are merged into hardware stages (LS-HS, ES-GS, NGG) as in a full
+// pipeline build, and the fragment shader forms another. Only the interface between the two is left unmatched.
 Result Compiler::BuildPipelineWithRelocatableElf(
     Context*                            pContext,                   // [in] Acquired context
     ArrayRef<const PipelineShaderInfo*> shaderInfo,                 // Shader info of this pipeline
@@ -853,24 +1119,60 @@ Result Compiler::BuildPipelineWithRelocatableElf(
     pContext->GetPipelineContext()->DoUserDataNodeMerge();
     uint32_t originalShaderStageMask = pContext->GetPipelineContext()->GetShaderStageMask();
     pContext->GetBuilderContext()->SetBuildRelocatableElf(true);
+    pContext->GetBuilderContext()->SetGenericColorExport(cl::RelocatableGenericColorExport);
+
+    // Collect the shader stages of each unit.
+    uint32_t unitStageMasks[2] = {};
+    for (uint32_t stage = 0; stage < shaderInfo.size(); ++stage)
+    {
+        if (shaderInfo[stage] != nullptr && shaderInfo[stage]->pModuleData != nullptr)
+        {
+            const uint32_t unit = (stage == ShaderStageFragment) ? 1 : 0;
+            unitStageMasks[unit] |= ShaderStageToMask(static_cast<ShaderStage>(stage));
+        }
+    }
 
+    // The elf of each unit is stored at the index of the first stage of the unit.
     ElfPackage elf[ShaderStageNativeStageCount];
-    for (uint32_t stage = 0; (stage < shaderInfo.size()) && (result == Result::Success); ++stage)
+    for (uint32_t unit = 0; (unit < 2) && (result == Result::Success); ++unit)
     {
-        if (shaderInfo[stage] == nullptr || shaderInfo[stage]->pModuleData == nullptr)
+        const uint32_t unitStageMask = unitStageMasks[unit];
+        if (unitStageMask == 0)
         {
             continue;
         }
 
-        pContext->GetPipelineContext()->SetShaderStageMask(ShaderStageToMask(static_cast<ShaderStage>(stage)));
+        const uint32_t firstStage = countTrailingZeros(unitStageMask);
+        pContext->GetPipelineContext()->SetShaderStageMask(unitStageMask);
 
-        // Check the cache for the relocatable shader for this stage.
+        // Check the cache for the relocatable shader for this unit.
         MetroHash::Hash cacheHash = {};
         IShaderCache* pUserShaderCache = nullptr;
         if (pContext->IsGraphics())
         {
             auto pPipelineInfo = reinterpret_cast<const GraphicsPipelineBuildInfo*>(pContext->GetPipelineBuildInfo());
-            cacheHash = PipelineDumper::GenerateHashForGraphicsPipeline(pPipelineInfo, true, stage);
+            if (isPowerOf2_32(unitStageMask))
+            {
+                cacheHash = PipelineDumper::GenerateHashForGraphicsPipeline(pPipelineInfo,
+                                                                            true,
+                                                                            firstStage,
+                                                                            cl::RelocatableGenericColorExport);
+            }
+            else
+            {
+                // NOTE: A unit of several stages is keyed by the hashes of all of them, so that the key of a single
+                // stage unit (as in a VS-FS pipeline) stays the same.
+                MetroHash64 hasher;
+                for (uint32_t stage = firstStage; stage < ShaderStageGfxCount; ++stage)
+                {
+                    if ((unitStageMask & ShaderStageToMask(static_cast<ShaderStage>(stage))) != 0)
+                    {
+                        hasher.Update(PipelineDumper::GenerateHashForGraphicsPipeline(
+                            pPipelineInfo, true, stage, cl::RelocatableGenericColorExport));
+                    }
+                }
+                hasher.Finalize(cacheHash.bytes);
+            }
 #if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38
             pUserShaderCache = pPipelineInfo->pShaderCache;
 #endif
@@ -878,7 +1180,7 @@ Result Compiler::BuildPipelineWithRelocatableElf(
         else
         {
             auto pPipelineInfo = reinterpret_cast<const ComputePipelineBuildInfo*>(pContext->GetPipelineBuildInfo());
-            cacheHash = PipelineDumper::GenerateHashForComputePipeline(pPipelineInfo, true);
+            cacheHash = PipelineDumper::GenerateHashForComputePipeline(pPipelineInfo, true, true);
 #if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38
             pUserShaderCache = pPipelineInfo->pShaderCache;
 #endif
@@ -886,20 +1188,26 @@ Result Compiler::BuildPipelineWithRelocatableElf(
 
         ShaderEntryState cacheEntryState  = ShaderEntryState::New;
         BinaryData elfBin = {};
+        std::shared_ptr<void> elfStorage;
 
         ShaderCache* pShaderCache;
         CacheEntryHandle hEntry;
-        cacheEntryState = LookUpShaderCaches(pUserShaderCache, &cacheHash, &elfBin, &pShaderCache, &hEntry);
+        cacheEntryState = LookUpShaderCaches(pUserShaderCache,
+                                             &cacheHash,
+                                             &elfBin,
+                                             &elfStorage,
+                                             &pShaderCache,
+                                             &hEntry);
 
         if (cacheEntryState == ShaderEntryState::Ready) {
             auto pData = reinterpret_cast<const char*>(elfBin.pCode);
-            elf[stage].assign(pData, pData + elfBin.codeSize);
+            elf[firstStage].assign(pData, pData + elfBin.codeSize);
             continue;
         }
 
         // There was a cache miss, so we need to build the relocatable shader for
-        // this stage.
-        const PipelineShaderInfo* singleStageShaderInfo[ShaderStageNativeStageCount] =
+        // this unit.
+        const PipelineShaderInfo* unitShaderInfo[ShaderStageNativeStageCount] =
         {
             nullptr,
             nullptr,
@@ -908,23 +1216,33 @@ Result Compiler::BuildPipelineWithRelocatableElf(
             nullptr,
             nullptr
         };
-        singleStageShaderInfo[stage] = shaderInfo[stage];
+        for (uint32_t stage = 0; stage < shaderInfo.size(); ++stage)
+        {
+            if ((unitStageMask & ShaderStageToMask(static_cast<ShaderStage>(stage))) != 0)
+            {
+                unitShaderInfo[stage] = shaderInfo[stage];
+            }
+        }
 
-        result = BuildPipelineInternal(pContext, singleStageShaderInfo, forceLoopUnrollCount, &elf[stage]);
+        result = BuildPipelineInternal(pContext, unitShaderInfo, forceLoopUnrollCount, &elf[firstStage]);
 
         // Add the result to the cache.
         if (result == Result::Success)
         {
-            elfBin.codeSize = elf[stage].size();
-            elfBin.pCode = elf[stage].data();
+            elfBin.codeSize = elf[firstStage].size();
+            elfBin.pCode = elf[firstStage].data();
         }
         UpdateShaderCache((result == Result::Success), &elfBin, pShaderCache, hEntry);
     }
     pContext->GetPipelineContext()->SetShaderStageMask(originalShaderStageMask);
     pContext->GetBuilderContext()->SetBuildRelocatableElf(false);
+    pContext->GetBuilderContext()->SetGenericColorExport(false);
 
     // Link the relocatable shaders into a single pipeline elf file.
-    LinkRelocatableShaderElf(elf, pPipelineElf, pContext);
+    if (result == Result::Success)
+    {
+        result = LinkRelocatableShaderElf(elf, pPipelineElf, pContext);
+    }
 
     return result;
 }
@@ -942,14 +1260,8 @@ bool Compiler::CanUseRelocatableGraphicsShaderElf(
     bool useRelocatableShaderElf = true;
     for (uint32_t stage = 0; stage < shaderInfo.size(); ++stage)
     {
-        if (stage != ShaderStageVertex && stage != ShaderStageFragment)
-        {
-            if ((shaderInfo[stage] != nullptr) && (shaderInfo[stage]->pModuleData != nullptr))
-            {
-                useRelocatableShaderElf = false;
-            }
-        }
-        else if (shaderInfo[stage] == nullptr || shaderInfo[stage]->pModuleData == nullptr)
+        if ((stage == ShaderStageVertex || stage == ShaderStageFragment) &&
+            (shaderInfo[stage] == nullptr || shaderInfo[stage]->pModuleData == nullptr))
         {
             // TODO: Generate pass-through shaders when the fragment or vertex shaders are missing.
             useRelocatableShaderElf = false;
@@ -1069,6 +1381,22 @@ Result Compiler::BuildPipelineInternal(
     // into a single pipeline module.
     if (pipelineModule == nullptr)
     {
+        // NOTE: If enabled, translate and lower the SPIR-V shader stages concurrently, each in its own context. The
+        // lowered modules come back as bitcode, which is loaded below in the same way as a MultiLlvmBc shader module,
+        // so those stages are skipped by the serial translate and lower loops. This relies on BuilderRecorder, as the
+        // recorded Builder calls are replayed in the pipeline context after linking.
+        std::vector<ElfPackage> stageBitcodes;
+        if (cl::EnableParallelStageLower &&
+            UseBuilderRecorder &&
+            (EnableOuts() == false) &&
+            pContext->IsGraphics() &&
+            (countPopulation(pContext->GetShaderStageMask()) > 1))
+        {
+            timerProfiler.StartStopTimer(TimerTranslate, true);
+            result = LowerShaderStages(pContext, shaderInfo, forceLoopUnrollCount, &stageBitcodes);
+            timerProfiler.StartStopTimer(TimerTranslate, false);
+        }
+
         // Create empty modules and set target machine in each.
         std::vector<Module*> modules(shaderInfo.size());
         uint32_t stageSkipMask = 0;
@@ -1084,7 +1412,26 @@ Result Compiler::BuildPipelineInternal(
                 reinterpret_cast<const ShaderModuleDataEx*>(pShaderInfo->pModuleData);
 
             Module* pModule = nullptr;
-            if (pModuleDataEx->common.binType == BinaryType::MultiLlvmBc)
+            if ((stageBitcodes.empty() == false) && (stageBitcodes[shaderIndex].empty() == false))
+            {
+                timerProfiler.StartStopTimer(TimerLoadBc, true);
+
+                BinaryData binCode = {};
+                binCode.codeSize = stageBitcodes[shaderIndex].size();
+                binCode.pCode = stageBitcodes[shaderIndex].data();
+                pModule = pContext->LoadLibary(&binCode).release();
+                if (pModule != nullptr)
+                {
+                    stageSkipMask |= ShaderStageToMask(pShaderInfo->entryStage);
+                }
+                else
+                {
+                    result = Result::ErrorInvalidShader;
+                }
+
+                timerProfiler.StartStopTimer(TimerLoadBc, false);
+            }
+            else if (pModuleDataEx->common.binType == BinaryType::MultiLlvmBc)
             {
                 timerProfiler.StartStopTimer(TimerLoadBc, true);
 
@@ -1130,7 +1477,10 @@ Result Compiler::BuildPipelineInternal(
             }
 
             modules[shaderIndex] = pModule;
-            pContext->SetModuleTargetMachine(pModule);
+            if (pModule != nullptr)
+            {
+                pContext->SetModuleTargetMachine(pModule);
+            }
         }
 
         for (uint32_t shaderIndex = 0; (shaderIndex < shaderInfo.size()) && (result == Result::Success); ++shaderIndex)
@@ -1221,27 +1571,58 @@ Result Compiler::BuildPipelineInternal(
 
     Pipeline::CheckShaderCacheFunc checkShaderCacheFunc =
             [&graphicsShaderCacheChecker](
-        const Module*               pModule,      // [in] Module
-        uint32_t                    stageMask,    // Shader stage mask
-        ArrayRef<ArrayRef<uint8_t>> stageHashes)  // Per-stage hash of in/out usage
+        const Module*               pModule,        // [in] Module
+        uint32_t                    stageMask,      // Shader stage mask
+        ArrayRef<uint64_t>          stageHashes,    // Per-stage inter-shader data tracking hash
+        uint32_t                    hashStageMask)  // Mask of shader stages that have a tracking hash
     {
-        return graphicsShaderCacheChecker.Check(pModule, stageMask, stageHashes);
+        return graphicsShaderCacheChecker.Check(pModule, stageMask, stageHashes, hashStageMask);
     };
 
     // Only enable per stage cache for full graphic pipeline
+    // NOTE: A fast build does not use the per stage cache, so that it is only ever populated with fully optimized
+    // shaders.
     bool checkPerStageCache = cl::EnablePerStageCache && pContext->IsGraphics() &&
                               !buildingRelocatableElf &&
+                              !pContext->GetPipelineContext()->IsFastCompile() &&
                               (pContext->GetShaderStageMask() &
                                (ShaderStageToMask(ShaderStageVertex) | ShaderStageToMask(ShaderStageFragment)));
     if (checkPerStageCache == false)
     {
         checkShaderCacheFunc = nullptr;
     }
+    else if (pipelineModule != nullptr)
+    {
+        // Initialize the inter-shader data tracking hash of each shader with its input hash. Middle-end passes fold
+        // into it any data from other shaders that they use, so it ends up being the per-stage shader cache key.
+        for (Function& func : *pipelineModule)
+        {
+            if (func.isDeclaration() || (func.getLinkage() == GlobalValue::InternalLinkage))
+            {
+                continue;
+            }
+            ShaderStage stage = GetShaderStageFromFunction(&func);
+            if ((stage != ShaderStageInvalid) && (stage < ShaderStageGfxCount))
+            {
+                SetShaderHash(&func, BuildShaderInputHash(pContext, stage));
+            }
+        }
+    }
 
     // Generate pipeline.
     raw_svector_ostream elfStream(*pPipelineElf);
 
-    if (result == Result::Success)
+    // If enabled, allow the middle-end to code-generate the fragment shader separately, in parallel with the other
+    // shader stages. Its ELF is then merged into the pipeline ELF below.
+    ElfPackage fragmentElf;
+    raw_svector_ostream fragmentElfStream(fragmentElf);
+    raw_pwrite_stream* pFragmentElfStream = nullptr;
+    if (cl::EnableParallelCodeGen && pContext->IsGraphics() && (buildingRelocatableElf == false))
+    {
+        pFragmentElfStream = &fragmentElfStream;
+    }
+
+    if (result == Result::Success)
     {
         result = Result::ErrorInvalidShader;
 #if LLPC_ENABLE_EXCEPTION
@@ -1254,7 +1635,21 @@ Result Compiler::BuildPipelineInternal(
                 timerProfiler.GetTimer(TimerCodeGen),
             };
 
-            pipeline->Generate(std::move(pipelineModule), elfStream, checkShaderCacheFunc, timers);
+            // The fragment shader is code-generated as a job on the thread pool. Whichever thread waits for it first
+            // runs it, if no worker has started it yet.
+            Pipeline::RunAsyncFunc runAsyncFunc = [this](std::function<void()> task) -> std::function<void()>
+            {
+                auto job = std::make_shared<ThreadPoolJob>(std::move(task));
+                GetThreadPool()->Submit(job, JobPriority::High);
+                return [job]{ job->Wait(); };
+            };
+
+            pipeline->Generate(std::move(pipelineModule),
+                               elfStream,
+                               checkShaderCacheFunc,
+                               timers,
+                               pFragmentElfStream,
+                               runAsyncFunc);
             result = Result::Success;
         }
 #if LLPC_ENABLE_EXCEPTION
@@ -1264,6 +1659,32 @@ Result Compiler::BuildPipelineInternal(
 #endif
     }
 
+    if ((result == Result::Success) && (fragmentElf.empty() == false))
+    {
+        // The fragment shader was code-generated separately, so merge its ELF into the pipeline ELF.
+        const auto pHeader = reinterpret_cast<const Elf64::FormatHeader*>(pPipelineElf->data());
+        if ((pPipelineElf->size() >= sizeof(Elf64::FormatHeader)) && (pHeader->e_ident32[EI_MAG0] == ElfMagic))
+        {
+            ElfPackage nonFragmentElf = *pPipelineElf;
+            pPipelineElf->clear();
+
+            ElfWriter<Elf64> writer(pContext->GetGfxIpVersion());
+            result = writer.ReadFromBuffer(nonFragmentElf.data(), nonFragmentElf.size());
+            if (result == Result::Success)
+            {
+                BinaryData fragmentElfBin = {};
+                fragmentElfBin.codeSize = fragmentElf.size();
+                fragmentElfBin.pCode = fragmentElf.data();
+                writer.MergeElfBinary(pContext, &fragmentElfBin, pPipelineElf);
+            }
+        }
+        else
+        {
+            // Not ELF (e.g. "-filetype=asm"), so just append the fragment shader output.
+            pPipelineElf->append(fragmentElf.begin(), fragmentElf.end());
+        }
+    }
+
     if (checkPerStageCache)
     {
         // For graphics, update shader caches with results of compile, and merge ELF outputs if necessary.
@@ -1283,15 +1704,137 @@ Result Compiler::BuildPipelineInternal(
     return result;
 }
 
+// =====================================================================================================================
+// Translate and lower the SPIR-V shader stages of a pipeline concurrently, one thread pool job per stage. Each job
+// acquires its own context from the context pool, so the stages do not share any LLVM state. A job that no worker has
+// started yet is run on this thread when it is waited for, so this does not block a pool thread that calls it. The
+// lowered shader modules are returned as bitcode indexed in the same way as shaderInfo; an entry is left empty for a
+// stage that is absent or is not SPIR-V.
+Result Compiler::LowerShaderStages(
+    Context*                            pContext,               // [in] Acquired context of the pipeline build
+    ArrayRef<const PipelineShaderInfo*> shaderInfo,             // [in] Shader info of this pipeline
+    uint32_t                            forceLoopUnrollCount,   // Force loop unroll count (0 means disable)
+    std::vector<ElfPackage>*            pStageBitcodes          // [out] Lowered LLVM bitcode of each shader stage
+    ) const
+{
+    PipelineContext* pPipelineContext = pContext->GetPipelineContext();
+    std::vector<Result> results(shaderInfo.size(), Result::Success);
+    std::vector<std::shared_ptr<ThreadPoolJob>> lowerJobs;
+
+    pStageBitcodes->clear();
+    pStageBitcodes->resize(shaderInfo.size());
+
+    for (uint32_t shaderIndex = 0; shaderIndex < shaderInfo.size(); ++shaderIndex)
+    {
+        const PipelineShaderInfo* pShaderInfo = shaderInfo[shaderIndex];
+        if ((pShaderInfo == nullptr) || (pShaderInfo->pModuleData == nullptr))
+        {
+            continue;
+        }
+
+        const ShaderModuleData* pModuleData = reinterpret_cast<const ShaderModuleData*>(pShaderInfo->pModuleData);
+        if (pModuleData->binType != BinaryType::Spirv)
+        {
+            continue;
+        }
+
+        Result* pResult = &results[shaderIndex];
+        ElfPackage* pBitcode = &(*pStageBitcodes)[shaderIndex];
+        lowerJobs.push_back(std::make_shared<ThreadPoolJob>([=]
+        {
+            *pResult = LowerShaderStageToBitcode(pPipelineContext, pShaderInfo, forceLoopUnrollCount, pBitcode);
+        }));
+        GetThreadPool()->Submit(lowerJobs.back(), JobPriority::Normal);
+    }
+
+    for (auto& lowerJob : lowerJobs)
+    {
+        lowerJob->Wait();
+    }
+
+    Result result = Result::Success;
+    for (uint32_t shaderIndex = 0; shaderIndex < shaderInfo.size(); ++shaderIndex)
+    {
+        if (results[shaderIndex] != Result::Success)
+        {
+            result = results[shaderIndex];
+            break;
+        }
+    }
+    return result;
+}
+
+// =====================================================================================================================
+// Translate and lower a single SPIR-V shader stage in a context of its own, writing the lowered module as bitcode.
+// This uses a BuilderRecorder without a pipeline, the same as a shader module build, so that the shader modes are
+// recorded in IR metadata and picked up again when the pipeline is linked.
+Result Compiler::LowerShaderStageToBitcode(
+    PipelineContext*          pPipelineContext,       // [in] Pipeline context of the pipeline being built
+    const PipelineShaderInfo* pShaderInfo,            // [in] Shader info of the stage to lower
+    uint32_t                  forceLoopUnrollCount,   // Force loop unroll count (0 means disable)
+    ElfPackage*               pBitcode                // [out] Lowered LLVM bitcode
+    ) const
+{
+    Result result = Result::Success;
+    ShaderStage entryStage = pShaderInfo->entryStage;
+
+    Context* pContext = AcquireContext(true);
+    pContext->AttachPipelineContext(pPipelineContext);
+    pContext->setDiagnosticHandler(std::make_unique<LlpcDiagnosticHandler>());
+    pContext->SetScalarBlockLayout(pPipelineContext->GetPipelineOptions()->scalarBlockLayout);
+    pContext->SetRobustBufferAccess(pPipelineContext->GetPipelineOptions()->robustBufferAccess);
+    pContext->SetBuilder(pContext->GetBuilderContext()->CreateBuilder(nullptr, true));
+    pContext->GetBuilder()->SetShaderStage(entryStage);
+
+    Module* pModule = new Module((Twine("llpc") + GetShaderStageName(entryStage)).str() +
+                                 std::to_string(GetModuleIdByIndex(entryStage)), *pContext);
+    pContext->SetModuleTargetMachine(pModule);
+
+    {
+        raw_svector_ostream bitcodeStream(*pBitcode);
+        uint32_t passIndex = 0;
+        std::unique_ptr<PassManager> lowerPassMgr(PassManager::Create());
+        lowerPassMgr->SetPassIndex(&passIndex);
+
+        // SPIR-V translation, per-shader SPIR-V lowering, then write out the bitcode.
+        lowerPassMgr->add(CreateSpirvLowerTranslator(entryStage, pShaderInfo));
+        SpirvLower::AddPasses(pContext, entryStage, *lowerPassMgr, nullptr, forceLoopUnrollCount);
+        lowerPassMgr->add(createBitcodeWriterPass(bitcodeStream));
+
+        // Run the passes.
+        bool success = RunPasses(&*lowerPassMgr, pModule);
+        if (success == false)
+        {
+            LLPC_ERRS("Failed to translate SPIR-V or run per-shader passes\n");
+            result = Result::ErrorInvalidShader;
+            pBitcode->clear();
+        }
+    }
+
+    delete pModule;
+    pContext->setDiagnosticHandlerCallBack(nullptr);
+    ReleaseContext(pContext);
+
+    return result;
+}
+
 // =====================================================================================================================
 // Check shader cache for graphics pipeline, returning mask of which shader stages we want to keep in this compile.
 // This is called from the PatchCheckShaderCache pass (via a lambda in BuildPipelineInternal), to remove
 // shader stages that we don't want because there was a shader cache hit.
 uint32_t GraphicsShaderCacheChecker::Check(
-    const Module*               pModule,      // [in] Module
-    uint32_t                    stageMask,    // Shader stage mask
-    ArrayRef<ArrayRef<uint8_t>> stageHashes)  // Per-stage hash of in/out usage
+    const Module*               pModule,        // [in] Module
+    uint32_t                    stageMask,      // Shader stage mask
+    ArrayRef<uint64_t>          stageHashes,    // Per-stage inter-shader data tracking hash
+    uint32_t                    hashStageMask)  // Mask of shader stages that have a tracking hash
 {
+    // NOTE: A shader without an inter-shader data tracking hash (e.g. from a pipeline given as a single IR module)
+    // cannot be checked against the per-stage shader cache, so the whole pipeline is compiled.
+    if ((stageMask & ~hashStageMask) != 0)
+    {
+        return stageMask;
+    }
+
     // Check per stage shader cache
     MetroHash::Hash fragmentHash = {};
     MetroHash::Hash nonFragmentHash = {};
@@ -1307,6 +1850,7 @@ uint32_t GraphicsShaderCacheChecker::Check(
         m_fragmentCacheEntryState = m_pCompiler->LookUpShaderCaches(pAppCache,
                                                                     &fragmentHash,
                                                                     &m_fragmentElf,
+                                                                    &m_fragmentElfStorage,
                                                                     &m_pFragmentShaderCache,
                                                                     &m_hFragmentEntry);
     }
@@ -1316,6 +1860,7 @@ uint32_t GraphicsShaderCacheChecker::Check(
         m_nonFragmentCacheEntryState = m_pCompiler->LookUpShaderCaches(pAppCache,
                                                                        &nonFragmentHash,
                                                                        &m_nonFragmentElf,
+                                                                       &m_nonFragmentElfStorage,
                                                                        &m_pNonFragmentShaderCache,
                                                                        &m_hNonFragmentEntry);
     }
@@ -1494,8 +2039,29 @@ Result Compiler::BuildGraphicsPipeline(
     GraphicsPipelineBuildOut*        pPipelineOut,      // [out] Output of building this graphics pipeline
     void*                            pPipelineDumpFile) // [in] Handle of pipeline dump file
 {
-    Result           result = Result::Success;
-    BinaryData       elfBin = {};
+    return BuildGraphicsPipelineWithTier(pPipelineInfo,
+                                         pPipelineOut,
+                                         pPipelineDumpFile,
+                                         PipelineTier::Full,
+                                         nullptr,
+                                         nullptr);
+}
+
+// =====================================================================================================================
+// Build graphics pipeline from the specified info, at the specified optimization tier.
+Result Compiler::BuildGraphicsPipelineWithTier(
+    const GraphicsPipelineBuildInfo* pPipelineInfo,     // [in] Info to build this graphics pipeline
+    GraphicsPipelineBuildOut*        pPipelineOut,      // [out] Output of building this graphics pipeline, or nullptr
+                                                        //       to only update the shader cache
+    void*                            pPipelineDumpFile, // [in] Handle of pipeline dump file
+    PipelineTier                     tier,              // Optimization tier of the build
+    bool*                            pIsUpgraded,       // [out] Whether a fast build was found in the shader cache
+                                                        //       already upgraded (optional)
+    IPipelineBinaryView**            ppView)            // [out] View of the pipeline binary (optional)
+{
+    Result                result = Result::Success;
+    BinaryData            elfBin = {};
+    std::shared_ptr<void> elfStorage;
 
     const PipelineShaderInfo* shaderInfo[ShaderStageGfxCount] =
     {
@@ -1547,6 +2113,10 @@ Result Compiler::BuildGraphicsPipeline(
         PipelineDumper::DumpPipelineExtraInfo(reinterpret_cast<PipelineDumpFile*>(pPipelineDumpFile), &extraInfo);
     }
 
+    // NOTE: A fast build is cached under a hash of its own, so that a fully optimized build never picks it up.
+    MetroHash::Hash fastCacheHash = GetFastCompileCacheHash(cacheHash);
+    MetroHash::Hash* pLookUpHash = (tier == PipelineTier::Fast) ? &fastCacheHash : &cacheHash;
+
     ShaderEntryState cacheEntryState  = ShaderEntryState::New;
     bool buildingRelocatableElf = CanUseRelocatableGraphicsShaderElf(shaderInfo);
     IShaderCache* pAppCache = nullptr;
@@ -1558,7 +2128,13 @@ Result Compiler::BuildGraphicsPipeline(
 
     if (!buildingRelocatableElf)
     {
-        cacheEntryState = LookUpShaderCaches(pAppCache, &cacheHash, &elfBin, &pShaderCache, &hEntry);
+        cacheEntryState = LookUpShaderCaches(pAppCache,
+                                             pLookUpHash,
+                                             &elfBin,
+                                             &elfStorage,
+                                             &pShaderCache,
+                                             &hEntry,
+                                             pIsUpgraded);
     }
     else
     {
@@ -1575,6 +2151,7 @@ Result Compiler::BuildGraphicsPipeline(
                                         pPipelineInfo,
                                         &pipelineHash,
                                         &cacheHash);
+        graphicsContext.SetFastCompile(tier == PipelineTier::Fast);
         result = BuildGraphicsPipelineInternal(&graphicsContext,
                                                shaderInfo,
                                                forceLoopUnrollCount,
@@ -1591,7 +2168,32 @@ Result Compiler::BuildGraphicsPipeline(
             UpdateShaderCache((result == Result::Success), &elfBin, pShaderCache, hEntry);
     }
 
-    if (result == Result::Success)
+    if ((result == Result::Success) && (tier == PipelineTier::Upgrade) && (buildingRelocatableElf == false))
+    {
+        UpgradeShaderCaches(pAppCache, &fastCacheHash, &elfBin);
+    }
+
+    if ((result == Result::Success) && (ppView != nullptr))
+    {
+        // Hand out a view rather than a copy of the binary. On a shader cache hit, the view refers to the storage of
+        // the cache entry; a newly built binary is moved into the view.
+        if (elfBin.pCode == candidateElf.data())
+        {
+            *ppView = new PipelineBinaryView(std::move(candidateElf));
+        }
+        else if (elfStorage != nullptr)
+        {
+            *ppView = new PipelineBinaryView(std::move(elfStorage), elfBin);
+        }
+        else
+        {
+            candidateElf.assign(static_cast<const char*>(elfBin.pCode),
+                                static_cast<const char*>(elfBin.pCode) + elfBin.codeSize);
+            *ppView = new PipelineBinaryView(std::move(candidateElf));
+        }
+    }
+
+    if ((result == Result::Success) && (pPipelineOut != nullptr))
     {
         void* pAllocBuf = nullptr;
         if (pPipelineInfo->pfnOutputAlloc != nullptr)
@@ -1614,6 +2216,420 @@ Result Compiler::BuildGraphicsPipeline(
     return result;
 }
 
+// =====================================================================================================================
+// Gets the thread pool for asynchronous and batched builds, creating it on first use.
+ThreadPool* Compiler::GetThreadPool() const
+{
+    std::lock_guard<std::mutex> lock(m_threadPoolLock);
+    if (m_threadPool == nullptr)
+    {
+        m_threadPool.reset(new ThreadPool(cl::AsyncBuildThreadCount));
+    }
+    return m_threadPool.get();
+}
+
+// =====================================================================================================================
+// Submits an asynchronous pipeline build to the thread pool.
+Result Compiler::SubmitPipelineBuild(
+    std::function<Result()> build,      // Function that runs the synchronous build
+    PipelineBuildPriority   priority,   // Priority of the build
+    IPipelineBuildJob**     ppJob)      // [out] Job of the build
+{
+    if (ppJob == nullptr)
+    {
+        return Result::ErrorInvalidPointer;
+    }
+
+    static_assert(static_cast<uint32_t>(PipelineBuildPriority::Background) ==
+                  static_cast<uint32_t>(JobPriority::Low), "Unexpected value!");
+    static_assert(static_cast<uint32_t>(PipelineBuildPriority::Normal) ==
+                  static_cast<uint32_t>(JobPriority::Normal), "Unexpected value!");
+    static_assert(static_cast<uint32_t>(PipelineBuildPriority::Urgent) ==
+                  static_cast<uint32_t>(JobPriority::High), "Unexpected value!");
+
+    if (static_cast<uint32_t>(priority) > static_cast<uint32_t>(PipelineBuildPriority::Urgent))
+    {
+        return Result::ErrorInvalidValue;
+    }
+
+    PipelineBuildJob* pJob = new PipelineBuildJob(std::move(build));
+    GetThreadPool()->Submit(pJob->GetJob(), static_cast<JobPriority>(priority));
+    *ppJob = pJob;
+    return Result::Success;
+}
+
+// =====================================================================================================================
+// Starts an asynchronous build of a graphics pipeline from the specified info.
+Result Compiler::BuildGraphicsPipelineAsync(
+    const GraphicsPipelineBuildInfo* pPipelineInfo,     // [in] Info to build this graphics pipeline
+    GraphicsPipelineBuildOut*        pPipelineOut,      // [out] Output of building this graphics pipeline
+    PipelineBuildPriority            priority,          // Priority of the build
+    IPipelineBuildJob**              ppJob)             // [out] Job of the build
+{
+    return SubmitPipelineBuild([this, pPipelineInfo, pPipelineOut]
+                               {
+                                   return BuildGraphicsPipeline(pPipelineInfo, pPipelineOut, nullptr);
+                               },
+                               priority,
+                               ppJob);
+}
+
+// =====================================================================================================================
+// Starts an asynchronous build of a compute pipeline from the specified info.
+Result Compiler::BuildComputePipelineAsync(
+    const ComputePipelineBuildInfo* pPipelineInfo,      // [in] Info to build this compute pipeline
+    ComputePipelineBuildOut*        pPipelineOut,       // [out] Output of building this compute pipeline
+    PipelineBuildPriority           priority,           // Priority of the build
+    IPipelineBuildJob**             ppJob)              // [out] Job of the build
+{
+    return SubmitPipelineBuild([this, pPipelineInfo, pPipelineOut]
+                               {
+                                   return BuildComputePipeline(pPipelineInfo, pPipelineOut, nullptr);
+                               },
+                               priority,
+                               ppJob);
+}
+
+// =====================================================================================================================
+// Builds a graphics pipeline, returning a read-only view of the pipeline binary instead of a copy of it in memory from
+// the output allocator.
+Result Compiler::BuildGraphicsPipelineView(
+    const GraphicsPipelineBuildInfo* pPipelineInfo,     // [in] Info to build this graphics pipeline
+    IPipelineBinaryView**            ppView)            // [out] View of the pipeline binary
+{
+    if (ppView == nullptr)
+    {
+        return Result::ErrorInvalidPointer;
+    }
+
+    *ppView = nullptr;
+    return BuildGraphicsPipelineWithTier(pPipelineInfo, nullptr, nullptr, PipelineTier::Full, nullptr, ppView);
+}
+
+// =====================================================================================================================
+// Builds a compute pipeline, returning a read-only view of the pipeline binary instead of a copy of it in memory from
+// the output allocator.
+Result Compiler::BuildComputePipelineView(
+    const ComputePipelineBuildInfo* pPipelineInfo,      // [in] Info to build this compute pipeline
+    IPipelineBinaryView**           ppView)             // [out] View of the pipeline binary
+{
+    if (ppView == nullptr)
+    {
+        return Result::ErrorInvalidPointer;
+    }
+
+    *ppView = nullptr;
+    return BuildComputePipelineWithTier(pPipelineInfo, nullptr, nullptr, PipelineTier::Full, nullptr, ppView);
+}
+
+// =====================================================================================================================
+// Builds a graphics pipeline with minimal optimization, optionally starting a fully optimized rebuild in the
+// background which replaces the fast build in the shader cache.
+Result Compiler::BuildGraphicsPipelineFast(
+    const GraphicsPipelineBuildInfo* pPipelineInfo,     // [in] Info to build this graphics pipeline
+    GraphicsPipelineBuildOut*        pPipelineOut,      // [out] Output of building this graphics pipeline
+    IPipelineBuildJob**              ppUpgradeJob)      // [out] Job of the fully optimized rebuild (optional)
+{
+    bool isUpgraded = false;
+    Result result = BuildGraphicsPipelineWithTier(pPipelineInfo,
+                                                  pPipelineOut,
+                                                  nullptr,
+                                                  PipelineTier::Fast,
+                                                  &isUpgraded,
+                                                  nullptr);
+
+    if (ppUpgradeJob != nullptr)
+    {
+        *ppUpgradeJob = nullptr;
+        if ((result == Result::Success) && (isUpgraded == false))
+        {
+            result = SubmitPipelineBuild([this, pPipelineInfo]
+                                         {
+                                             return BuildGraphicsPipelineWithTier(pPipelineInfo,
+                                                                                  nullptr,
+                                                                                  nullptr,
+                                                                                  PipelineTier::Upgrade,
+                                                                                  nullptr,
+                                                                                  nullptr);
+                                         },
+                                         PipelineBuildPriority::Background,
+                                         ppUpgradeJob);
+        }
+    }
+    return result;
+}
+
+// =====================================================================================================================
+// Builds a compute pipeline with minimal optimization, optionally starting a fully optimized rebuild in the
+// background which replaces the fast build in the shader cache.
+Result Compiler::BuildComputePipelineFast(
+    const ComputePipelineBuildInfo* pPipelineInfo,      // [in] Info to build this compute pipeline
+    ComputePipelineBuildOut*        pPipelineOut,       // [out] Output of building this compute pipeline
+    IPipelineBuildJob**             ppUpgradeJob)       // [out] Job of the fully optimized rebuild (optional)
+{
+    bool isUpgraded = false;
+    Result result = BuildComputePipelineWithTier(pPipelineInfo,
+                                                 pPipelineOut,
+                                                 nullptr,
+                                                 PipelineTier::Fast,
+                                                 &isUpgraded,
+                                                 nullptr);
+
+    if (ppUpgradeJob != nullptr)
+    {
+        *ppUpgradeJob = nullptr;
+        if ((result == Result::Success) && (isUpgraded == false))
+        {
+            result = SubmitPipelineBuild([this, pPipelineInfo]
+                                         {
+                                             return BuildComputePipelineWithTier(pPipelineInfo,
+                                                                                 nullptr,
+                                                                                 nullptr,
+                                                                                 PipelineTier::Upgrade,
+                                                                                 nullptr,
+                                                                                 nullptr);
+                                         },
+                                         PipelineBuildPriority::Background,
+                                         ppUpgradeJob);
+        }
+    }
+    return result;
+}
+
+// =====================================================================================================================
+// Builds a batch of graphics pipelines. A SPIR-V shader stage that is used by more than one pipeline of the batch, with
+// the same specialization, options and resource mapping, is translated and lowered only once, and each pipeline that
+// uses it picks up the lowered bitcode in the same way as a MultiLlvmBc shader module. The pipelines are then built
+// concurrently on the compiler's thread pool.
+Result Compiler::BuildGraphicsPipelines(
+    uint32_t                                pipelineCount,      // Count of graphics pipelines to build
+    const GraphicsPipelineBuildInfo*const*  ppPipelineInfos,    // [in] Info to build each graphics pipeline
+    GraphicsPipelineBuildOut*               pPipelineOuts,      // [out] Output of building each graphics pipeline
+    Result*                                 pResults)           // [out] Result of building each graphics pipeline
+                                                                //       (optional)
+{
+    if ((pipelineCount > 0) && ((ppPipelineInfos == nullptr) || (pPipelineOuts == nullptr)))
+    {
+        return Result::ErrorInvalidPointer;
+    }
+
+    for (uint32_t pipelineIndex = 0; pipelineIndex < pipelineCount; ++pipelineIndex)
+    {
+        if (ppPipelineInfos[pipelineIndex] == nullptr)
+        {
+            return Result::ErrorInvalidPointer;
+        }
+    }
+
+    // Take copies of the build infos, so that shared stages can be substituted without modifying the caller's infos.
+    std::vector<GraphicsPipelineBuildInfo> pipelineInfos(pipelineCount);
+    for (uint32_t pipelineIndex = 0; pipelineIndex < pipelineCount; ++pipelineIndex)
+    {
+        pipelineInfos[pipelineIndex] = *ppPipelineInfos[pipelineIndex];
+    }
+
+    // When called from a job that is already on a thread of the pool, the jobs of the batch are run inline as they
+    // are waited for, rather than submitted, so the batch does not wait on the workers that are busy with it.
+    const bool submitJobs = (GetThreadPool()->IsWorkerThread() == false);
+
+    // NOTE: The lowered stages rely on BuilderRecorder, as the recorded Builder calls are replayed in the context of
+    // each pipeline that uses them. Shared stages are not lowered up front when building relocatable shader ELF,
+    // which requires SPIR-V input, or when outputs are enabled, where the pipelines are built one after the other
+    // to keep their dumps apart.
+    std::unordered_map<uint64_t, std::unique_ptr<SharedShaderStage>> sharedStages;
+    std::vector<SharedShaderStage*> stageUses(pipelineCount * ShaderStageGfxCount, nullptr);
+    if (UseBuilderRecorder && (cl::UseRelocatableShaderElf == false) && (EnableOuts() == false))
+    {
+        // Find the SPIR-V stages of all pipelines, keyed by the hash of everything the front-end depends on.
+        for (uint32_t pipelineIndex = 0; pipelineIndex < pipelineCount; ++pipelineIndex)
+        {
+            const GraphicsPipelineBuildInfo* pPipelineInfo = &pipelineInfos[pipelineIndex];
+            const PipelineShaderInfo* shaderInfo[ShaderStageGfxCount] =
+            {
+                &pPipelineInfo->vs,
+                &pPipelineInfo->tcs,
+                &pPipelineInfo->tes,
+                &pPipelineInfo->gs,
+                &pPipelineInfo->fs,
+            };
+
+            for (uint32_t stage = 0; stage < ShaderStageGfxCount; ++stage)
+            {
+                const PipelineShaderInfo* pShaderInfo = shaderInfo[stage];
+                const ShaderModuleData* pModuleData =
+                    reinterpret_cast<const ShaderModuleData*>(pShaderInfo->pModuleData);
+                if ((pModuleData == nullptr) ||
+                    (pModuleData->binType != BinaryType::Spirv) ||
+                    (pShaderInfo->entryStage != static_cast<ShaderStage>(stage)) ||
+                    (ValidatePipelineShaderInfo(pShaderInfo) != Result::Success))
+                {
+                    continue;
+                }
+
+                MetroHash64 hasher;
+                MetroHash::Hash stageHash = {};
+                PipelineDumper::UpdateHashForPipelineShaderInfo(static_cast<ShaderStage>(stage),
+                                                                pShaderInfo,
+                                                                true,
+                                                                &hasher);
+                hasher.Update(pPipelineInfo->options.robustBufferAccess);
+                hasher.Update(pPipelineInfo->options.scalarBlockLayout);
+                hasher.Update(static_cast<int32_t>(cl::ForceLoopUnrollCount));
+                hasher.Update(static_cast<bool>(cl::DisableLicm));
+                hasher.Finalize(stageHash.bytes);
+
+                auto& pSharedStage = sharedStages[MetroHash::Compact64(&stageHash)];
+                if (pSharedStage == nullptr)
+                {
+                    pSharedStage.reset(new SharedShaderStage());
+                    pSharedStage->pPipelineInfo = pPipelineInfo;
+                    pSharedStage->pShaderInfo = pShaderInfo;
+                }
+                ++pSharedStage->useCount;
+                stageUses[pipelineIndex * ShaderStageGfxCount + stage] = &*pSharedStage;
+            }
+        }
+
+        // Translate and lower each stage that is used more than once, concurrently, in the context of the first
+        // pipeline that uses it.
+        std::vector<std::shared_ptr<ThreadPoolJob>> lowerJobs;
+        for (auto& sharedStage : sharedStages)
+        {
+            SharedShaderStage* pSharedStage = &*sharedStage.second;
+            if (pSharedStage->useCount < 2)
+            {
+                continue;
+            }
+
+            lowerJobs.push_back(std::make_shared<ThreadPoolJob>([this, pSharedStage]
+            {
+                MetroHash::Hash pipelineHash = PipelineDumper::GenerateHashForGraphicsPipeline(
+                                                    pSharedStage->pPipelineInfo, false);
+                MetroHash::Hash cacheHash = PipelineDumper::GenerateHashForGraphicsPipeline(
+                                                    pSharedStage->pPipelineInfo, true);
+                GraphicsContext graphicsContext(m_gfxIp, pSharedStage->pPipelineInfo, &pipelineHash, &cacheHash);
+                pSharedStage->result = LowerShaderStageToBitcode(&graphicsContext,
+                                                                 pSharedStage->pShaderInfo,
+                                                                 cl::ForceLoopUnrollCount,
+                                                                 &pSharedStage->bitcode);
+            }));
+            if (submitJobs)
+            {
+                GetThreadPool()->Submit(lowerJobs.back(), JobPriority::Normal);
+            }
+        }
+
+        for (auto& lowerJob : lowerJobs)
+        {
+            lowerJob->Wait();
+        }
+
+        // Set up a single-entry MultiLlvmBc shader module for each lowered stage. The common module data, including
+        // the hash codes, is copied from the SPIR-V shader module, so the pipeline and cache hashes are unchanged.
+        for (auto& sharedStage : sharedStages)
+        {
+            SharedShaderStage* pSharedStage = &*sharedStage.second;
+            if ((pSharedStage->useCount < 2) || (pSharedStage->result != Result::Success))
+            {
+                continue;
+            }
+
+            const PipelineShaderInfo* pShaderInfo = pSharedStage->pShaderInfo;
+            ShaderModuleDataEx* pModuleDataEx = &pSharedStage->moduleDataEx;
+            ShaderModuleEntry* pShaderEntry = &pSharedStage->shaderEntry;
+
+            MetroHash64::Hash(reinterpret_cast<const uint8_t*>(pShaderInfo->pEntryTarget),
+                              strlen(pShaderInfo->pEntryTarget),
+                              reinterpret_cast<uint8_t*>(pShaderEntry->entryNameHash));
+            pShaderEntry->entryOffset = 0;
+            pShaderEntry->entrySize = pSharedStage->bitcode.size();
+
+            pModuleDataEx->common = *reinterpret_cast<const ShaderModuleData*>(pShaderInfo->pModuleData);
+            pModuleDataEx->common.binType = BinaryType::MultiLlvmBc;
+            pModuleDataEx->common.binCode.codeSize = pSharedStage->bitcode.size();
+            pModuleDataEx->common.binCode.pCode = pSharedStage->bitcode.data();
+            pModuleDataEx->extra.entryCount = 1;
+            pModuleDataEx->extra.entryDatas[0].stage = pShaderInfo->entryStage;
+            pModuleDataEx->extra.entryDatas[0].pEntryName = pShaderInfo->pEntryTarget;
+            pModuleDataEx->extra.entryDatas[0].pShaderEntry = pShaderEntry;
+            pSharedStage->isLowered = true;
+        }
+
+        // Substitute the lowered shader modules. A stage whose lowering failed is left as SPIR-V, so that the failure
+        // is reported by the build of the pipeline.
+        for (uint32_t pipelineIndex = 0; pipelineIndex < pipelineCount; ++pipelineIndex)
+        {
+            GraphicsPipelineBuildInfo* pPipelineInfo = &pipelineInfos[pipelineIndex];
+            PipelineShaderInfo* shaderInfo[ShaderStageGfxCount] =
+            {
+                &pPipelineInfo->vs,
+                &pPipelineInfo->tcs,
+                &pPipelineInfo->tes,
+                &pPipelineInfo->gs,
+                &pPipelineInfo->fs,
+            };
+
+            for (uint32_t stage = 0; stage < ShaderStageGfxCount; ++stage)
+            {
+                SharedShaderStage* pSharedStage = stageUses[pipelineIndex * ShaderStageGfxCount + stage];
+                if ((pSharedStage != nullptr) && pSharedStage->isLowered)
+                {
+                    shaderInfo[stage]->pModuleData = &pSharedStage->moduleDataEx;
+                }
+            }
+        }
+    }
+
+    // Build the pipelines.
+    std::vector<Result> results(pipelineCount, Result::Success);
+    if (EnableOuts())
+    {
+        for (uint32_t pipelineIndex = 0; pipelineIndex < pipelineCount; ++pipelineIndex)
+        {
+            results[pipelineIndex] = BuildGraphicsPipeline(&pipelineInfos[pipelineIndex],
+                                                           &pPipelineOuts[pipelineIndex],
+                                                           nullptr);
+        }
+    }
+    else
+    {
+        std::vector<std::shared_ptr<ThreadPoolJob>> buildJobs;
+        for (uint32_t pipelineIndex = 0; pipelineIndex < pipelineCount; ++pipelineIndex)
+        {
+            const GraphicsPipelineBuildInfo* pPipelineInfo = &pipelineInfos[pipelineIndex];
+            GraphicsPipelineBuildOut* pPipelineOut = &pPipelineOuts[pipelineIndex];
+            Result* pResult = &results[pipelineIndex];
+            buildJobs.push_back(std::make_shared<ThreadPoolJob>([this, pPipelineInfo, pPipelineOut, pResult]
+            {
+                *pResult = BuildGraphicsPipeline(pPipelineInfo, pPipelineOut, nullptr);
+            }));
+            if (submitJobs)
+            {
+                GetThreadPool()->Submit(buildJobs.back(), JobPriority::Normal);
+            }
+        }
+
+        for (auto& buildJob : buildJobs)
+        {
+            buildJob->Wait();
+        }
+    }
+
+    Result result = Result::Success;
+    for (uint32_t pipelineIndex = 0; pipelineIndex < pipelineCount; ++pipelineIndex)
+    {
+        if (pResults != nullptr)
+        {
+            pResults[pipelineIndex] = results[pipelineIndex];
+        }
+        if ((result == Result::Success) && (results[pipelineIndex] != Result::Success))
+        {
+            result = results[pipelineIndex];
+        }
+    }
+    return result;
+}
+
 // =====================================================================================================================
 // Build compute pipeline internally
 Result Compiler::BuildComputePipelineInternal(
@@ -1655,8 +2671,29 @@ Result Compiler::BuildComputePipeline(
     const ComputePipelineBuildInfo* pPipelineInfo,     // [in] Info to build this compute pipeline
     ComputePipelineBuildOut*        pPipelineOut,      // [out] Output of building this compute pipeline
     void*                           pPipelineDumpFile) // [in] Handle of pipeline dump file
+{
+    return BuildComputePipelineWithTier(pPipelineInfo,
+                                        pPipelineOut,
+                                        pPipelineDumpFile,
+                                        PipelineTier::Full,
+                                        nullptr,
+                                        nullptr);
+}
+
+// =====================================================================================================================
+// Build compute pipeline from the specified info, at the specified optimization tier.
+Result Compiler::BuildComputePipelineWithTier(
+    const ComputePipelineBuildInfo* pPipelineInfo,     // [in] Info to build this compute pipeline
+    ComputePipelineBuildOut*        pPipelineOut,      // [out] Output of building this compute pipeline, or nullptr
+                                                       //       to only update the shader cache
+    void*                           pPipelineDumpFile, // [in] Handle of pipeline dump file
+    PipelineTier                    tier,              // Optimization tier of the build
+    bool*                           pIsUpgraded,       // [out] Whether a fast build was found in the shader cache
+                                                       //       already upgraded (optional)
+    IPipelineBinaryView**           ppView)            // [out] View of the pipeline binary (optional)
 {
     BinaryData elfBin = {};
+    std::shared_ptr<void> elfStorage;
 
     bool buildingRelocatableElf = CanUseRelocatableComputeShaderElf(&pPipelineInfo->cs);
 
@@ -1691,6 +2728,10 @@ Result Compiler::BuildComputePipeline(
         PipelineDumper::DumpPipelineExtraInfo(reinterpret_cast<PipelineDumpFile*>(pPipelineDumpFile), &extraInfo);
     }
 
+    // NOTE: A fast build is cached under a hash of its own, so that a fully optimized build never picks it up.
+    MetroHash::Hash fastCacheHash = GetFastCompileCacheHash(cacheHash);
+    MetroHash::Hash* pLookUpHash = (tier == PipelineTier::Fast) ? &fastCacheHash : &cacheHash;
+
     ShaderEntryState cacheEntryState  = ShaderEntryState::New;
     IShaderCache* pAppCache = nullptr;
 #if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38
@@ -1701,7 +2742,13 @@ Result Compiler::BuildComputePipeline(
 
     if (!buildingRelocatableElf)
     {
-        cacheEntryState = LookUpShaderCaches(pAppCache, &cacheHash, &elfBin, &pShaderCache, &hEntry);
+        cacheEntryState = LookUpShaderCaches(pAppCache,
+                                             pLookUpHash,
+                                             &elfBin,
+                                             &elfStorage,
+                                             &pShaderCache,
+                                             &hEntry,
+                                             pIsUpgraded);
     }
     else
     {
@@ -1718,6 +2765,7 @@ Result Compiler::BuildComputePipeline(
                                       pPipelineInfo,
                                       &pipelineHash,
                                       &cacheHash);
+        computeContext.SetFastCompile(tier == PipelineTier::Fast);
 
         result = BuildComputePipelineInternal(&computeContext,
                                               pPipelineInfo,
@@ -1736,7 +2784,32 @@ Result Compiler::BuildComputePipeline(
         }
     }
 
-    if (result == Result::Success)
+    if ((result == Result::Success) && (tier == PipelineTier::Upgrade) && (buildingRelocatableElf == false))
+    {
+        UpgradeShaderCaches(pAppCache, &fastCacheHash, &elfBin);
+    }
+
+    if ((result == Result::Success) && (ppView != nullptr))
+    {
+        // Hand out a view rather than a copy of the binary. On a shader cache hit, the view refers to the storage of
+        // the cache entry; a newly built binary is moved into the view.
+        if (elfBin.pCode == candidateElf.data())
+        {
+            *ppView = new PipelineBinaryView(std::move(candidateElf));
+        }
+        else if (elfStorage != nullptr)
+        {
+            *ppView = new PipelineBinaryView(std::move(elfStorage), elfBin);
+        }
+        else
+        {
+            candidateElf.assign(static_cast<const char*>(elfBin.pCode),
+                                static_cast<const char*>(elfBin.pCode) + elfBin.codeSize);
+            *ppView = new PipelineBinaryView(std::move(candidateElf));
+        }
+    }
+
+    if ((result == Result::Success) && (pPipelineOut != nullptr))
     {
         void* pAllocBuf = nullptr;
         if (pPipelineInfo->pfnOutputAlloc != nullptr)
@@ -1779,13 +2852,24 @@ MetroHash::Hash Compiler::GenerateHashForCompileOptions(
         cl::EnablePipelineDump.ArgStr,
         cl::ShaderCacheFileDir.ArgStr,
         cl::ShaderCacheMode.ArgStr,
+        cl::ShaderCacheFileMap.ArgStr,
+        cl::ShaderCacheMemoryBudget.ArgStr,
+        cl::ShaderCacheFileBudget.ArgStr,
+        cl::ShaderCacheCompress.ArgStr,
+        cl::ShaderCacheShared.ArgStr,
         cl::EnableOuts.ArgStr,
         cl::EnableErrs.ArgStr,
         cl::LogFileDbgs.ArgStr,
         cl::LogFileOuts.ArgStr,
         cl::EnableShadowDescriptorTable.ArgStr,
         cl::ShadowDescTablePtrHigh.ArgStr,
-        cl::ExecutableName.ArgStr
+        cl::ExecutableName.ArgStr,
+        cl::EnableParallelStageLower.ArgStr,
+        cl::EnableParallelCodeGen.ArgStr,
+        cl::ContextPoolLimit.ArgStr,
+        cl::ContextPoolOverflow.ArgStr,
+        cl::ContextPoolMaxIdle.ArgStr,
+        cl::AsyncBuildThreadCount.ArgStr
     };
 
     std::set<StringRef> effectingOptions;
@@ -1883,6 +2967,7 @@ Result Compiler::CreateShaderCache(
     auxCreateInfo.shaderCacheMode = ShaderCacheMode::ShaderCacheEnableRuntime;
     auxCreateInfo.gfxIp           = m_gfxIp;
     auxCreateInfo.hash            = m_optionHash;
+    auxCreateInfo.compressShaders = cl::ShaderCacheCompress;
 
     ShaderCache* pShaderCache = new ShaderCache();
 
@@ -1916,38 +3001,15 @@ Result Compiler::CreateShaderCache(
 
 // =====================================================================================================================
 // Acquires a free context from context pool.
-Context* Compiler::AcquireContext() const
+//
+// NOTE: Helper jobs that translate and lower part of a shader module or pipeline pass nested as true, as the build
+// that they are part of may hold a context while it waits for them. Waiting for a context at the pool limit could
+// then deadlock, so such an acquire goes over the limit instead.
+Context* Compiler::AcquireContext(
+    bool nested     // Whether the acquire is on behalf of a build that may already hold a context
+    ) const
 {
-    Context* pFreeContext = nullptr;
-
-    std::lock_guard<sys::Mutex> lock(m_contextPoolMutex);
-
-    // Try to find a free context from pool first
-    for (auto pContext : *m_pContextPool)
-    {
-        GfxIpVersion gfxIpVersion = pContext->GetGfxIpVersion();
-
-        if ((pContext->IsInUse()   == false) &&
-            (gfxIpVersion.major    == m_gfxIp.major) &&
-            (gfxIpVersion.minor    == m_gfxIp.minor) &&
-            (gfxIpVersion.stepping == m_gfxIp.stepping))
-        {
-            pFreeContext = pContext;
-            pFreeContext->SetInUse(true);
-            break;
-        }
-    }
-
-    if (pFreeContext == nullptr)
-    {
-        // Create a new one if we fail to find an available one
-        pFreeContext = new Context(m_gfxIp);
-        pFreeContext->SetInUse(true);
-        m_pContextPool->push_back(pFreeContext);
-    }
-
-    assert(pFreeContext != nullptr);
-    return pFreeContext;
+    return m_pContextPool->Acquire(m_gfxIp, nested);
 }
 
 // =====================================================================================================================
@@ -1980,9 +3042,32 @@ void Compiler::ReleaseContext(
     Context* pContext    // [in] LLPC context
     ) const
 {
-    std::lock_guard<sys::Mutex> lock(m_contextPoolMutex);
-    pContext->Reset();
-    pContext->SetInUse(false);
+    m_pContextPool->Release(pContext);
+}
+
+// =====================================================================================================================
+// Gets statistics of the context pool shared by all compiler instances.
+void Compiler::GetContextPoolStats(
+    ContextPoolStats* pStats    // [out] Context pool statistics
+    ) const
+{
+    m_pContextPool->GetStats(pStats);
+}
+
+// =====================================================================================================================
+// Gets statistics of the internal shader cache of the compiler.
+void Compiler::GetShaderCacheStats(
+    ShaderCacheStats* pStats    // [out] Shader cache statistics
+    ) const
+{
+    m_shaderCache->GetStats(pStats);
+}
+
+// =====================================================================================================================
+// Compacts the on-disk file of the internal shader cache of the compiler.
+Result Compiler::CompactShaderCache()
+{
+    return m_shaderCache->Compact();
 }
 
 // =====================================================================================================================
@@ -1990,14 +3075,18 @@ void Compiler::ReleaseContext(
 // It will try App's pipelince cache first if that's available.
 // Then try on the internal shader cache next if it misses.
 //
-// Upon hit, Ready is returned and pElfBin is filled in. Upon miss, Compiling is returned and ppShaderCache and
-// phEntry are filled in.
+// Upon hit, Ready is returned and pElfBin and ppShaderCache are filled in. Upon miss, Compiling is returned and
+// ppShaderCache and phEntry are filled in.
 ShaderEntryState Compiler::LookUpShaderCaches(
     IShaderCache*                    pAppPipelineCache, // [in] App's pipeline cache
     MetroHash::Hash*                 pCacheHash,        // [in] Hash code of the shader
     BinaryData*                      pElfBin,           // [out] Pointer to shader data
+    std::shared_ptr<void>*           pElfStorage,       // [out] Storage of the shader data found, which keeps it valid
+                                                        //       even if the shader is evicted from the cache
     ShaderCache**                    ppShaderCache,     // [out] Shader cache to use
-    CacheEntryHandle*                phEntry            // [out] Handle to use
+    CacheEntryHandle*                phEntry,           // [out] Handle to use
+    bool*                            pIsUpgraded        // [out] Whether the entry found has been upgraded from a fast
+                                                        //       build to a fully optimized one (optional)
     )
 {
     ShaderCache* pShaderCache[2];
@@ -2020,9 +3109,19 @@ ShaderEntryState Compiler::LookUpShaderCaches(
         ShaderEntryState cacheEntryState = pShaderCache[i]->FindShader(*pCacheHash, allocateOnMiss, &hCurrentEntry);
         if (cacheEntryState == ShaderEntryState::Ready)
         {
-            Result result = pShaderCache[i]->RetrieveShader(hCurrentEntry, &pElfBin->pCode, &pElfBin->codeSize);
+            Result result = pShaderCache[i]->RetrieveShader(hCurrentEntry,
+                                                            &pElfBin->pCode,
+                                                            &pElfBin->codeSize,
+                                                            pElfStorage);
             if (result == Result::Success)
+            {
+                *ppShaderCache = pShaderCache[i];
+                if (pIsUpgraded != nullptr)
+                {
+                    *pIsUpgraded = pShaderCache[i]->IsShaderUpgraded(hCurrentEntry);
+                }
                 return ShaderEntryState::Ready;
+            }
         }
         else if (cacheEntryState == ShaderEntryState::Compiling)
         {
@@ -2064,12 +3163,53 @@ void Compiler::UpdateShaderCache(
     }
 }
 
+// =====================================================================================================================
+// Replaces the fast build of a pipeline in the shader caches with a fully optimized build.
+void Compiler::UpgradeShaderCaches(
+    IShaderCache*                    pAppPipelineCache, // [in] App's pipeline cache
+    MetroHash::Hash*                 pCacheHash,        // [in] Hash code the fast build is cached under
+    const BinaryData*                pElfBin)           // [in] Fully optimized pipeline ELF
+{
+    m_shaderCache->UpgradeShader(*pCacheHash, pElfBin->pCode, pElfBin->codeSize);
+
+    if (pAppPipelineCache != nullptr && cl::ShaderCacheMode != ShaderCacheForceInternalCacheOnDisk)
+    {
+        static_cast<ShaderCache*>(pAppPipelineCache)->UpgradeShader(*pCacheHash, pElfBin->pCode, pElfBin->codeSize);
+    }
+}
+
+// =====================================================================================================================
+// Builds the input hash of a shader stage for the per-stage shader cache. This is the initial value of the
+// inter-shader data tracking hash of the shader (see DdnInterShaderDataCacheTracking.md).
+uint64_t Compiler::BuildShaderInputHash(
+    Context*                    pContext,           // [in] Acquired context
+    ShaderStage                 stage)              // Shader stage
+{
+    auto pPipelineInfo = reinterpret_cast<const GraphicsPipelineBuildInfo*>(pContext->GetPipelineBuildInfo());
+    auto pShaderInfo = pContext->GetPipelineShaderInfo(stage);
+    MetroHash64 hasher;
+
+    // Update common shader info
+    PipelineDumper::UpdateHashForPipelineShaderInfo(stage, pShaderInfo, true, &hasher);
+    hasher.Update(pPipelineInfo->iaState.deviceIndex);
+
+    // Update vertex input state
+    if (stage == ShaderStageVertex)
+    {
+        PipelineDumper::UpdateHashForVertexInputState(pPipelineInfo->pVertexInput, &hasher);
+    }
+
+    MetroHash::Hash hash = {};
+    hasher.Finalize(hash.bytes);
+    return MetroHash::Compact64(&hash);
+}
+
 // =====================================================================================================================
 // Builds hash code from input context for per shader stage cache
 void Compiler::BuildShaderCacheHash(
     Context*                    pContext,           // [in] Acquired context
     uint32_t                    stageMask,          // Shader stage mask
-    ArrayRef<ArrayRef<uint8_t>> stageHashes,        // Per-stage hash of in/out usage
+    ArrayRef<uint64_t>          stageHashes,        // Per-stage inter-shader data tracking hash
     MetroHash::Hash*            pFragmentHash,      // [out] Hash code of fragment shader
     MetroHash::Hash*            pNonFragmentHash)   // [out] Hash code of all non-fragment shader
 {
@@ -2078,7 +3218,8 @@ void Compiler::BuildShaderCacheHash(
     auto pPipelineInfo = reinterpret_cast<const GraphicsPipelineBuildInfo*>(pContext->GetPipelineBuildInfo());
     auto pPipelineOptions = pContext->GetPipelineContext()->GetPipelineOptions();
 
-    // Build hash per shader stage
+    // Add per stage hash code to fragmentHasher or nonFragmentHaser per shader stage. The per-stage hash already
+    // covers the input of the shader and any data from other shaders that was used in compiling it.
     for (auto stage = ShaderStageVertex; stage < ShaderStageGfxCount; stage = static_cast<ShaderStage>(stage + 1))
     {
         if ((stageMask & ShaderStageToMask(stage)) == 0)
@@ -2086,34 +3227,13 @@ void Compiler::BuildShaderCacheHash(
             continue;
         }
 
-        auto pShaderInfo = pContext->GetPipelineShaderInfo(stage);
-        MetroHash64 hasher;
-
-        // Update common shader info
-        PipelineDumper::UpdateHashForPipelineShaderInfo(stage, pShaderInfo, true, &hasher);
-        hasher.Update(pPipelineInfo->iaState.deviceIndex);
-
-        // Update input/output usage (provided by middle-end caller of this callback).
-        hasher.Update(stageHashes[stage].data(), stageHashes[stage].size());
-
-        // Update vertex input state
-        if (stage == ShaderStageVertex)
-        {
-            PipelineDumper::UpdateHashForVertexInputState(pPipelineInfo->pVertexInput, &hasher);
-        }
-
-        MetroHash::Hash  hash = {};
-        hasher.Finalize(hash.bytes);
-
-        // Add per stage hash code to fragmentHasher or nonFragmentHaser per shader stage
-        auto shaderHashCode = MetroHash::Compact64(&hash);
         if (stage == ShaderStageFragment)
         {
-            fragmentHasher.Update(shaderHashCode);
+            fragmentHasher.Update(stageHashes[stage]);
         }
         else
         {
-            nonFragmentHasher.Update(shaderHashCode);
+            nonFragmentHasher.Update(stageHashes[stage]);
         }
     }
 
@@ -2126,7 +3246,7 @@ void Compiler::BuildShaderCacheHash(
         fragmentHasher.Update(pPipelineOptions->reconfigWorkgroupLayout);
         fragmentHasher.Update(pPipelineOptions->includeIr);
         fragmentHasher.Update(pPipelineOptions->robustBufferAccess);
-        PipelineDumper::UpdateHashForFragmentState(pPipelineInfo, &fragmentHasher);
+        PipelineDumper::UpdateHashForFragmentState(pPipelineInfo, false, &fragmentHasher);
         fragmentHasher.Finalize(pFragmentHash->bytes);
     }
 
@@ -2139,14 +3259,15 @@ void Compiler::BuildShaderCacheHash(
 
 // =====================================================================================================================
 // Link relocatable shader elf file into a pipeline elf file and apply relocations.
-void Compiler::LinkRelocatableShaderElf(
+Result Compiler::LinkRelocatableShaderElf(
     ElfPackage* pShaderElfs,   // [in]  An array of pipeline elf packages, indexed by stage, containing relocatable elf
     ElfPackage* pPipelineElf,  // [out] Elf package containing the pipeline elf
     Context* pContext)         // [in]  Acquired context
 {
-    assert(pShaderElfs[ShaderStageTessControl].empty() && "Cannot link tessellation shaders yet.");
-    assert(pShaderElfs[ShaderStageTessEval].empty() && "Cannot link tessellation shaders yet.");
-    assert(pShaderElfs[ShaderStageGeometry].empty() && "Cannot link geometry shaders yet.");
+    // NOTE: The pre-rasterization stages are built into a single relocatable elf, stored at the vertex shader index.
+    assert(pShaderElfs[ShaderStageTessControl].empty() && "Expected TCS in the pre-rasterization stage elf.");
+    assert(pShaderElfs[ShaderStageTessEval].empty() && "Expected TES in the pre-rasterization stage elf.");
+    assert(pShaderElfs[ShaderStageGeometry].empty() && "Expected GS in the pre-rasterization stage elf.");
 
     Result result = Result::Success;
     ElfWriter<Elf64> writer(m_gfxIp);
@@ -2161,7 +3282,7 @@ void Compiler::LinkRelocatableShaderElf(
             result = vsReader.ReadFromBuffer(pShaderElfs[ShaderStageVertex].data(), &codeSize);
             if (result != Result::Success)
             {
-                return;
+                return result;
             }
         }
 
@@ -2171,7 +3292,7 @@ void Compiler::LinkRelocatableShaderElf(
             result = fsReader.ReadFromBuffer(pShaderElfs[ShaderStageFragment].data(), &codeSize);
             if (result != Result::Success)
             {
-                return;
+                return result;
             }
         }
 
@@ -2184,16 +3305,17 @@ void Compiler::LinkRelocatableShaderElf(
         result = csReader.ReadFromBuffer(pShaderElfs[ShaderStageCompute].data(), &codeSize);
         if (result != Result::Success)
         {
-            return;
+            return result;
         }
         result = writer.LinkComputeRelocatableElf(csReader, pContext);
     }
 
     if (result != Result::Success)
     {
-        return;
+        return result;
     }
     writer.WriteToBuffer(pPipelineElf);
+    return result;
 }
 
 } // Llpc
@@ -31,10 +31,12 @@
 #pragma once
 
 #include "llpc.h"
+#include "llpcContextPool.h"
 #include "llpcElfReader.h"
 #include "llpcMetroHash.h"
 #include "llpcShaderCacheManager.h"
 #include "llpcShaderModuleHelper.h"
+#include "llpcThreadPool.h"
 
 namespace llvm
 {
@@ -53,6 +55,9 @@ class ComputeContext;
 class Context;
 class GraphicsContext;
 class PassManager;
+class PipelineContext;
+class TimerProfiler;
+struct ShaderModuleEntryBuild;
 
 // =====================================================================================================================
 // Object to manage checking and updating shader cache for graphics pipeline.
@@ -64,9 +69,10 @@ public:
     {}
 
     // Check shader caches, returning mask of which shader stages we want to keep in this compile.
-    uint32_t Check(const llvm::Module*                     pModule,
-                   uint32_t                                stageMask,
-                   llvm::ArrayRef<llvm::ArrayRef<uint8_t>> stageHashes);
+    uint32_t Check(const llvm::Module*          pModule,
+                   uint32_t                     stageMask,
+                   llvm::ArrayRef<uint64_t>     stageHashes,
+                   uint32_t                     hashStageMask);
 
     // Get cache results.
     ShaderEntryState GetNonFragmentCacheEntryState() { return m_nonFragmentCacheEntryState; }
@@ -84,11 +90,21 @@ private:
     ShaderCache* m_pNonFragmentShaderCache = nullptr;
     CacheEntryHandle m_hNonFragmentEntry = {};
     BinaryData m_nonFragmentElf = {};
+    std::shared_ptr<void> m_nonFragmentElfStorage;
 
     ShaderEntryState m_fragmentCacheEntryState = ShaderEntryState::New;
     ShaderCache* m_pFragmentShaderCache = nullptr;
     CacheEntryHandle m_hFragmentEntry = {};
     BinaryData m_fragmentElf = {};
+    std::shared_ptr<void> m_fragmentElfStorage;
+};
+
+// Enumerates the optimization tiers of a pipeline build.
+enum class PipelineTier : uint32_t
+{
+    Full = 0,   // Fully optimized build
+    Fast,       // Build with minimal optimization, cached separately from a fully optimized build
+    Upgrade,    // Fully optimized rebuild of a fast build, which also replaces the fast build in the shader cache
 };
 
 // =====================================================================================================================
@@ -114,6 +130,36 @@ public:
     virtual Result BuildComputePipeline(const ComputePipelineBuildInfo* pPipelineInfo,
                                         ComputePipelineBuildOut*        pPipelineOut,
                                         void*                           pPipelineDumpFile = nullptr);
+
+    virtual Result BuildGraphicsPipelineAsync(const GraphicsPipelineBuildInfo* pPipelineInfo,
+                                              GraphicsPipelineBuildOut*        pPipelineOut,
+                                              PipelineBuildPriority            priority,
+                                              IPipelineBuildJob**              ppJob);
+
+    virtual Result BuildComputePipelineAsync(const ComputePipelineBuildInfo* pPipelineInfo,
+                                             ComputePipelineBuildOut*        pPipelineOut,
+                                             PipelineBuildPriority           priority,
+                                             IPipelineBuildJob**             ppJob);
+
+    virtual Result BuildGraphicsPipelineView(const GraphicsPipelineBuildInfo* pPipelineInfo,
+                                             IPipelineBinaryView**            ppView);
+
+    virtual Result BuildComputePipelineView(const ComputePipelineBuildInfo* pPipelineInfo,
+                                            IPipelineBinaryView**           ppView);
+
+    virtual Result BuildGraphicsPipelineFast(const GraphicsPipelineBuildInfo* pPipelineInfo,
+                                             GraphicsPipelineBuildOut*        pPipelineOut,
+                                             IPipelineBuildJob**              ppUpgradeJob);
+
+    virtual Result BuildComputePipelineFast(const ComputePipelineBuildInfo* pPipelineInfo,
+                                            ComputePipelineBuildOut*        pPipelineOut,
+                                            IPipelineBuildJob**             ppUpgradeJob);
+
+    virtual Result BuildGraphicsPipelines(uint32_t                               pipelineCount,
+                                          const GraphicsPipelineBuildInfo*const* ppPipelineInfos,
+                                          GraphicsPipelineBuildOut*              pPipelineOuts,
+                                          Result*                                pResults);
+
     Result BuildGraphicsPipelineInternal(GraphicsContext*                          pGraphicsContext,
                                          llvm::ArrayRef<const PipelineShaderInfo*> shaderInfo,
                                          uint32_t                                  forceLoopUnrollCount,
@@ -149,20 +195,32 @@ public:
     virtual Result CreateShaderCache(const ShaderCacheCreateInfo* pCreateInfo, IShaderCache** ppShaderCache);
 #endif
 
-    ShaderEntryState LookUpShaderCaches(IShaderCache*       pAppPipelineCache,
-                                        MetroHash::Hash*    pCacheHash,
-                                        BinaryData*         pElfBin,
-                                        ShaderCache**       ppShaderCache,
-                                        CacheEntryHandle*   phEntry);
+    virtual void GetContextPoolStats(ContextPoolStats* pStats) const;
+    virtual void GetShaderCacheStats(ShaderCacheStats* pStats) const;
+    virtual Result CompactShaderCache();
+
+    ShaderEntryState LookUpShaderCaches(IShaderCache*           pAppPipelineCache,
+                                        MetroHash::Hash*        pCacheHash,
+                                        BinaryData*             pElfBin,
+                                        std::shared_ptr<void>*  pElfStorage,
+                                        ShaderCache**           ppShaderCache,
+                                        CacheEntryHandle*       phEntry,
+                                        bool*                   pIsUpgraded = nullptr);
 
     void UpdateShaderCache(bool                insert,
                            const BinaryData*   pElfBin,
                            ShaderCache*        pShaderCache,
                            CacheEntryHandle    phEntry);
 
+    void UpgradeShaderCaches(IShaderCache*       pAppPipelineCache,
+                             MetroHash::Hash*    pCacheHash,
+                             const BinaryData*   pElfBin);
+
+    static uint64_t BuildShaderInputHash(Context* pContext, ShaderStage stage);
+
     static void BuildShaderCacheHash(Context*                                 pContext,
                                      uint32_t                                 stageMask,
-                                     llvm::ArrayRef<llvm::ArrayRef<uint8_t>>  stageHashes,
+                                     llvm::ArrayRef<uint64_t>                 stageHashes,
                                      MetroHash::Hash*                         pFragmentHash,
                                      MetroHash::Hash*                         pNonFragmentHash);
 
@@ -173,24 +231,53 @@ private:
 
     Result ValidatePipelineShaderInfo(const PipelineShaderInfo* pShaderInfo) const;
 
-    Context* AcquireContext() const;
+    Context* AcquireContext(bool nested = false) const;
     void ReleaseContext(Context* pContext) const;
 
     bool RunPasses(PassManager* pPassMgr, llvm::Module* pModule) const;
-    void LinkRelocatableShaderElf(ElfPackage *pShaderElfs, ElfPackage* pPipelineElf, Context* pContext);
+    Result BuildGraphicsPipelineWithTier(const GraphicsPipelineBuildInfo* pPipelineInfo,
+                                         GraphicsPipelineBuildOut*        pPipelineOut,
+                                         void*                            pPipelineDumpFile,
+                                         PipelineTier                     tier,
+                                         bool*                            pIsUpgraded,
+                                         IPipelineBinaryView**            ppView);
+    Result BuildComputePipelineWithTier(const ComputePipelineBuildInfo* pPipelineInfo,
+                                        ComputePipelineBuildOut*        pPipelineOut,
+                                        void*                           pPipelineDumpFile,
+                                        PipelineTier                    tier,
+                                        bool*                           pIsUpgraded,
+                                        IPipelineBinaryView**           ppView);
+    Result BuildShaderModuleEntry(const ShaderModuleData* pModuleData,
+                                  TimerProfiler*          pTimerProfiler,
+                                  ShaderModuleEntryBuild* pEntryBuild) const;
+    ThreadPool* GetThreadPool() const;
+    Result SubmitPipelineBuild(std::function<Result()> build,
+                               PipelineBuildPriority   priority,
+                               IPipelineBuildJob**     ppJob);
+    Result LowerShaderStages(Context*                                  pContext,
+                             llvm::ArrayRef<const PipelineShaderInfo*> shaderInfo,
+                             uint32_t                                  forceLoopUnrollCount,
+                             std::vector<ElfPackage>*                  pStageBitcodes) const;
+    Result LowerShaderStageToBitcode(PipelineContext*          pPipelineContext,
+                                     const PipelineShaderInfo* pShaderInfo,
+                                     uint32_t                  forceLoopUnrollCount,
+                                     ElfPackage*               pBitcode) const;
+    Result LinkRelocatableShaderElf(ElfPackage *pShaderElfs, ElfPackage* pPipelineElf, Context* pContext);
     bool CanUseRelocatableGraphicsShaderElf(const llvm::ArrayRef<const PipelineShaderInfo*>& shaderInfo) const;
     bool CanUseRelocatableComputeShaderElf(const PipelineShaderInfo* pShaderInfo) const;
 
     // -----------------------------------------------------------------------------------------------------------------
 
-    std::vector<std::string>      m_options;          // Compilation options
-    MetroHash::Hash               m_optionHash;       // Hash code of compilation options
-    GfxIpVersion                  m_gfxIp;            // Graphics IP version info
-    static uint32_t               m_instanceCount;    // The count of compiler instance
-    static uint32_t               m_outRedirectCount; // The count of output redirect
-    ShaderCachePtr                m_shaderCache;      // Shader cache
-    static llvm::sys::Mutex       m_contextPoolMutex; // Mutex for context pool access
-    static std::vector<Context*>* m_pContextPool;      // Context pool
+    std::vector<std::string>            m_options;          // Compilation options
+    MetroHash::Hash                     m_optionHash;       // Hash code of compilation options
+    GfxIpVersion                        m_gfxIp;            // Graphics IP version info
+    static uint32_t                     m_instanceCount;    // The count of compiler instance
+    static uint32_t                     m_outRedirectCount; // The count of output redirect
+    ShaderCachePtr                      m_shaderCache;      // Shader cache
+    mutable std::mutex                  m_threadPoolLock;   // Lock for creating the thread pool
+    mutable std::unique_ptr<ThreadPool> m_threadPool;       // Thread pool for asynchronous and batched builds
+    static llvm::sys::Mutex             m_contextPoolMutex; // Mutex for context pool creation and destruction
+    static ContextPool*                 m_pContextPool;     // Context pool
 };
 
 } // Llpc
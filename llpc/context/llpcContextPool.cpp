@@ -0,0 +1,249 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+ /**
+ ***********************************************************************************************************************
+ @file llpcContextPool.cpp
+ @brief LLPC source file: contains implementation of class Llpc::ContextPool.
+ ***********************************************************************************************************************
+*/
+#include "llvm/Support/CommandLine.h"
+
+#include "llpcContext.h"
+#include "llpcContextPool.h"
+
+#define DEBUG_TYPE "llpc-context-pool"
+
+using namespace llvm;
+
+namespace llvm
+{
+
+namespace cl
+{
+
+// -context-pool-limit: max number of live contexts per GFX IP version
+opt<int> ContextPoolLimit("context-pool-limit",
+                          desc("Max number of live LLPC contexts per GFX IP version. -1 means unlimited."),
+                          init(-1));
+
+// -context-pool-overflow: create a transient context rather than wait when the context pool is at its limit
+opt<bool> ContextPoolOverflow("context-pool-overflow",
+                              desc("Create a transient LLPC context rather than wait for one to be released when the "
+                                   "context pool is at its limit"),
+                              init(false));
+
+// -context-pool-max-idle: max number of idle contexts kept per GFX IP version
+opt<int> ContextPoolMaxIdle("context-pool-max-idle",
+                            desc("Max number of idle LLPC contexts kept per GFX IP version. -1 means unlimited."),
+                            init(-1));
+
+} // cl
+
+} // llvm
+
+namespace Llpc
+{
+
+// =====================================================================================================================
+// Destroys all idle contexts. All contexts must have been released by now, as releasing one needs the pool.
+ContextPool::~ContextPool()
+{
+    for (auto& gfxIpContexts : m_contexts)
+    {
+        assert((gfxIpContexts.second.liveCount == gfxIpContexts.second.idleContexts.size()) &&
+               "Context pool destroyed while contexts are in use");
+        for (Context* pContext : gfxIpContexts.second.idleContexts)
+        {
+            delete pContext;
+        }
+    }
+}
+
+// =====================================================================================================================
+// Acquires a free context of the specified GFX IP version, creating one if necessary.
+//
+// A nested acquire, made by a thread (or on behalf of a thread) that already holds a context from this pool, never
+// waits at the limit: the contexts it would wait for may only be released once it returns, so it creates a transient
+// context instead.
+Context* ContextPool::Acquire(
+    GfxIpVersion gfxIp,     // Graphics IP version info
+    bool         nested)    // Whether the caller already holds a context from this pool
+{
+    Context* pContext = nullptr;
+    bool create = false;
+
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        GfxIpContexts& contexts = m_contexts[GetGfxIpKey(gfxIp)];
+        bool waited = false;
+
+        ++m_acquireCount;
+        while (true)
+        {
+            if (contexts.idleContexts.empty() == false)
+            {
+                pContext = contexts.idleContexts.back();
+                contexts.idleContexts.pop_back();
+                ++m_hitCount;
+                break;
+            }
+
+            const int32_t limit = cl::ContextPoolLimit;
+            if ((limit < 0) || (contexts.liveCount < static_cast<uint32_t>(limit)))
+            {
+                create = true;
+                break;
+            }
+
+            if (cl::ContextPoolOverflow || nested)
+            {
+                // The transient context is destroyed on release, as the live count is then over the limit.
+                ++m_overflowCount;
+                create = true;
+                break;
+            }
+
+            if (waited == false)
+            {
+                ++m_waitCount;
+                waited = true;
+            }
+            m_releaseCond.wait(lock);
+        }
+
+        if (create)
+        {
+            ++contexts.liveCount;
+            ++m_createCount;
+        }
+    }
+
+    // Create the new context outside the lock, so it does not hold up other threads.
+    if (create)
+    {
+        pContext = new Context(gfxIp);
+    }
+
+    pContext->SetInUse(true);
+    return pContext;
+}
+
+// =====================================================================================================================
+// Releases a context back to the pool. The context is destroyed instead if the pool is over its limit, or already
+// has the maximum number of idle contexts.
+void ContextPool::Release(
+    Context* pContext)      // [in] LLPC context
+{
+    pContext->Reset();
+    pContext->SetInUse(false);
+
+    bool destroy = false;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        GfxIpContexts& contexts = m_contexts[GetGfxIpKey(pContext->GetGfxIpVersion())];
+
+        const int32_t limit = cl::ContextPoolLimit;
+        const int32_t maxIdle = cl::ContextPoolMaxIdle;
+        if (((limit >= 0) && (contexts.liveCount > static_cast<uint32_t>(limit))) ||
+            ((maxIdle >= 0) && (contexts.idleContexts.size() >= static_cast<uint32_t>(maxIdle))))
+        {
+            --contexts.liveCount;
+            ++m_destroyCount;
+            destroy = true;
+        }
+        else
+        {
+            contexts.idleContexts.push_back(pContext);
+        }
+    }
+
+    // Either a context became idle or the live count went down, so a waiting acquire may now be able to proceed.
+    m_releaseCond.notify_all();
+
+    if (destroy)
+    {
+        delete pContext;
+    }
+}
+
+// =====================================================================================================================
+// Destroys idle contexts until there are no more than the specified number of live contexts over all GFX IP versions,
+// or there are no idle contexts left.
+void ContextPool::Trim(
+    size_t maxLiveContexts)     // Max number of live contexts to keep
+{
+    std::vector<Context*> deadContexts;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        size_t liveCount = 0;
+        for (auto& gfxIpContexts : m_contexts)
+        {
+            liveCount += gfxIpContexts.second.liveCount;
+        }
+
+        for (auto& gfxIpContexts : m_contexts)
+        {
+            GfxIpContexts& contexts = gfxIpContexts.second;
+            while ((liveCount > maxLiveContexts) && (contexts.idleContexts.empty() == false))
+            {
+                deadContexts.push_back(contexts.idleContexts.back());
+                contexts.idleContexts.pop_back();
+                --contexts.liveCount;
+                --liveCount;
+                ++m_destroyCount;
+            }
+        }
+    }
+
+    m_releaseCond.notify_all();
+
+    for (Context* pContext : deadContexts)
+    {
+        delete pContext;
+    }
+}
+
+// =====================================================================================================================
+// Gets statistics of the context pool.
+void ContextPool::GetStats(
+    ContextPoolStats* pStats)   // [out] Context pool statistics
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    *pStats = {};
+    pStats->acquireCount  = m_acquireCount;
+    pStats->hitCount      = m_hitCount;
+    pStats->createCount   = m_createCount;
+    pStats->waitCount     = m_waitCount;
+    pStats->overflowCount = m_overflowCount;
+    pStats->destroyCount  = m_destroyCount;
+    for (auto& gfxIpContexts : m_contexts)
+    {
+        pStats->liveCount += gfxIpContexts.second.liveCount;
+        pStats->idleCount += gfxIpContexts.second.idleContexts.size();
+    }
+}
+
+} // Llpc
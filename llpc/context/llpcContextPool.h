@@ -0,0 +1,99 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ @file llpcContextPool.h
+ @brief LLPC header file: contains declaration of class Llpc::ContextPool.
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include "llpc.h"
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Llpc
+{
+
+class Context;
+
+// =====================================================================================================================
+// Represents the pool of LLPC contexts shared by all compiler instances.
+//
+// Idle contexts are kept on a free list per GFX IP version, so acquiring one does not need to scan contexts of other
+// GFX IP versions or contexts that are in use. The number of live contexts per GFX IP version can be capped with
+// -context-pool-limit, in which case an acquire at the limit either waits for a release or, with
+// -context-pool-overflow, creates a transient context that is destroyed when it is released. A nested acquire, from a
+// caller that already holds a context, always overflows rather than waits, so it cannot deadlock on itself. The number
+// of idle contexts kept per GFX IP version can be capped with -context-pool-max-idle.
+//
+// The pool must outlive all contexts acquired from it.
+class ContextPool
+{
+public:
+    ContextPool() {}
+    ~ContextPool();
+
+    Context* Acquire(GfxIpVersion gfxIp, bool nested = false);
+    void Release(Context* pContext);
+
+    void Trim(size_t maxLiveContexts);
+
+    void GetStats(ContextPoolStats* pStats);
+
+private:
+    ContextPool(const ContextPool&) = delete;
+    ContextPool& operator=(const ContextPool&) = delete;
+
+    // Context list of one GFX IP version
+    struct GfxIpContexts
+    {
+        std::vector<Context*> idleContexts;   // Contexts that are free to acquire
+        uint32_t              liveCount = 0;  // Count of all live contexts, idle or in use
+    };
+
+    // Gets the key of the context list for the specified GFX IP version
+    static uint32_t GetGfxIpKey(GfxIpVersion gfxIp)
+    {
+        return (gfxIp.major << 16) | (gfxIp.minor << 8) | gfxIp.stepping;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------
+
+    std::mutex                                  m_lock;              // Lock for the context lists and counters
+    std::condition_variable                     m_releaseCond;       // Signalled when a context is released
+    std::unordered_map<uint32_t, GfxIpContexts> m_contexts;          // Context lists, keyed by GFX IP version
+
+    uint64_t                                    m_acquireCount = 0;  // Count of acquires
+    uint64_t                                    m_hitCount = 0;      // Count of acquires served from an idle list
+    uint64_t                                    m_createCount = 0;   // Count of contexts created
+    uint64_t                                    m_waitCount = 0;     // Count of acquires that waited at the limit
+    uint64_t                                    m_overflowCount = 0; // Count of transient contexts over the limit
+    uint64_t                                    m_destroyCount = 0;  // Count of contexts destroyed
+};
+
+} // Llpc
@@ -244,6 +244,7 @@ void PipelineContext::SetOptionsInPipeline(
     options.includeDisassembly = (cl::EnablePipelineDump || EnableOuts() || GetPipelineOptions()->includeDisassembly);
     options.reconfigWorkgroupLayout = GetPipelineOptions()->reconfigWorkgroupLayout;
     options.includeIr = (IncludeLlvmIr || GetPipelineOptions()->includeIr);
+    options.fastCompile = m_fastCompile;
 
     if (IsGraphics() && (GetGfxIpVersion().major >= 10))
     {
@@ -138,6 +138,12 @@ public:
     // Gets per pipeline options
     virtual const PipelineOptions* GetPipelineOptions() const = 0;
 
+    // Sets whether the pipeline is built with minimal optimization, for a fast build
+    void SetFastCompile(bool fastCompile) { m_fastCompile = fastCompile; }
+
+    // Checks whether the pipeline is built with minimal optimization, for a fast build
+    bool IsFastCompile() const { return m_fastCompile; }
+
     // Set pipeline state in Pipeline object for middle-end
     void SetPipelineState(Pipeline* pPipeline) const;
 
@@ -187,6 +193,7 @@ private:
     // -----------------------------------------------------------------------------------------------------------------
 
     ShaderFpMode           m_shaderFpModes[ShaderStageCountInternal] = {};
+    bool                   m_fastCompile = false;   // Whether to build with minimal optimization
 };
 
 } // Llpc
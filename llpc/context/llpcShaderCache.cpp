@@ -28,9 +28,17 @@
  @brief LLPC source file: contains implementation of class Llpc::ShaderCache.
  ***********************************************************************************************************************
 */
+#include <algorithm>
+#include <functional>
 #include <string.h>
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Compression.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llpcDebug.h"
 #include "llpcShaderCache.h"
 #include "llvm/Support/DJB.h"
 
@@ -43,91 +51,51 @@ namespace Llpc
 
 static const char CacheFileSubPath[] = "/AMD/LlpcCache/";
 
+static const char SharedDirPrefix[] = "Shared.";
+
 static const char ClientStr[] = "LLPC";
 
-static constexpr uint64_t CrcWidth         = sizeof(uint64_t) * 8;
-static constexpr uint64_t CrcInitialValue  = 0xFFFFFFFFFFFFFFFF;
-
-static const uint64_t CrcLookup[256] =
-{
-    0x0000000000000000, 0xAD93D23594C935A9, 0xF6B4765EBD5B5EFB, 0x5B27A46B29926B52,
-    0x40FB3E88EE7F885F, 0xED68ECBD7AB6BDF6, 0xB64F48D65324D6A4, 0x1BDC9AE3C7EDE30D,
-    0x81F67D11DCFF10BE, 0x2C65AF2448362517, 0x77420B4F61A44E45, 0xDAD1D97AF56D7BEC,
-    0xC10D4399328098E1, 0x6C9E91ACA649AD48, 0x37B935C78FDBC61A, 0x9A2AE7F21B12F3B3,
-    0xAE7F28162D3714D5, 0x03ECFA23B9FE217C, 0x58CB5E48906C4A2E, 0xF5588C7D04A57F87,
-    0xEE84169EC3489C8A, 0x4317C4AB5781A923, 0x183060C07E13C271, 0xB5A3B2F5EADAF7D8,
-    0x2F895507F1C8046B, 0x821A8732650131C2, 0xD93D23594C935A90, 0x74AEF16CD85A6F39,
-    0x6F726B8F1FB78C34, 0xC2E1B9BA8B7EB99D, 0x99C61DD1A2ECD2CF, 0x3455CFE43625E766,
-    0xF16D8219CEA71C03, 0x5CFE502C5A6E29AA, 0x07D9F44773FC42F8, 0xAA4A2672E7357751,
-    0xB196BC9120D8945C, 0x1C056EA4B411A1F5, 0x4722CACF9D83CAA7, 0xEAB118FA094AFF0E,
-    0x709BFF0812580CBD, 0xDD082D3D86913914, 0x862F8956AF035246, 0x2BBC5B633BCA67EF,
-    0x3060C180FC2784E2, 0x9DF313B568EEB14B, 0xC6D4B7DE417CDA19, 0x6B4765EBD5B5EFB0,
-    0x5F12AA0FE39008D6, 0xF281783A77593D7F, 0xA9A6DC515ECB562D, 0x04350E64CA026384,
-    0x1FE994870DEF8089, 0xB27A46B29926B520, 0xE95DE2D9B0B4DE72, 0x44CE30EC247DEBDB,
-    0xDEE4D71E3F6F1868, 0x7377052BABA62DC1, 0x2850A14082344693, 0x85C3737516FD733A,
-    0x9E1FE996D1109037, 0x338C3BA345D9A59E, 0x68AB9FC86C4BCECC, 0xC5384DFDF882FB65,
-    0x4F48D60609870DAF, 0xE2DB04339D4E3806, 0xB9FCA058B4DC5354, 0x146F726D201566FD,
-    0x0FB3E88EE7F885F0, 0xA2203ABB7331B059, 0xF9079ED05AA3DB0B, 0x54944CE5CE6AEEA2,
-    0xCEBEAB17D5781D11, 0x632D792241B128B8, 0x380ADD49682343EA, 0x95990F7CFCEA7643,
-    0x8E45959F3B07954E, 0x23D647AAAFCEA0E7, 0x78F1E3C1865CCBB5, 0xD56231F41295FE1C,
-    0xE137FE1024B0197A, 0x4CA42C25B0792CD3, 0x1783884E99EB4781, 0xBA105A7B0D227228,
-    0xA1CCC098CACF9125, 0x0C5F12AD5E06A48C, 0x5778B6C67794CFDE, 0xFAEB64F3E35DFA77,
-    0x60C18301F84F09C4, 0xCD5251346C863C6D, 0x9675F55F4514573F, 0x3BE6276AD1DD6296,
-    0x203ABD891630819B, 0x8DA96FBC82F9B432, 0xD68ECBD7AB6BDF60, 0x7B1D19E23FA2EAC9,
-    0xBE25541FC72011AC, 0x13B6862A53E92405, 0x489122417A7B4F57, 0xE502F074EEB27AFE,
-    0xFEDE6A97295F99F3, 0x534DB8A2BD96AC5A, 0x086A1CC99404C708, 0xA5F9CEFC00CDF2A1,
-    0x3FD3290E1BDF0112, 0x9240FB3B8F1634BB, 0xC9675F50A6845FE9, 0x64F48D65324D6A40,
-    0x7F281786F5A0894D, 0xD2BBC5B36169BCE4, 0x899C61D848FBD7B6, 0x240FB3EDDC32E21F,
-    0x105A7C09EA170579, 0xBDC9AE3C7EDE30D0, 0xE6EE0A57574C5B82, 0x4B7DD862C3856E2B,
-    0x50A1428104688D26, 0xFD3290B490A1B88F, 0xA61534DFB933D3DD, 0x0B86E6EA2DFAE674,
-    0x91AC011836E815C7, 0x3C3FD32DA221206E, 0x671877468BB34B3C, 0xCA8BA5731F7A7E95,
-    0xD1573F90D8979D98, 0x7CC4EDA54C5EA831, 0x27E349CE65CCC363, 0x8A709BFBF105F6CA,
-    0x9E91AC0C130E1B5E, 0x33027E3987C72EF7, 0x6825DA52AE5545A5, 0xC5B608673A9C700C,
-    0xDE6A9284FD719301, 0x73F940B169B8A6A8, 0x28DEE4DA402ACDFA, 0x854D36EFD4E3F853,
-    0x1F67D11DCFF10BE0, 0xB2F403285B383E49, 0xE9D3A74372AA551B, 0x44407576E66360B2,
-    0x5F9CEF95218E83BF, 0xF20F3DA0B547B616, 0xA92899CB9CD5DD44, 0x04BB4BFE081CE8ED,
-    0x30EE841A3E390F8B, 0x9D7D562FAAF03A22, 0xC65AF24483625170, 0x6BC9207117AB64D9,
-    0x7015BA92D04687D4, 0xDD8668A7448FB27D, 0x86A1CCCC6D1DD92F, 0x2B321EF9F9D4EC86,
-    0xB118F90BE2C61F35, 0x1C8B2B3E760F2A9C, 0x47AC8F555F9D41CE, 0xEA3F5D60CB547467,
-    0xF1E3C7830CB9976A, 0x5C7015B69870A2C3, 0x0757B1DDB1E2C991, 0xAAC463E8252BFC38,
-    0x6FFC2E15DDA9075D, 0xC26FFC20496032F4, 0x9948584B60F259A6, 0x34DB8A7EF43B6C0F,
-    0x2F07109D33D68F02, 0x8294C2A8A71FBAAB, 0xD9B366C38E8DD1F9, 0x7420B4F61A44E450,
-    0xEE0A5304015617E3, 0x43998131959F224A, 0x18BE255ABC0D4918, 0xB52DF76F28C47CB1,
-    0xAEF16D8CEF299FBC, 0x0362BFB97BE0AA15, 0x58451BD25272C147, 0xF5D6C9E7C6BBF4EE,
-    0xC1830603F09E1388, 0x6C10D43664572621, 0x3737705D4DC54D73, 0x9AA4A268D90C78DA,
-    0x8178388B1EE19BD7, 0x2CEBEABE8A28AE7E, 0x77CC4ED5A3BAC52C, 0xDA5F9CE03773F085,
-    0x40757B122C610336, 0xEDE6A927B8A8369F, 0xB6C10D4C913A5DCD, 0x1B52DF7905F36864,
-    0x008E459AC21E8B69, 0xAD1D97AF56D7BEC0, 0xF63A33C47F45D592, 0x5BA9E1F1EB8CE03B,
-    0xD1D97A0A1A8916F1, 0x7C4AA83F8E402358, 0x276D0C54A7D2480A, 0x8AFEDE61331B7DA3,
-    0x91224482F4F69EAE, 0x3CB196B7603FAB07, 0x679632DC49ADC055, 0xCA05E0E9DD64F5FC,
-    0x502F071BC676064F, 0xFDBCD52E52BF33E6, 0xA69B71457B2D58B4, 0x0B08A370EFE46D1D,
-    0x10D4399328098E10, 0xBD47EBA6BCC0BBB9, 0xE6604FCD9552D0EB, 0x4BF39DF8019BE542,
-    0x7FA6521C37BE0224, 0xD2358029A377378D, 0x891224428AE55CDF, 0x2481F6771E2C6976,
-    0x3F5D6C94D9C18A7B, 0x92CEBEA14D08BFD2, 0xC9E91ACA649AD480, 0x647AC8FFF053E129,
-    0xFE502F0DEB41129A, 0x53C3FD387F882733, 0x08E45953561A4C61, 0xA5778B66C2D379C8,
-    0xBEAB1185053E9AC5, 0x1338C3B091F7AF6C, 0x481F67DBB865C43E, 0xE58CB5EE2CACF197,
-    0x20B4F813D42E0AF2, 0x8D272A2640E73F5B, 0xD6008E4D69755409, 0x7B935C78FDBC61A0,
-    0x604FC69B3A5182AD, 0xCDDC14AEAE98B704, 0x96FBB0C5870ADC56, 0x3B6862F013C3E9FF,
-    0xA142850208D11A4C, 0x0CD157379C182FE5, 0x57F6F35CB58A44B7, 0xFA6521692143711E,
-    0xE1B9BB8AE6AE9213, 0x4C2A69BF7267A7BA, 0x170DCDD45BF5CCE8, 0xBA9E1FE1CF3CF941,
-    0x8ECBD005F9191E27, 0x235802306DD02B8E, 0x787FA65B444240DC, 0xD5EC746ED08B7575,
-    0xCE30EE8D17669678, 0x63A33CB883AFA3D1, 0x388498D3AA3DC883, 0x95174AE63EF4FD2A,
-    0x0F3DAD1425E60E99, 0xA2AE7F21B12F3B30, 0xF989DB4A98BD5062, 0x541A097F0C7465CB,
-    0x4FC6939CCB9986C6, 0xE25541A95F50B36F, 0xB972E5C276C2D83D, 0x14E137F7E20BED94
-};
+// Minimum size of the shader data in the on-disk file for the file to be compacted when most of it is stale
+static constexpr size_t MinCompactionDataSize = 1024 * 1024;
+
+// Minimum size of the shader data for it to be compressed, below which compression saves too little to be worth the
+// cost of decompression on each use
+static constexpr size_t MinCompressionSize = 4096;
+
+// Minimum count of shader records appended to the on-disk file between index records. The interval also grows with the
+// count of shaders in the file, so that the total size of the index records stays proportional to the file size.
+static constexpr size_t MinIndexRecordInterval = 64;
+
+// Seed of the checksums of shader data and of the records of the on-disk cache file
+static constexpr uint64_t CrcInitialValue = 0xFFFFFFFFFFFFFFFF;
 
 // =====================================================================================================================
 ShaderCache::ShaderCache()
     :
     m_onDiskFile(),
     m_disableCache(true),
-    m_shaderDataEnd(sizeof(ShaderCacheSerializedHeader)),
-    m_totalShaders(0),
-    m_serializedSize(sizeof(ShaderCacheSerializedHeader)),
+    m_mapCacheFile(false),
+    m_memoryBudget(0),
+    m_fileBudget(0),
+    m_compactionFailed(false),
+    m_compressShaders(false),
+    m_sharedDir(false),
+    m_sharedDirReadOnly(false),
+    m_fileReadOnly(false),
+    m_clockShard(0),
+    m_shaderDataEnd(sizeof(ShaderCacheFileHeader)),
+    m_recordsSinceIndex(0),
+    m_residentSize(0),
     m_pfnGetValueFunc(nullptr),
-    m_pfnStoreValueFunc(nullptr)
+    m_pfnStoreValueFunc(nullptr),
+    m_pfnGetValueV2Func(nullptr),
+    m_pfnReleaseValueFunc(nullptr),
+    m_pfnStoreValueAsyncFunc(nullptr),
+    m_externalCacheUnavailable(false),
+    m_pendingStoreCount(0)
 {
     memset(m_fileFullPath, 0, MaxFilePathLen);
+    memset(m_sharedDirPath, 0, MaxFilePathLen);
     memset(&m_gfxIp, 0, sizeof(m_gfxIp));
 }
 
@@ -141,32 +109,34 @@ ShaderCache::~ShaderCache()
 // Destruction, does clean-up work.
 void ShaderCache::Destroy()
 {
+    WaitForPendingStores();
+
     if (m_onDiskFile.IsOpen())
     {
-        m_onDiskFile.Close();
+        std::lock_guard<sys::Mutex> lock(m_fileLock);
+        CloseCacheFile();
     }
     ResetRuntimeCache();
 }
 
 // =====================================================================================================================
-// Resets the runtime shader cache to an empty state. Releases all allocator memory and decommits it back to the OS.
+// Resets the runtime shader cache to an empty state. Releases the storage of all shader data that is not still in use
+// by a pipeline binary view.
+//
+// NOTE: This function assumes that the calling function has exclusive access to the shader cache.
 void ShaderCache::ResetRuntimeCache()
 {
-    for (auto indexMap : m_shaderIndexMap)
-    {
-        delete indexMap.second;
-    }
-    m_shaderIndexMap.clear();
-
-    for (auto allocIt : m_allocationList)
+    for (auto& shard : m_shards)
     {
-        delete[] allocIt.first;
+        for (auto indexMap : shard.indexMap)
+        {
+            delete indexMap.second;
+        }
+        shard.indexMap.clear();
+        shard.clockHand = 0;
     }
-    m_allocationList.clear();
 
-    m_totalShaders   = 0;
-    m_shaderDataEnd  = sizeof(ShaderCacheSerializedHeader);
-    m_serializedSize = sizeof(ShaderCacheSerializedHeader);
+    m_residentSize = 0;
 }
 
 // =====================================================================================================================
@@ -183,51 +153,57 @@ Result ShaderCache::Serialize(
     if (*pSize == 0)
     {
         // Query shader cache serailzied size
-        (*pSize) = m_serializedSize;
+        (*pSize) = sizeof(ShaderCacheSerializedHeader) + m_residentSize;
     }
     else
     {
-        // Do serialize
-        assert(m_shaderDataEnd == m_serializedSize || (m_shaderDataEnd == sizeof(ShaderCacheSerializedHeader)));
+        // Do serialize. Only the shaders held in memory are written, each once, so shaders that were evicted or
+        // replaced by an upgrade are left out.
+        LockCacheMap(true);
 
-        if (m_serializedSize >= sizeof(ShaderCacheSerializedHeader))
+        if ((pBlob != nullptr) && ((*pSize) >= sizeof(ShaderCacheSerializedHeader)))
         {
-            if ((pBlob != nullptr) && ((*pSize) >= m_serializedSize))
-            {
-                // First construct the header and copy it into the memory provided
-                ShaderCacheSerializedHeader header = {};
-                header.headerSize    = sizeof(ShaderCacheSerializedHeader);
-                header.shaderCount   = m_totalShaders;
-                header.shaderDataEnd = m_shaderDataEnd;
-                GetBuildTime(&header.buildId);
-
-                memcpy(pBlob, &header, sizeof(ShaderCacheSerializedHeader));
+            ShaderCacheSerializedHeader header = {};
+            header.headerSize = sizeof(ShaderCacheSerializedHeader);
+            GetBuildTime(&header.buildId);
 
-                void* pDataDst = VoidPtrInc(pBlob, sizeof(ShaderCacheSerializedHeader));
+            void* pDataDst = VoidPtrInc(pBlob, sizeof(ShaderCacheSerializedHeader));
 
-                // Then iterate through all allocators (which hold the backing memory for the shader data)
-                // and copy their contents to the blob.
-                for (auto it : m_allocationList)
+            // Copy the data of all ready shaders to the blob, then construct the header and copy it into the memory
+            // provided.
+            for (auto& shard : m_shards)
+            {
+                for (auto it : shard.indexMap)
                 {
-                    assert(it.first != nullptr);
+                    const ShaderIndex* pIndex = it.second;
+                    if ((pIndex->state != ShaderEntryState::Ready) || (pIndex->pDataBlob == nullptr))
+                    {
+                        continue;
+                    }
 
-                    const size_t copySize = it.second;
+                    const size_t copySize = pIndex->header.size;
                     if (VoidPtrDiff(pDataDst, pBlob) + copySize > (*pSize))
                     {
                         result = Result::ErrorUnknown;
                         break;
                     }
 
-                    memcpy(pDataDst, it.first, copySize);
+                    memcpy(pDataDst, pIndex->pDataBlob, copySize);
                     pDataDst = VoidPtrInc(pDataDst, copySize);
+                    ++header.shaderCount;
                 }
             }
-            else
-            {
-                llvm_unreachable("Should never be called!");
-                result = Result::ErrorUnknown;
-            }
+
+            header.shaderDataEnd = VoidPtrDiff(pDataDst, pBlob);
+            memcpy(pBlob, &header, sizeof(ShaderCacheSerializedHeader));
+        }
+        else
+        {
+            llvm_unreachable("Should never be called!");
+            result = Result::ErrorUnknown;
         }
+
+        UnlockCacheMap(true);
     }
 
     return result;
@@ -235,6 +211,13 @@ Result ShaderCache::Serialize(
 
 // =====================================================================================================================
 // Merges the shader data of source shader caches into this shader cache.
+//
+// The shaders are merged in bulk: the ready shaders of all source caches are sorted by key to drop duplicates and
+// shaders this cache already holds, and the data of the rest is copied into a single allocation. The CRCs stored in
+// the shader headers are kept as they are, as the data is copied unchanged.
+//
+// This cache, and a source cache listed more than once, are skipped as sources. The caches are locked in the order of
+// their addresses, so that merges into different caches of each other do not deadlock.
 Result ShaderCache::Merge(
     uint32_t             srcCacheCount,  // Count of input source shader caches
     const IShaderCache** ppSrcCaches)    // [in] Input shader caches
@@ -244,36 +227,110 @@ Result ShaderCache::Merge(
 
     Result result = Result::Success;
 
-    LockCacheMap(false);
-
+    std::vector<ShaderCache*> srcCaches;
     for (uint32_t i = 0; i < srcCacheCount; i++)
     {
         ShaderCache* pSrcCache = static_cast<ShaderCache*>(const_cast<IShaderCache*>(ppSrcCaches[i]));
-        pSrcCache->LockCacheMap(true);
+        if ((pSrcCache != this) && (std::find(srcCaches.begin(), srcCaches.end(), pSrcCache) == srcCaches.end()))
+        {
+            srcCaches.push_back(pSrcCache);
+        }
+    }
+
+    // Lock this cache for writes and the source caches for reads, in a fixed order. The source caches stay locked
+    // until their data is copied.
+    std::vector<ShaderCache*> lockOrder(srcCaches);
+    lockOrder.push_back(this);
+    std::sort(lockOrder.begin(), lockOrder.end(), std::less<ShaderCache*>());
+    for (ShaderCache* pCache : lockOrder)
+    {
+        pCache->LockCacheMap(pCache != this);
+    }
+
+    // Collect the ready shaders of all source caches.
+    std::vector<const ShaderIndex*> srcEntries;
+    for (ShaderCache* pSrcCache : srcCaches)
+    {
+        for (auto& srcShard : pSrcCache->m_shards)
+        {
+            for (auto it : srcShard.indexMap)
+            {
+                if ((it.second->state == ShaderEntryState::Ready) && (it.second->pDataBlob != nullptr))
+                {
+                    srcEntries.push_back(it.second);
+                }
+            }
+        }
+    }
+
+    // Sort the shaders by key, keeping the order of the source caches for equal keys so that the shader of the first
+    // source cache is merged. Then drop duplicates and the shaders already in this cache, and total the data size.
+    std::stable_sort(srcEntries.begin(),
+                     srcEntries.end(),
+                     [](const ShaderIndex* pLhs, const ShaderIndex* pRhs)
+                     {
+                         return pLhs->header.key < pRhs->header.key;
+                     });
+
+    size_t mergeCount = 0;
+    size_t dataSize = 0;
+    uint32_t shardMergeCounts[ShaderIndexShardCount] = {};
+    for (const ShaderIndex* pSrcIndex : srcEntries)
+    {
+        const uint64_t key = pSrcIndex->header.key;
+        if (((mergeCount > 0) && (srcEntries[mergeCount - 1]->header.key == key)) ||
+            (GetShard(key)->indexMap.count(key) > 0))
+        {
+            continue;
+        }
+
+        srcEntries[mergeCount++] = pSrcIndex;
+        dataSize += pSrcIndex->header.size;
+        ++shardMergeCounts[GetShard(key) - &m_shards[0]];
+    }
+    srcEntries.resize(mergeCount);
 
-        for (auto it : pSrcCache->m_shaderIndexMap)
+    if (mergeCount > 0)
+    {
+        // NOTE: The merged shaders share one allocation, as do the shaders loaded from a blob, so it is only freed
+        // once all of them have been evicted.
+        std::shared_ptr<void> storage = GetCacheSpace(dataSize);
+        void* pDataDst = storage.get();
+
+        if (pDataDst != nullptr)
         {
-            uint64_t key = it.first;
+            for (uint32_t shard = 0; shard < ShaderIndexShardCount; ++shard)
+            {
+                m_shards[shard].indexMap.reserve(m_shards[shard].indexMap.size() + shardMergeCounts[shard]);
+            }
 
-            auto indexMap = m_shaderIndexMap.find(key);
-            if (indexMap == m_shaderIndexMap.end())
+            for (const ShaderIndex* pSrcIndex : srcEntries)
             {
-                ShaderIndex* pIndex = nullptr;
-                void* pMem = GetCacheSpace(it.second->header.size);
-                memcpy(pMem, it.second->pDataBlob, it.second->header.size);
+                const size_t copySize = pSrcIndex->header.size;
+                memcpy(pDataDst, pSrcIndex->pDataBlob, copySize);
 
-                pIndex = new ShaderIndex;
-                pIndex->pDataBlob = pMem;
+                ShaderIndex* pIndex = new ShaderIndex();
+                SetShaderData(pIndex, pSrcIndex->header, pDataDst, storage);
                 pIndex->state = ShaderEntryState::Ready;
-                pIndex->header = it.second->header;
+                pIndex->upgraded = false;
+                pIndex->verified = pSrcIndex->verified;
 
-                m_shaderIndexMap[key] = pIndex;
-                m_totalShaders++;
+                GetShard(pSrcIndex->header.key)->indexMap[pSrcIndex->header.key] = pIndex;
+                pDataDst = VoidPtrInc(pDataDst, copySize);
             }
         }
+        else
+        {
+            result = Result::ErrorOutOfMemory;
+        }
+    }
+
+    for (ShaderCache* pSrcCache : srcCaches)
+    {
         pSrcCache->UnlockCacheMap(true);
     }
 
+    ApplyBudgets();
     UnlockCacheMap(false);
 
     return result;
@@ -287,14 +344,27 @@ Result ShaderCache::Init(
 {
     Result result = Result::Success;
 
+    // The single-call lookup can only be used if leases on the client's buffers can be released.
+    if ((pCreateInfo->pfnGetValueV2Func != nullptr) && (pCreateInfo->pfnReleaseValueFunc == nullptr))
+    {
+        return Result::ErrorInvalidValue;
+    }
+
     if (pAuxCreateInfo->shaderCacheMode != ShaderCacheDisable)
     {
         m_disableCache = false;
         m_pClientData       = pCreateInfo->pClientData;
         m_pfnGetValueFunc   = pCreateInfo->pfnGetValueFunc;
         m_pfnStoreValueFunc = pCreateInfo->pfnStoreValueFunc;
+        m_pfnStoreValueAsyncFunc = pCreateInfo->pfnStoreValueAsyncFunc;
+        m_pfnGetValueV2Func   = pCreateInfo->pfnGetValueV2Func;
+        m_pfnReleaseValueFunc = pCreateInfo->pfnReleaseValueFunc;
         m_gfxIp             = pAuxCreateInfo->gfxIp;
         m_hash              = pAuxCreateInfo->hash;
+        m_mapCacheFile      = pAuxCreateInfo->mapCacheFile;
+        m_memoryBudget      = pAuxCreateInfo->memoryBudget;
+        m_fileBudget        = pAuxCreateInfo->fileBudget;
+        m_compressShaders   = pAuxCreateInfo->compressShaders && zlib::isAvailable();
 
         LockCacheMap(false);
 
@@ -306,6 +376,17 @@ Result ShaderCache::Init(
                 ResetRuntimeCache();
             }
         }
+        // If we're in on-disk mode and the cache is shared with other processes, shaders are loaded from the shared
+        // directory as they are looked up, rather than up front.
+        else if (((pAuxCreateInfo->shaderCacheMode == ShaderCacheEnableOnDisk) ||
+                  (pAuxCreateInfo->shaderCacheMode == ShaderCacheForceInternalCacheOnDisk) ||
+                  (pAuxCreateInfo->shaderCacheMode == ShaderCacheEnableOnDiskReadOnly)) &&
+                 pAuxCreateInfo->shareCacheDir)
+        {
+            result = BuildSharedDirName(pAuxCreateInfo->pCacheFilePath, pAuxCreateInfo->gfxIp);
+            m_sharedDir         = (result == Result::Success);
+            m_sharedDirReadOnly = (pAuxCreateInfo->shaderCacheMode == ShaderCacheEnableOnDiskReadOnly);
+        }
         // If we're in on-disk mode try to load the cache from file.
         else if ((pAuxCreateInfo->shaderCacheMode == ShaderCacheEnableOnDisk) ||
                  (pAuxCreateInfo->shaderCacheMode == ShaderCacheForceInternalCacheOnDisk) ||
@@ -313,6 +394,7 @@ Result ShaderCache::Init(
         {
             // Default to false because the cache file is invalid if it's brand new
             bool cacheFileExists = false;
+            m_fileReadOnly = (pAuxCreateInfo->shaderCacheMode == ShaderCacheEnableOnDiskReadOnly);
 
             // Build the cache file name and make required directories if necessary
             // cacheFileValid gets initially set based on whether the file exists.
@@ -326,7 +408,7 @@ Result ShaderCache::Init(
                 // Open the storage file if it exists
                 if (cacheFileExists)
                 {
-                    if (pAuxCreateInfo->shaderCacheMode == ShaderCacheEnableOnDiskReadOnly)
+                    if (m_fileReadOnly)
                     {
                         result = m_onDiskFile.Open(m_fileFullPath, (FileAccessRead | FileAccessBinary));
                     }
@@ -335,8 +417,8 @@ Result ShaderCache::Init(
                         result = m_onDiskFile.Open(m_fileFullPath, (FileAccessReadUpdate | FileAccessBinary));
                     }
                 }
-                else
-                // Create the storage file if it does not exist
+                else if (m_fileReadOnly == false)
+                // Create the storage file if it does not exist, unless the file must not be written
                 {
                     result = m_onDiskFile.Open(m_fileFullPath, (FileAccessRead | FileAccessAppend | FileAccessBinary));
                 }
@@ -349,13 +431,13 @@ Result ShaderCache::Init(
                 if (cacheFileExists)
                 {
                     loadResult = LoadCacheFromFile();
-                    if ((pAuxCreateInfo->shaderCacheMode == ShaderCacheEnableOnDiskReadOnly) &&
-                        (loadResult == Result::Success))
+                    if (m_fileReadOnly)
                     {
+                        // Nothing is written to a read-only file, so it is not needed once loaded.
                         m_onDiskFile.Close();
                     }
                 }
-                else
+                else if (m_fileReadOnly == false)
                 {
                     ResetCacheFile();
                 }
@@ -369,6 +451,10 @@ Result ShaderCache::Init(
             }
         }
 
+        // Bring the loaded cache within its budgets before it is used, which also compacts a cache file that holds
+        // many replaced shaders.
+        ApplyBudgets();
+
         UnlockCacheMap(false);
     }
     else
@@ -419,6 +505,155 @@ Result ShaderCache::BuildFileName(
     return result;
 }
 
+// =====================================================================================================================
+// Constructs the path of the directory shared with other processes and puts it in m_sharedDirPath, creating the
+// directory if it is missing. Unlike the cache file, the directory is not specific to the executable, so that all
+// processes share it; it is specific to the build of LLPC and the compilation options instead, as each shader file
+// holds no more than the shader header and data.
+Result ShaderCache::BuildSharedDirName(
+    const char*  pCacheFilePath,      // [in] Root directory of cache file
+    GfxIpVersion gfxIp)               // Graphics IP version info
+{
+    BuildUniqueId buildId;
+    GetBuildTime(&buildId);
+
+    char dirName[MaxFilePathLen];
+    snprintf(dirName, MaxFilePathLen, "%s.%u.%u.%u", ClientStr, gfxIp.major, gfxIp.minor, gfxIp.stepping);
+
+    // Hash the build date and time and the hash of the compilation options into the directory name as well.
+    uint32_t nameHash = djbHash(dirName, 0);
+    nameHash = djbHash(StringRef(reinterpret_cast<const char*>(&buildId), sizeof(buildId)), nameHash);
+
+    snprintf(m_sharedDirPath,
+             MaxFilePathLen,
+             "%s%s%s%08x",
+             pCacheFilePath,
+             CacheFileSubPath,
+             SharedDirPrefix,
+             nameHash);
+
+    Result result = Result::Success;
+    std::error_code errCode = sys::fs::create_directories(m_sharedDirPath);
+    if (errCode)
+    {
+        LLPC_ERRS("Failed to create shared shader cache directory " << m_sharedDirPath << ": " << errCode.message() <<
+                  "\n");
+        result = Result::ErrorUnavailable;
+    }
+
+    return result;
+}
+
+// =====================================================================================================================
+// Gets the full path of the file holding the specified shader in the shared directory.
+void ShaderCache::GetSharedFileName(
+    uint64_t hashKey,       // Hash key of the shader
+    char*    pFileName)     // [out] Full path of the file, of MaxFilePathLen characters
+{
+    snprintf(pFileName, MaxFilePathLen, "%s/%016llx.bin", m_sharedDirPath, static_cast<unsigned long long>(hashKey));
+}
+
+// =====================================================================================================================
+// Loads the data of a new shader cache entry from its file in the directory shared with other processes. The entry
+// must be in the Compiling state and owned by the calling thread, which does not hold the lock. Returns true if the
+// shader was found. Shader files are only ever replaced as a whole by a rename, so a file found is never partially
+// written; a corrupted file is ignored, and replaced when the shader is compiled again.
+bool ShaderCache::LoadShaderFromSharedDir(
+    ShaderIndex* pIndex)    // [in/out] New shader cache entry
+{
+    char fileName[MaxFilePathLen];
+    GetSharedFileName(pIndex->header.key, fileName);
+
+    File file;
+    Result result = file.Open(fileName, (FileAccessRead | FileAccessBinary));
+
+    const size_t fileSize = (result == Result::Success) ? File::GetFileSize(fileName) : 0;
+    std::shared_ptr<void> storage;
+    if ((result == Result::Success) && (fileSize > sizeof(ShaderHeader)))
+    {
+        storage = GetCacheSpace(fileSize);
+        size_t bytesRead = 0;
+        result = (storage != nullptr) ? file.Read(storage.get(), fileSize, &bytesRead) : Result::ErrorOutOfMemory;
+        if ((result == Result::Success) && (bytesRead != fileSize))
+        {
+            result = Result::ErrorUnknown;
+        }
+    }
+    else
+    {
+        result = Result::ErrorUnavailable;
+    }
+    file.Close();
+
+    if (result == Result::Success)
+    {
+        const auto*const pHeader = static_cast<const ShaderHeader*>(storage.get());
+        const uint64_t crc = CalculateCrc(reinterpret_cast<const uint8_t*>(pHeader + 1),
+                                          (fileSize - sizeof(ShaderHeader)));
+        if ((pHeader->key == pIndex->header.key) && (pHeader->size == fileSize) && (pHeader->crc == crc))
+        {
+            SetShaderData(pIndex, *pHeader, pHeader, std::move(storage));
+            pIndex->upgraded = false;
+            pIndex->verified = true;
+            ++m_counters.sharedDirHitCount;
+        }
+        else
+        {
+            LLPC_ERRS("Shared shader cache file " << fileName << " is corrupted\n");
+            result = Result::ErrorUnknown;
+        }
+    }
+
+    return (result == Result::Success);
+}
+
+// =====================================================================================================================
+// Stores a shader (the shader header followed by the shader data) to its file in the directory shared with other
+// processes. The file is written under a unique temporary name, synced to disk and then renamed, so that other
+// processes see either the complete file or none, even after a crash; when several processes store the same shader,
+// the last rename wins.
+//
+// NOTE: The shared directory is not bounded by the file budget, which applies to a cache file of a single process; it
+// grows by one file per shader stored, and is left to be cleaned up externally.
+void ShaderCache::StoreShaderToSharedDir(
+    const ShaderHeader* pDataBlob)    // [in] Shader header and data
+{
+    char fileName[MaxFilePathLen];
+    GetSharedFileName(pDataBlob->key, fileName);
+
+    SmallString<MaxFilePathLen> tempFileName;
+    std::error_code errCode = sys::fs::createUniqueFile(Twine(fileName) + ".%%%%%%%%.tmp", tempFileName);
+    Result result = errCode ? Result::ErrorUnknown : Result::Success;
+    if (result == Result::Success)
+    {
+        File tempFile;
+        result = tempFile.Open(tempFileName.c_str(), (FileAccessWrite | FileAccessBinary));
+        if (result == Result::Success)
+        {
+            result = tempFile.Write(pDataBlob, pDataBlob->size);
+        }
+        if (result == Result::Success)
+        {
+            result = tempFile.Sync();
+        }
+        tempFile.Close();
+
+        if ((result == Result::Success) && sys::fs::rename(tempFileName, fileName))
+        {
+            result = Result::ErrorUnknown;
+        }
+        if (result != Result::Success)
+        {
+            sys::fs::remove(tempFileName);
+        }
+    }
+
+    if (result != Result::Success)
+    {
+        LLPC_ERRS("Failed to store shader to shared shader cache file " << fileName << "\n");
+    }
+}
+
 // =====================================================================================================================
 // Resets the contents of the cache file, assumes the shader cache has been locked for writes.
 void ShaderCache::ResetCacheFile()
@@ -428,13 +663,78 @@ void ShaderCache::ResetCacheFile()
     assert(fileResult == Result::Success);
     (void(fileResult)); // unused
 
-    ShaderCacheSerializedHeader header = {};
-    header.headerSize    = sizeof(ShaderCacheSerializedHeader);
-    header.shaderCount   = 0;
-    header.shaderDataEnd = header.headerSize;
-    GetBuildTime(&header.buildId);
-
+    ShaderCacheFileHeader header = {};
+    GetFileHeader(&header);
     m_onDiskFile.Write(&header, header.headerSize);
+    m_onDiskFile.Flush();
+
+    m_shaderDataEnd     = header.headerSize;
+    m_recordsSinceIndex = 0;
+    m_fileIndex.clear();
+}
+
+// =====================================================================================================================
+// Fills in the header of a new on-disk cache file.
+void ShaderCache::GetFileHeader(
+    ShaderCacheFileHeader* pHeader)    // [out] File header
+{
+    memset(pHeader, 0, sizeof(*pHeader));
+    pHeader->magic      = ShaderCacheFileMagic;
+    pHeader->version    = ShaderCacheFileVersion;
+    pHeader->headerSize = sizeof(ShaderCacheFileHeader);
+    GetBuildTime(&pHeader->buildId);
+}
+
+// =====================================================================================================================
+// Validates the header of an on-disk cache file, checking that the file was created by this build of LLPC.
+bool ShaderCache::IsValidFileHeader(
+    const ShaderCacheFileHeader* pHeader,     // [in] File header
+    size_t                       fileSize)    // Size of the file in bytes
+{
+    BuildUniqueId buildId;
+    GetBuildTime(&buildId);
+
+    return (fileSize >= sizeof(ShaderCacheFileHeader)) &&
+           (pHeader->magic == ShaderCacheFileMagic) &&
+           (pHeader->version == ShaderCacheFileVersion) &&
+           (pHeader->headerSize == sizeof(ShaderCacheFileHeader)) &&
+           (memcmp(&pHeader->buildId, &buildId, sizeof(buildId)) == 0);
+}
+
+// =====================================================================================================================
+// Locks all shards of the shader index map, for operations on the whole cache.
+void ShaderCache::LockCacheMap(
+    bool readOnly)    // Whether to take read locks rather than write locks
+{
+    for (auto& shard : m_shards)
+    {
+        if (readOnly)
+        {
+            shard.lock.lock_shared();
+        }
+        else
+        {
+            shard.lock.lock();
+        }
+    }
+}
+
+// =====================================================================================================================
+// Unlocks all shards of the shader index map, which were locked by LockCacheMap.
+void ShaderCache::UnlockCacheMap(
+    bool readOnly)    // Whether read locks rather than write locks were taken
+{
+    for (auto& shard : m_shards)
+    {
+        if (readOnly)
+        {
+            shard.lock.unlock_shared();
+        }
+        else
+        {
+            shard.lock.unlock();
+        }
+    }
 }
 
 // =====================================================================================================================
@@ -456,236 +756,497 @@ ShaderEntryState ShaderCache::FindShader(
         return ShaderEntryState::Compiling;
     }
 
+    ++m_counters.lookupCount;
+
     ShaderEntryState result    = ShaderEntryState::Unavailable;
     bool             existed   = false;
+    bool             loaded    = false;
     ShaderIndex*     pIndex    = nullptr;
-    Result           mapResult = Result::Success;
     assert(phEntry != nullptr);
 
-    bool readOnlyLock = (allocateOnMiss == false);
-    LockCacheMap(readOnlyLock);
     uint64_t hashKey = MetroHash::Compact64(&hash);
-    auto indexMap = m_shaderIndexMap.find(hashKey);
-    if (indexMap != m_shaderIndexMap.end())
+    ShaderIndexShard* pShard = GetShard(hashKey);
+
+    // Look up the shader under a read lock first, so that cache hits on different threads do not serialize.
+    pShard->lock.lock_shared();
+    auto indexMap = pShard->indexMap.find(hashKey);
+    if (indexMap != pShard->indexMap.end())
     {
         existed = true;
-        pIndex = indexMap->second;
-    }
-    else if (allocateOnMiss)
-    {
-        pIndex = new ShaderIndex;
-        m_shaderIndexMap[hashKey] = pIndex;
+        pIndex  = indexMap->second;
+        if (pIndex->verified)
+        {
+            result = pIndex->state;
+        }
+        if (result == ShaderEntryState::Ready)
+        {
+            pIndex->referenced.store(true, std::memory_order_relaxed);
+        }
     }
+    pShard->lock.unlock_shared();
 
-    if (pIndex == nullptr)
+    if (result != ShaderEntryState::Ready)
     {
-        mapResult = Result::ErrorUnavailable;
-    }
+        pShard->lock.lock();
 
-    if (mapResult == Result::Success)
-    {
-        if (existed)
+        if (existed == false)
         {
-            // We don't need to hold on to the write lock if we're not the one doing the compile
-            if (readOnlyLock == false)
+            // Look up again, as another thread may have added the entry since the read lock was released.
+            indexMap = pShard->indexMap.find(hashKey);
+            if (indexMap != pShard->indexMap.end())
+            {
+                existed = true;
+                pIndex  = indexMap->second;
+            }
+            else if (allocateOnMiss)
             {
-                UnlockCacheMap(readOnlyLock);
-                readOnlyLock = true;
-                LockCacheMap(readOnlyLock);
+                // This is a brand new cache entry. It starts in the Compiling state, so that other threads looking
+                // for the same shader wait while this thread queries the external cache or compiles the shader.
+                pIndex = new ShaderIndex();
+                pIndex->header.key = hashKey;
+                pIndex->state      = ShaderEntryState::Compiling;
+                pShard->indexMap[hashKey] = pIndex;
             }
         }
-        else
-        {
-            bool needsInit = true;
 
-            // We didn't find the entry in our own hash map, now search the external cache if available
-            if (UseExternalCache())
+        if (pIndex == nullptr)
+        {
+            result = ShaderEntryState::Unavailable;
+        }
+        else if (existed == false)
+        {
+            // We didn't find the entry in our own hash map, now search the directory shared with other processes and
+            // the external cache if available. The lock is not held while doing so.
+            if (m_sharedDir || UseExternalCache())
             {
-                // The first call to the external cache queries the existence and the size of the cached shader.
-                Result extResult = m_pfnGetValueFunc(m_pClientData, hashKey, nullptr, &pIndex->header.size);
-                if (extResult == Result::Success)
+                pShard->lock.unlock();
+                loaded = m_sharedDir && LoadShaderFromSharedDir(pIndex);
+                if ((loaded == false) && UseExternalCache())
                 {
-                    // An entry was found matching our hash, we should allocate memory to hold the data and call again
-                    assert(pIndex->header.size > 0);
-                    pIndex->pDataBlob = GetCacheSpace(pIndex->header.size);
-
-                    if (pIndex->pDataBlob == nullptr)
-                    {
-                        extResult = Result::ErrorOutOfMemory;
-                    }
-                    else
-                    {
-                        extResult =
-                            m_pfnGetValueFunc(m_pClientData, hashKey, pIndex->pDataBlob, &pIndex->header.size);
-                    }
+                    loaded = LoadShaderFromExternalCache(pIndex);
                 }
+                pShard->lock.lock();
 
-                if (extResult == Result::Success)
+                if (loaded)
                 {
-                    // We now have a copy of the shader data from the external cache, just need to update the
-                    // ShaderIndex. The first item in the data blob is a ShaderHeader, followed by the serialized
-                    // data blob for the shader.
-                    const auto*const pHeader = static_cast<const ShaderHeader*>(pIndex->pDataBlob);
-                    assert(pIndex->header.size == pHeader->size);
-
-                    pIndex->header = (*pHeader);
-                    pIndex->state  = ShaderEntryState::Ready;
-                    needsInit      = false;
+                    pIndex->state = ShaderEntryState::Ready;
+                    WakeWaiters(pIndex);
                 }
-                else if (extResult == Result::ErrorUnavailable)
+            }
+            result = pIndex->state;
+        }
+        else
+        {
+            if (pIndex->state == ShaderEntryState::Compiling)
+            {
+                // The shader is being compiled by another thread, we should release the lock and wait for it to
+                // complete. The waiters of an entry share a condition variable, which is created by the first waiter
+                // and destroyed by the last one, and is signalled only when this entry leaves the Compiling state.
+                if (pIndex->pReadyCond == nullptr)
                 {
-                    // This means the external cache is unavailable and we shouldn't bother using it anymore. To
-                    // prevent useless calls we'll zero out the function pointers.
-                    m_pfnGetValueFunc   = nullptr;
-                    m_pfnStoreValueFunc = nullptr;
+                    pIndex->pReadyCond = new std::condition_variable_any;
                 }
-                else
+                ++pIndex->waiterCount;
+                ++m_counters.waitCount;
+                const auto waitStartTime = std::chrono::steady_clock::now();
+                while (pIndex->state == ShaderEntryState::Compiling)
                 {
-                    // extResult should never be ErrorInvalidMemorySize since Cache space is always allocated based
-                    // on 1st m_pfnGetValueFunc call.
-                    assert(extResult != Result::ErrorOutOfMemory);
-
-                    // Any other result means we just need to continue with initializing the new index/compiling.
+                    pIndex->pReadyCond->wait(pShard->lock);
+                }
+                m_counters.waitLatency.Record(waitStartTime);
+                if (--pIndex->waiterCount == 0)
+                {
+                    delete pIndex->pReadyCond;
+                    pIndex->pReadyCond = nullptr;
                 }
+                // At this point the shader entry is either Ready, New or something failed. We've already
+                // initialized our result code to an error code above, the Ready and New cases are handled below so
+                // nothing else to do here.
             }
 
-            if (needsInit)
+            if ((pIndex->state == ShaderEntryState::Ready) && (pIndex->verified == false))
             {
-                // This is a brand new cache entry so we need to initialize the ShaderIndex.
-                memset(pIndex, 0, sizeof(*pIndex));
-                pIndex->header.key = hashKey;
-                pIndex->state      = ShaderEntryState::New;
+                // The shader was loaded from a mapped cache file, check its CRC on this first use.
+                VerifyShader(pIndex);
             }
-        }   // End if (existed == false)
 
-        if (pIndex->state == ShaderEntryState::Compiling)
-        {
-            // The shader is being compiled by another thread, we should release the lock and wait for it to complete
-            while (pIndex->state == ShaderEntryState::Compiling)
+            if (pIndex->state == ShaderEntryState::Ready)
+            {
+                // The shader has been compiled, just verify it has valid data and then return success.
+                assert((pIndex->pDataBlob != nullptr) && (pIndex->header.size != 0));
+                pIndex->referenced.store(true, std::memory_order_relaxed);
+            }
+            else if (pIndex->state == ShaderEntryState::New)
             {
-                UnlockCacheMap(readOnlyLock);
+                // The shader entry is new (or previously failed compilation) and we're the first thread to get a
+                // crack at it, move it into the Compiling state
+                pIndex->state = ShaderEntryState::Compiling;
+
+                if (m_sharedDir)
                 {
-                    std::unique_lock<std::mutex> lock(m_conditionMutex);
+                    // The shader may have been evicted, or compiled by another process since it was last looked up.
+                    pShard->lock.unlock();
+                    loaded = LoadShaderFromSharedDir(pIndex);
+                    pShard->lock.lock();
 
-                    m_conditionVariable.wait_for(lock, std::chrono::seconds(1));
+                    if (loaded)
+                    {
+                        pIndex->state = ShaderEntryState::Ready;
+                        pIndex->referenced.store(true, std::memory_order_relaxed);
+                        WakeWaiters(pIndex);
+                    }
                 }
-                LockCacheMap(readOnlyLock);
             }
-            // At this point the shader entry is either Ready, New or something failed. We've already
-            // initialized our result code to an error code above, the Ready and New cases are handled below so
-            // nothing else to do here.
+            result = pIndex->state;
         }
 
-        if (pIndex->state == ShaderEntryState::Ready)
-        {
-            // The shader has been compiled, just verify it has valid data and then return success.
-            assert((pIndex->pDataBlob != nullptr) && (pIndex->header.size != 0));
-        }
-        else if (pIndex->state == ShaderEntryState::New)
-        {
-            // The shader entry is new (or previously failed compilation) and we're the first thread to get a
-            // crack at it, move it into the Compiling state
-            pIndex->state = ShaderEntryState::Compiling;
-        }
+        pShard->lock.unlock();
+    }
+
+    if (loaded)
+    {
+        EnforceBudgets();
+    }
 
+    if (pIndex != nullptr)
+    {
         // Return the ShaderIndex as a handle so subsequent calls into the cache can avoid the hash map lookup.
         (*phEntry) = pIndex;
-        result     = pIndex->state;
     }
 
-    UnlockCacheMap(readOnlyLock);
+    if (result == ShaderEntryState::Ready)
+    {
+        ++m_counters.hitCount;
+    }
+    else if (result == ShaderEntryState::Compiling)
+    {
+        ++m_counters.missCount;
+    }
 
     return result;
 }
 
 // =====================================================================================================================
-// Inserts a new shader into the cache. The new shader is written to the cache file if it is in-use, and will also
-// upload it to the client's external cache if it is in-use.
-void ShaderCache::InsertShader(
-    CacheEntryHandle         hEntry,                 // [in] Handle of shader cache entry
-    const void*              pBlob,                  // [in] Shader data
-    size_t                   shaderSize)             // size of shader data in bytes
+// Checks the CRC of a shader loaded from a mapped cache file, which is deferred until the shader is first used. If the
+// data is corrupted the entry is reset, so that the shader is compiled again. This function assumes that the write lock
+// of the entry's shard has been taken by the calling function.
+void ShaderCache::VerifyShader(
+    ShaderIndex* pIndex)    // [in,out] Shader cache entry
 {
-    auto*const pIndex = static_cast<ShaderIndex*>(hEntry);
-    assert(m_disableCache == false);
-    assert((pIndex != nullptr) && (pIndex->state == ShaderEntryState::Compiling));
+    assert((pIndex->state == ShaderEntryState::Ready) && (pIndex->verified == false));
 
-    LockCacheMap(false);
+    const uint64_t crc = CalculateCrc(static_cast<const uint8_t*>(VoidPtrInc(pIndex->pDataBlob, sizeof(ShaderHeader))),
+                                      (pIndex->header.size - sizeof(ShaderHeader)));
+    if (crc != pIndex->header.crc)
+    {
+        LLPC_ERRS("Shader cache entry " << format_hex(pIndex->header.key, 18) << " is corrupted\n");
+        ReleaseShaderData(pIndex);
+        pIndex->state = ShaderEntryState::New;
+    }
+    pIndex->verified = true;
+}
 
-    Result result = Result::Success;
+// =====================================================================================================================
+// Wakes the threads waiting for the specified shader cache entry to leave the Compiling state. This function assumes
+// that the write lock of the entry's shard has been taken by the calling function; the notification is done under
+// the lock, as the last waiter destroys the condition variable as soon as it gets the lock back.
+void ShaderCache::WakeWaiters(
+    ShaderIndex* pIndex)    // [in] Shader cache entry
+{
+    if (pIndex->pReadyCond != nullptr)
+    {
+        pIndex->pReadyCond->notify_all();
+    }
+}
 
-    if (result == Result::Success)
+// =====================================================================================================================
+// Loads the data of a new shader cache entry from the client's external cache. The entry must be in the Compiling
+// state and owned by the calling thread, which does not hold the lock. Returns true if the shader was found.
+bool ShaderCache::LoadShaderFromExternalCache(
+    ShaderIndex* pIndex)    // [in/out] New shader cache entry
+{
+    const uint64_t hashKey = pIndex->header.key;
+    size_t dataSize = 0;
+    std::shared_ptr<void> storage;
+    const auto startTime = std::chrono::steady_clock::now();
+    Result extResult = GetExternalValue(hashKey, &storage, &dataSize);
+    m_counters.externalGetLatency.Record(startTime);
+
+    // The first item in the data blob is a ShaderHeader, followed by the serialized data blob for the shader. The data
+    // comes from the client, so data that does not hold a shader header matching the hash key and the size is treated
+    // as a miss.
+    const auto*const pHeader = static_cast<const ShaderHeader*>(storage.get());
+    if ((extResult == Result::Success) &&
+        ((pHeader == nullptr) ||
+         (dataSize < sizeof(ShaderHeader)) ||
+         (pHeader->size != dataSize) ||
+         (pHeader->key != hashKey)))
     {
-        // Allocate space to store the serialized shader and a copy of the header. The header is duplicated in the
-        // data to simplify serialize/load.
-        pIndex->header.size = (shaderSize + sizeof(ShaderHeader));
-        pIndex->pDataBlob   = GetCacheSpace(pIndex->header.size);
+        LLPC_ERRS("Invalid shader data in external cache for entry " << format_hex(hashKey, 18) << "\n");
+        storage.reset();
+        extResult = Result::ErrorUnknown;
+    }
 
-        if (pIndex->pDataBlob == nullptr)
-        {
-            result = Result::ErrorOutOfMemory;
-        }
-        else
-        {
-            ++m_totalShaders;
-
-            auto*const pHeader   = static_cast<ShaderHeader*>(pIndex->pDataBlob);
-            void*const pDataBlob = (pHeader + 1);
-
-            // Serialize the shader into an opaque blob of data.
-            memcpy(pDataBlob, pBlob, shaderSize);
+    if (extResult == Result::Success)
+    {
+        // We now have the shader data from the external cache, just need to update the ShaderIndex.
+        SetShaderData(pIndex, *pHeader, pHeader, std::move(storage));
+        pIndex->upgraded = false;
+        ++m_counters.externalHitCount;
+    }
+    else if (extResult == Result::ErrorUnavailable)
+    {
+        // This means the external cache is unavailable and we shouldn't bother using it anymore.
+        m_externalCacheUnavailable = true;
+    }
+    else
+    {
+        // Any other result, including ErrorOutOfMemory when no space could be allocated for a copy of the data, means
+        // we just need to continue with initializing the new index/compiling.
+        ++m_counters.externalMissCount;
+    }
 
-            // Compute a CRC for the serialized data (useful for detecting data corruption), and copy the index's
-            // header into the data's header.
-            pIndex->header.crc = CalculateCrc(static_cast<uint8_t*>(pDataBlob), shaderSize);
-            (*pHeader)         = pIndex->header;
+    return (extResult == Result::Success);
+}
 
-            if (UseExternalCache())
+// =====================================================================================================================
+// Queries the client's external cache for the data of a shader (the shader header followed by the shader data). On
+// success, returns the storage holding the data, which is either the client's buffer, used in place and released
+// along with the storage, or a copy of the data.
+Result ShaderCache::GetExternalValue(
+    uint64_t               hashKey,     // Hash key of the shader
+    std::shared_ptr<void>* pStorage,    // [out] Storage holding the shader data
+    size_t*                pDataSize)   // [out] Size of the shader data in bytes
+{
+    Result extResult = Result::Success;
+    if (m_pfnGetValueV2Func != nullptr)
+    {
+        // A single call to the external cache hands back the data in a buffer owned by the client.
+        const void* pValue = nullptr;
+        void* pLease = nullptr;
+        extResult = m_pfnGetValueV2Func(m_pClientData, hashKey, &pValue, pDataSize, &pLease);
+        if ((extResult == Result::Success) && ((pValue == nullptr) || (*pDataSize < sizeof(ShaderHeader))))
+        {
+            // The client handed back no shader header, so release the lease and treat the lookup as a miss.
+            m_pfnReleaseValueFunc(m_pClientData, pLease);
+            extResult = Result::ErrorUnknown;
+        }
+        if (extResult == Result::Success)
+        {
+            const auto pfnReleaseValue = m_pfnReleaseValueFunc;
+            const void* pClientData = m_pClientData;
+            std::shared_ptr<void> leasedStorage(const_cast<void*>(pValue),
+                                                [pfnReleaseValue, pClientData, pLease](void*)
+                                                {
+                                                    pfnReleaseValue(pClientData, pLease);
+                                                });
+
+            if ((reinterpret_cast<uintptr_t>(pValue) % alignof(ShaderHeader)) == 0)
+            {
+                *pStorage = std::move(leasedStorage);
+            }
+            else
             {
-                // If we're making use of the external shader cache then we need to store the compiled shader data here.
-                Result externalResult = m_pfnStoreValueFunc(m_pClientData,
-                                                            pIndex->header.key,
-                                                            pIndex->pDataBlob,
-                                                            pIndex->header.size);
-                if (externalResult == Result::ErrorUnavailable)
+                // The shader header cannot be read in place, so copy the data, and release the lease right away.
+                *pStorage = GetCacheSpace(*pDataSize);
+                if (*pStorage == nullptr)
                 {
-                    // This is the only return code we can do anything about. In this case it means the external cache
-                    // is not available and we should zero out the function pointers to avoid making useless calls on
-                    // subsequent shader compiles.
-                    m_pfnGetValueFunc   = nullptr;
-                    m_pfnStoreValueFunc = nullptr;
+                    extResult = Result::ErrorOutOfMemory;
                 }
                 else
                 {
-                    // Otherwise the store either succeeded (yay!) or failed in some other transient way. Either way,
-                    // we will just continue, there's nothing to be done.
+                    memcpy(pStorage->get(), pValue, *pDataSize);
                 }
             }
+        }
+    }
+    else
+    {
+        // The first call to the external cache queries the existence and the size of the cached shader.
+        extResult = m_pfnGetValueFunc(m_pClientData, hashKey, nullptr, pDataSize);
+        if ((extResult == Result::Success) && (*pDataSize < sizeof(ShaderHeader)))
+        {
+            // The cached data is too small to hold a shader header, so treat the lookup as a miss.
+            extResult = Result::ErrorUnknown;
+        }
+        if (extResult == Result::Success)
+        {
+            // An entry was found matching our hash, we should allocate memory to hold the data and call again
+            *pStorage = GetCacheSpace(*pDataSize);
 
-            // Mark this entry as ready, we'll wake the waiting threads once we release the lock
-            pIndex->state = ShaderEntryState::Ready;
-
-            // Finally, update the file if necessary.
-            if (m_onDiskFile.IsOpen())
+            if (*pStorage == nullptr)
+            {
+                extResult = Result::ErrorOutOfMemory;
+            }
+            else
             {
-                AddShaderToFile(pIndex);
+                extResult = m_pfnGetValueFunc(m_pClientData, hashKey, pStorage->get(), pDataSize);
             }
         }
     }
 
-    if (result != Result::Success)
+    return extResult;
+}
+
+// =====================================================================================================================
+// Stores the data of a shader that has been added to the cache (the shader header followed by the shader data) to the
+// client's external cache and to the cache file, if they are in use. This is called without the shard lock held, as
+// it may do slow I/O.
+void ShaderCache::StoreShader(
+    const ShaderHeader*          pDataBlob,   // [in] Shader header and data
+    const std::shared_ptr<void>& storage)     // [in] Storage holding the shader header and data
+{
+    if (UseExternalCache())
+    {
+        // If we're making use of the external shader cache then we need to store the compiled shader data here.
+        StoreShaderToExternalCache(pDataBlob, storage);
+    }
+
+    if (m_sharedDir && (m_sharedDirReadOnly == false))
+    {
+        StoreShaderToSharedDir(pDataBlob);
+    }
+
+    std::lock_guard<sys::Mutex> lock(m_fileLock);
+    if (m_onDiskFile.IsOpen())
+    {
+        AddShaderToFile(pDataBlob);
+    }
+}
+
+// =====================================================================================================================
+// Stores the data of a shader to the client's external cache. With the asynchronous store, the storage of the data is
+// held until the client reports that the store has completed, rather than waiting for it here.
+void ShaderCache::StoreShaderToExternalCache(
+    const ShaderHeader*          pDataBlob,   // [in] Shader header and data
+    const std::shared_ptr<void>& storage)     // [in] Storage holding the shader header and data
+{
+    const auto startTime = std::chrono::steady_clock::now();
+    Result externalResult = Result::Success;
+    if (m_pfnStoreValueAsyncFunc != nullptr)
+    {
+        auto pPendingStore = new ShaderCachePendingStore{ this, storage, startTime };
+        {
+            std::lock_guard<std::mutex> lock(m_pendingStoreLock);
+            ++m_pendingStoreCount;
+        }
+
+        externalResult = m_pfnStoreValueAsyncFunc(m_pClientData,
+                                                  pDataBlob->key,
+                                                  pDataBlob,
+                                                  pDataBlob->size,
+                                                  ExternalStoreDone,
+                                                  pPendingStore);
+        if (externalResult != Result::Success)
+        {
+            // The store was not started, so it will not be reported as completed.
+            ExternalStoreDone(pPendingStore, externalResult);
+        }
+        return;
+    }
+
+    externalResult = m_pfnStoreValueFunc(m_pClientData, pDataBlob->key, pDataBlob, pDataBlob->size);
+    m_counters.externalStoreLatency.Record(startTime);
+    if (externalResult == Result::ErrorUnavailable)
+    {
+        // This is the only return code we can do anything about. In this case it means the external cache
+        // is not available and we should stop making useless calls on subsequent shader compiles.
+        m_externalCacheUnavailable = true;
+    }
+    else
+    {
+        // Otherwise the store either succeeded (yay!) or failed in some other transient way. Either way,
+        // we will just continue, there's nothing to be done.
+    }
+}
+
+// =====================================================================================================================
+// Completes a store to the client's external cache started by StoreShaderToExternalCache. This is called by the
+// client, possibly on a thread of its own, and releases the storage of the shader data.
+void ShaderCache::ExternalStoreDone(
+    void*   pStoreData,   // [in] Pending store, as passed to the client's asynchronous store function
+    Result  result)       // Result of the store
+{
+    auto pPendingStore = static_cast<ShaderCachePendingStore*>(pStoreData);
+    ShaderCache* pCache = pPendingStore->pCache;
+    pCache->m_counters.externalStoreLatency.Record(pPendingStore->startTime);
+    if (result == Result::ErrorUnavailable)
+    {
+        // The external cache is not available, stop making useless calls on subsequent shader compiles.
+        pCache->m_externalCacheUnavailable = true;
+    }
+    delete pPendingStore;
+
+    // NOTE: The cache may be destroyed as soon as the count of pending stores drops to zero, so it is not accessed
+    // after that.
+    std::lock_guard<std::mutex> lock(pCache->m_pendingStoreLock);
+    if (--pCache->m_pendingStoreCount == 0)
+    {
+        pCache->m_pendingStoreCond.notify_all();
+    }
+}
+
+// =====================================================================================================================
+// Waits for the stores to the client's external cache that are in flight to complete.
+void ShaderCache::WaitForPendingStores()
+{
+    std::unique_lock<std::mutex> lock(m_pendingStoreLock);
+    while (m_pendingStoreCount != 0)
+    {
+        m_pendingStoreCond.wait(lock);
+    }
+}
+
+// =====================================================================================================================
+// Inserts a new shader into the cache. The new shader is written to the cache file if it is in-use, and will also
+// upload it to the client's external cache if it is in-use.
+void ShaderCache::InsertShader(
+    CacheEntryHandle         hEntry,                 // [in] Handle of shader cache entry
+    const void*              pBlob,                  // [in] Shader data
+    size_t                   shaderSize)             // size of shader data in bytes
+{
+    auto*const pIndex = static_cast<ShaderIndex*>(hEntry);
+    assert(m_disableCache == false);
+    assert((pIndex != nullptr) && (pIndex->state == ShaderEntryState::Compiling));
+
+    ShaderIndexShard* pShard = GetShard(pIndex->header.key);
+
+    // Store the shader, compressed if enabled, with a copy of the header. This is done without holding the lock, as
+    // other threads do not access the entry's data while it is in the Compiling state. The storage is also held here
+    // until the data has been stored, as the entry may be evicted as soon as the lock is released.
+    std::shared_ptr<void> storage = PackShader(pIndex->header.key, pBlob, shaderSize);
+    const auto*const pHeader = static_cast<const ShaderHeader*>(storage.get());
+
+    pShard->lock.lock();
+
+    if (pHeader != nullptr)
+    {
+        // Mark this entry as ready, and wake the threads waiting for it
+        SetShaderData(pIndex, *pHeader, pHeader, storage);
+        pIndex->state = ShaderEntryState::Ready;
+        pIndex->referenced.store(true, std::memory_order_relaxed);
+        ++m_counters.insertCount;
+        m_counters.insertBytes += pHeader->size;
+    }
+    else
     {
         // Something failed while attempting to add the shader, most likely memory allocation. There's not much we
         // can do here except give up on adding data. This means we need to set the entry back to New so if another
         // thread is waiting it will be allowed to continue (it will likely just get to this same point, but at least
         // we won't hang or crash).
-        pIndex->state       = ShaderEntryState::New;
-        pIndex->header.size = 0;
-        pIndex->pDataBlob   = nullptr;
+        ReleaseShaderData(pIndex);
+        pIndex->state = ShaderEntryState::New;
     }
 
-    UnlockCacheMap(false);
-    m_conditionVariable.notify_all();
+    WakeWaiters(pIndex);
+    pShard->lock.unlock();
+
+    // Finally, update the external cache and the file if necessary, once the waiting threads can go ahead.
+    if (pHeader != nullptr)
+    {
+        StoreShader(pHeader, storage);
+        EnforceBudgets();
+    }
 }
 
 // =====================================================================================================================
@@ -696,69 +1257,285 @@ void ShaderCache::ResetShader(
     auto*const pIndex = static_cast<ShaderIndex*>(hEntry);
     assert(m_disableCache == false);
     assert((pIndex != nullptr) && (pIndex->state == ShaderEntryState::Compiling));
-    LockCacheMap(false);
-    pIndex->state       = ShaderEntryState::New;
-    pIndex->header.size = 0;
-    pIndex->pDataBlob   = nullptr;
-    UnlockCacheMap(false);
-    m_conditionVariable.notify_all();
+    ShaderIndexShard* pShard = GetShard(pIndex->header.key);
+    pShard->lock.lock();
+    ReleaseShaderData(pIndex);
+    pIndex->state = ShaderEntryState::New;
+    WakeWaiters(pIndex);
+    pShard->lock.unlock();
 }
 
 // =====================================================================================================================
-// Retrieves the shader from the cache which is identified by the specified entry handle.
+// Replaces the data of a ready shader with that of a fully optimized build, and marks the entry as upgraded. This is
+// used when the entry was populated by a fast build. The new data is appended to the cache file and stored to the
+// client's external cache, in the same way as for a new shader; the old data is released once it is no longer in use.
+// Nothing is done if the shader is not in the cache.
+void ShaderCache::UpgradeShader(
+    MetroHash::Hash          hash,                   // Hash code of shader
+    const void*              pBlob,                  // [in] Shader data of the fully optimized build
+    size_t                   shaderSize)             // size of shader data in bytes
+{
+    if (m_disableCache)
+    {
+        return;
+    }
+
+    const uint64_t hashKey = MetroHash::Compact64(&hash);
+    ShaderIndexShard* pShard = GetShard(hashKey);
+
+    pShard->lock.lock_shared();
+    auto indexMap = pShard->indexMap.find(hashKey);
+    const bool found = (indexMap != pShard->indexMap.end()) && (indexMap->second->state == ShaderEntryState::Ready);
+    pShard->lock.unlock_shared();
+
+    // Store the new data without holding the lock, as it may be compressed, then swap it into the entry, unless the
+    // entry has been evicted meanwhile.
+    std::shared_ptr<void> storage = found ? PackShader(hashKey, pBlob, shaderSize) : nullptr;
+    const auto*const pHeader = static_cast<const ShaderHeader*>(storage.get());
+    if (pHeader != nullptr)
+    {
+        bool needsData = false;
+        pShard->lock.lock();
+        // NOTE: The entry may have been removed meanwhile, e.g. by ResetRuntimeCache.
+        indexMap = pShard->indexMap.find(hashKey);
+        ShaderIndex* pIndex = (indexMap != pShard->indexMap.end()) ? indexMap->second : nullptr;
+        if ((pIndex != nullptr) && (pIndex->state == ShaderEntryState::Ready))
+        {
+            // The entry may already hold this data, e.g. it was upgraded in an earlier run and reloaded from file.
+            needsData = (pIndex->header.size != pHeader->size) || (pIndex->header.crc != pHeader->crc);
+            if (needsData)
+            {
+                SetShaderData(pIndex, *pHeader, pHeader, storage);
+                pIndex->verified = true;
+                pIndex->referenced.store(true, std::memory_order_relaxed);
+                ++m_counters.upgradeCount;
+            }
+            pIndex->upgraded = true;
+        }
+        pShard->lock.unlock();
+
+        if (needsData)
+        {
+            StoreShader(pHeader, storage);
+            EnforceBudgets();
+        }
+    }
+}
+
+// =====================================================================================================================
+// Checks whether the shader identified by the specified entry handle has been upgraded by UpgradeShader.
+bool ShaderCache::IsShaderUpgraded(
+    CacheEntryHandle   hEntry)   // [in] Handle of shader cache entry
+{
+    const auto*const pIndex = static_cast<ShaderIndex*>(hEntry);
+    assert(pIndex != nullptr);
+
+    ShaderIndexShard* pShard = GetShard(pIndex->header.key);
+    pShard->lock.lock_shared();
+    bool upgraded = pIndex->upgraded;
+    pShard->lock.unlock_shared();
+
+    return upgraded;
+}
+
+// =====================================================================================================================
+// Retrieves the shader from the cache which is identified by the specified entry handle. The shader data may be
+// evicted from the cache at any time, so a caller that uses the data for longer than the call that looked it up should
+// take a reference to its storage. Compressed shader data is decompressed into storage of its own, which only the
+// caller can keep alive, so retrieving a compressed shader without pStorage fails with ErrorInvalidPointer.
 Result ShaderCache::RetrieveShader(
-    CacheEntryHandle   hEntry,   // [in] Handle of shader cache entry
-    const void**       ppBlob,   // [out] Shader data
-    size_t*            pSize)    // [out] size of shader data in bytes
+    CacheEntryHandle       hEntry,   // [in] Handle of shader cache entry
+    const void**           ppBlob,   // [out] Shader data
+    size_t*                pSize,    // [out] size of shader data in bytes
+    std::shared_ptr<void>* pStorage) // [out] Storage of the shader data, which keeps the data valid (optional, but
+                                     //       required for compressed shader data)
 {
     const auto*const pIndex = static_cast<ShaderIndex*>(hEntry);
 
     assert(m_disableCache == false);
     assert(pIndex != nullptr);
-    assert(pIndex->header.size >= sizeof(ShaderHeader));
 
-    LockCacheMap(true);
+    ShaderIndexShard* pShard = GetShard(pIndex->header.key);
+    pShard->lock.lock_shared();
+
+    // The shader may have been evicted since it was looked up.
+    ShaderHeader header = {};
+    const void* pDataBlob = nullptr;
+    std::shared_ptr<void> storage;
+    if ((pIndex->state == ShaderEntryState::Ready) && (pIndex->pDataBlob != nullptr))
+    {
+        assert(pIndex->header.size >= sizeof(ShaderHeader));
+        header    = pIndex->header;
+        pDataBlob = pIndex->pDataBlob;
+        storage   = pIndex->dataStorage;
+    }
+
+    pShard->lock.unlock_shared();
 
-    *ppBlob = VoidPtrInc(pIndex->pDataBlob, sizeof(ShaderHeader));
-    *pSize = pIndex->header.size -  sizeof(ShaderHeader);
+    *ppBlob = nullptr;
+    *pSize  = 0;
+    if ((pDataBlob != nullptr) && (header.flags & ShaderHeaderCompressed))
+    {
+        if (pStorage == nullptr)
+        {
+            return Result::ErrorInvalidPointer;
+        }
 
-    UnlockCacheMap(true);
+        // Decompress the shader data without holding the lock; the storage taken above keeps the data valid.
+        std::shared_ptr<void> shaderStorage = GetCacheSpace(header.rawSize);
+        if ((shaderStorage != nullptr) && UnpackShader(header, pDataBlob, shaderStorage.get()))
+        {
+            *ppBlob   = shaderStorage.get();
+            *pSize    = header.rawSize;
+            *pStorage = std::move(shaderStorage);
+        }
+    }
+    else if (pDataBlob != nullptr)
+    {
+        *ppBlob = VoidPtrInc(pDataBlob, sizeof(ShaderHeader));
+        *pSize = header.size -  sizeof(ShaderHeader);
+        if (pStorage != nullptr)
+        {
+            *pStorage = std::move(storage);
+        }
+    }
 
     return (*pSize > 0) ? Result::Success : Result::ErrorUnknown;
 }
 
 // =====================================================================================================================
-// Adds data for a new shader to the on-disk file
+// Appends a record for a new shader to the on-disk file, followed by an index record if enough shader records have been
+// appended since the last one. Nothing that was written before is rewritten, so a crash while appending can only leave
+// a torn record at the end of the file, which is dropped when the file is next loaded. This function assumes that the
+// file lock has been taken by the calling function.
 void ShaderCache::AddShaderToFile(
-    const ShaderIndex* pIndex)    // [in] A new shader
+    const ShaderHeader* pDataBlob)    // [in] Shader header and data of a new shader
 {
     assert(m_onDiskFile.IsOpen());
 
-    // We only need to update the parts of the file that changed, which is the number of shaders, the new data section,
-    // and the shaderDataEnd.
+    Result result = WriteRecord(&m_onDiskFile,
+                                m_shaderDataEnd,
+                                ShaderCacheRecordType::Shader,
+                                pDataBlob,
+                                pDataBlob->size);
+    if (result == Result::Success)
+    {
+        ShaderCacheIndexEntry& entry = m_fileIndex[pDataBlob->key];
+        entry.header = (*pDataBlob);
+        entry.offset = m_shaderDataEnd;
+
+        m_shaderDataEnd += sizeof(ShaderCacheRecordHeader) + pDataBlob->size;
+        ++m_recordsSinceIndex;
+    }
+
+    // Space the index records out in proportion to the size of the index, so that the space they take stays linear in
+    // the number of shaders.
+    const size_t indexInterval = std::max(MinIndexRecordInterval, m_fileIndex.size() / 4);
+    if ((result == Result::Success) && (m_recordsSinceIndex >= indexInterval))
+    {
+        size_t recordSize = 0;
+        const uint64_t indexOffset = m_shaderDataEnd;
+        result = WriteIndexRecord(&m_onDiskFile, indexOffset, m_fileIndex, &recordSize);
+        if (result == Result::Success)
+        {
+            m_shaderDataEnd    += recordSize;
+            m_recordsSinceIndex = 0;
+
+            // Update the hint in the file header once the index record is in the file, so that recovery after a crash
+            // only needs to scan the records after it.
+            m_onDiskFile.Flush();
+            m_onDiskFile.Seek(offsetof(ShaderCacheFileHeader, lastIndexOffset), true);
+            m_onDiskFile.Write(&indexOffset, sizeof(indexOffset));
+        }
+    }
+
+    m_onDiskFile.Flush();
+}
 
-    // Calculate the header offsets, then write the relavent data to the file.
-    const uint32_t shaderCountOffset = offsetof(struct ShaderCacheSerializedHeader, shaderCount);
-    const uint32_t dataEndOffset     = offsetof(struct ShaderCacheSerializedHeader, shaderDataEnd);
+// =====================================================================================================================
+// Closes the on-disk file, first appending an index record if shader records have been appended since the last one, so
+// that the index is found at the end of the file when it is next loaded. This function assumes that the file lock has
+// been taken by the calling function.
+void ShaderCache::CloseCacheFile()
+{
+    if (m_onDiskFile.IsOpen() && (m_recordsSinceIndex > 0))
+    {
+        size_t recordSize = 0;
+        if (WriteIndexRecord(&m_onDiskFile, m_shaderDataEnd, m_fileIndex, &recordSize) == Result::Success)
+        {
+            m_onDiskFile.Flush();
+            m_onDiskFile.Seek(offsetof(ShaderCacheFileHeader, lastIndexOffset), true);
+            m_onDiskFile.Write(&m_shaderDataEnd, sizeof(m_shaderDataEnd));
+            m_shaderDataEnd    += recordSize;
+            m_recordsSinceIndex = 0;
+        }
+    }
+    m_onDiskFile.Close();
+}
 
-    m_onDiskFile.Seek(shaderCountOffset, true);
-    m_onDiskFile.Write(&m_totalShaders, sizeof(size_t));
+// =====================================================================================================================
+// Calculates the check value of a record header, which covers all of its fields before the check value itself.
+uint64_t ShaderCache::CalculateRecordCheck(
+    const ShaderCacheRecordHeader* pRecord)    // [in] Record header
+{
+    return CalculateCrc(reinterpret_cast<const uint8_t*>(pRecord), offsetof(ShaderCacheRecordHeader, check));
+}
 
-    // Write the new shader data at the current end of the data section
-    m_onDiskFile.Seek(static_cast<uint32_t>(m_shaderDataEnd), true);
-    m_onDiskFile.Write(pIndex->pDataBlob, pIndex->header.size);
+// =====================================================================================================================
+// Writes a record to an on-disk cache file at the specified offset.
+Result ShaderCache::WriteRecord(
+    File*                 pFile,          // [in] Cache file
+    uint64_t              offset,         // File offset to write the record at
+    ShaderCacheRecordType type,           // Type of the record
+    const void*           pPayload,       // [in] Payload of the record
+    size_t                payloadSize)    // Size of the payload in bytes
+{
+    ShaderCacheRecordHeader record = {};
+    record.type  = type;
+    record.size  = payloadSize;
+    record.check = CalculateRecordCheck(&record);
 
-    // Then update the data end value and write it out to the file.
-    m_shaderDataEnd += pIndex->header.size;
-    m_onDiskFile.Seek(dataEndOffset, true);
-    m_onDiskFile.Write(&m_shaderDataEnd, sizeof(size_t));
+    pFile->Seek(offset, true);
+    Result result = pFile->Write(&record, sizeof(record));
+    if (result == Result::Success)
+    {
+        result = pFile->Write(pPayload, payloadSize);
+    }
 
-    m_onDiskFile.Flush();
+    return result;
 }
 
 // =====================================================================================================================
-// Loads all shader data from the cache file into the local cache copy. Returns true if the file contents were loaded
-// successfully or false if invalid data was found.
+// Writes an index record holding the specified file index to an on-disk cache file at the specified offset.
+Result ShaderCache::WriteIndexRecord(
+    File*                       pFile,          // [in] Cache file
+    uint64_t                    offset,         // File offset to write the record at
+    const ShaderCacheFileIndex& fileIndex,      // [in] Index of the shader records in the file
+    size_t*                     pRecordSize)    // [out] Size of the record in bytes
+{
+    const size_t entriesSize = fileIndex.size() * sizeof(ShaderCacheIndexEntry);
+    std::vector<uint8_t> payload(entriesSize + sizeof(ShaderCacheIndexTrailer));
+
+    auto* pEntry = reinterpret_cast<ShaderCacheIndexEntry*>(payload.data());
+    for (const auto& it : fileIndex)
+    {
+        *pEntry++ = it.second;
+    }
+
+    ShaderCacheIndexTrailer trailer = {};
+    trailer.recordOffset = offset;
+    trailer.entryCrc     = CalculateCrc(payload.data(), entriesSize);
+    trailer.magic        = ShaderCacheFileMagic;
+    memcpy(payload.data() + entriesSize, &trailer, sizeof(trailer));
+
+    *pRecordSize = sizeof(ShaderCacheRecordHeader) + payload.size();
+    return WriteRecord(pFile, offset, ShaderCacheRecordType::Index, payload.data(), payload.size());
+}
+
+// =====================================================================================================================
+// Loads all shader data from the cache file into the local cache copy. Returns a failure if the file is not a valid
+// cache file of this build of LLPC. Any torn or corrupted records at the end of the file, left by a crash while
+// appending, are dropped and the file is truncated to the last valid record, or rewritten if it cannot be truncated.
 //
 // NOTE: This function assumes that a write lock has already been taken by the calling function and that the on-disk
 // file has been successfully opened and the file position is the beginning of the file.
@@ -766,33 +1543,42 @@ Result ShaderCache::LoadCacheFromFile()
 {
     assert(m_onDiskFile.IsOpen());
 
-    // Read the header from the file and validate it
-    ShaderCacheSerializedHeader header = {};
-    m_onDiskFile.Rewind();
-    m_onDiskFile.Read(&header, sizeof(ShaderCacheSerializedHeader), nullptr);
-
     const size_t fileSize = File::GetFileSize(m_fileFullPath);
-    const size_t dataSize = fileSize - sizeof(ShaderCacheSerializedHeader);
-    Result result = ValidateAndLoadHeader(&header, fileSize);
+    Result result = (fileSize >= sizeof(ShaderCacheFileHeader)) ? Result::Success : Result::ErrorUnknown;
 
-    void* pDataMem = nullptr;
-    if (result == Result::Success)
+    // The whole file is held in one storage, so that file offsets index into it directly.
+    std::shared_ptr<void> storage;
+    uint8_t* pFileData = nullptr;
+    if ((result == Result::Success) && m_mapCacheFile)
     {
-        // The header is valid, so allocate space to fit all of the shader data.
-        pDataMem = GetCacheSpace(dataSize);
+        // Map the file instead of reading it. Records are only appended while the cache is in use, and the file is
+        // replaced rather than rewritten when it is compacted, so the mapped range does not change; the CRC of each
+        // shader is checked on its first use rather than here.
+        auto mappedFile = MemoryBuffer::getFileSlice(m_fileFullPath, fileSize, 0);
+        if (mappedFile)
+        {
+            pFileData = reinterpret_cast<uint8_t*>(const_cast<char*>((*mappedFile)->getBufferStart()));
+            storage   = std::shared_ptr<MemoryBuffer>(std::move(*mappedFile));
+        }
+        else
+        {
+            result = Result::ErrorUnavailable;
+        }
     }
-
-    if (result == Result::Success)
+    else if (result == Result::Success)
     {
-        if (pDataMem != nullptr)
+        storage   = GetCacheSpace(fileSize);
+        pFileData = static_cast<uint8_t*>(storage.get());
+
+        if (pFileData != nullptr)
         {
-            // Read the shader data into the allocated memory.
-            m_onDiskFile.Seek(sizeof(ShaderCacheSerializedHeader), true);
+            // Read the file into the allocated memory.
+            m_onDiskFile.Rewind();
             size_t bytesRead = 0;
-            result = m_onDiskFile.Read(pDataMem, dataSize, &bytesRead);
+            result = m_onDiskFile.Read(pFileData, fileSize, &bytesRead);
 
             // If we didn't read the correct number of bytes then something went wrong and we should return a failure
-            if (bytesRead != dataSize)
+            if (bytesRead != fileSize)
             {
                 result = Result::ErrorUnknown;
             }
@@ -803,21 +1589,247 @@ Result ShaderCache::LoadCacheFromFile()
         }
     }
 
+    if ((result == Result::Success) &&
+        (IsValidFileHeader(reinterpret_cast<const ShaderCacheFileHeader*>(pFileData), fileSize) == false))
+    {
+        result = Result::ErrorUnknown;
+    }
+
     if (result == Result::Success)
     {
-        // Now setup the shader index hash map.
-        result = PopulateIndexMap(pDataMem, dataSize);
+        const auto*const pHeader = reinterpret_cast<const ShaderCacheFileHeader*>(pFileData);
+        const bool verifyCrc = (m_mapCacheFile == false);
+        m_fileIndex.clear();
+        m_recordsSinceIndex = 0;
+
+        // If the file was closed cleanly, it ends with an index record, whose trailer locates it; its index covers the
+        // whole file, so no record needs to be scanned.
+        uint64_t validEnd = 0;
+        if (fileSize >= pHeader->headerSize + sizeof(ShaderCacheIndexTrailer))
+        {
+            const uint8_t* pTrailerData = pFileData + fileSize - sizeof(ShaderCacheIndexTrailer);
+            const auto*const pTrailer = reinterpret_cast<const ShaderCacheIndexTrailer*>(pTrailerData);
+            if (pTrailer->magic == ShaderCacheFileMagic)
+            {
+                validEnd = LoadIndexRecord(storage, pFileData, fileSize, pTrailer->recordOffset, verifyCrc);
+            }
+        }
+
+        if (validEnd != fileSize)
+        {
+            if (validEnd != 0)
+            {
+                // The bytes at the end of the file merely looked like the trailer of the index record found.
+                ResetRuntimeCache();
+                m_fileIndex.clear();
+            }
+
+            // Otherwise, start from the last index record written, if the hint in the header locates a valid one, and
+            // scan the records after it.
+            uint64_t scanStart = LoadIndexRecord(storage, pFileData, fileSize, pHeader->lastIndexOffset, verifyCrc);
+            if (scanStart == 0)
+            {
+                scanStart = pHeader->headerSize;
+            }
+            validEnd = ScanRecords(storage, pFileData, fileSize, scanStart, verifyCrc);
+        }
+
+        m_shaderDataEnd = validEnd;
+        if ((validEnd < fileSize) && m_fileReadOnly)
+        {
+            // A read-only file is never modified, so the torn or corrupted records are just ignored.
+            LLPC_ERRS("Shader cache file " << m_fileFullPath << " is ignored after its last valid record at offset " <<
+                      validEnd << "\n");
+        }
+        else if (validEnd < fileSize)
+        {
+            // Drop the torn or corrupted records, so that new records are appended after the last valid one.
+            LLPC_ERRS("Shader cache file " << m_fileFullPath << " is truncated to its last valid record at offset " <<
+                      validEnd << "\n");
+            if (m_onDiskFile.Truncate(validEnd) != Result::Success)
+            {
+                // A mapped file cannot be truncated on some platforms, so rewrite it instead. That also ends it with an
+                // index record, so the next load does not need to scan the records. The loaded shaders keep the
+                // mapping alive for as long as they need it.
+                storage.reset();
+                result = CompactCacheFile();
+            }
+        }
     }
 
     if (result != Result::Success)
     {
-        // Something went wrong in loading the file, so reset it
-        ResetCacheFile();
+        // Something went wrong in loading the file, so reset it, or skip it if it must not be written. The runtime
+        // cache is reset first, as its entries may still refer to the mapped file.
+        storage.reset();
+        ResetRuntimeCache();
+        if (m_fileReadOnly)
+        {
+            LLPC_ERRS("Read-only shader cache file " << m_fileFullPath << " is not valid and is skipped\n");
+            m_onDiskFile.Close();
+        }
+        else
+        {
+            ResetCacheFile();
+        }
     }
 
     return result;
 }
 
+// =====================================================================================================================
+// Loads the index record at the specified offset of an on-disk cache file, adding the shaders it lists to the cache.
+// Returns the file offset of the end of the record, or 0 if there is no valid index record at the offset, in which case
+// nothing is added.
+uint64_t ShaderCache::LoadIndexRecord(
+    const std::shared_ptr<void>& storage,       // [in] Storage holding the file
+    const uint8_t*               pFileData,     // [in] File data
+    size_t                       fileSize,      // Size of the file in bytes
+    uint64_t                     offset,        // File offset of the index record
+    bool                         verifyCrc)     // Whether to check the CRCs of the shader data now
+{
+    const auto*const pFileHeader = reinterpret_cast<const ShaderCacheFileHeader*>(pFileData);
+    const auto*const pRecord = reinterpret_cast<const ShaderCacheRecordHeader*>(pFileData + offset);
+
+    // Validate the record, and that its trailer refers back to it.
+    if ((offset < pFileHeader->headerSize) ||
+        (offset > fileSize - sizeof(ShaderCacheRecordHeader)) ||
+        (pRecord->check != CalculateRecordCheck(pRecord)) ||
+        (pRecord->type != ShaderCacheRecordType::Index) ||
+        (pRecord->size > fileSize - offset - sizeof(ShaderCacheRecordHeader)) ||
+        (pRecord->size < sizeof(ShaderCacheIndexTrailer)) ||
+        (((pRecord->size - sizeof(ShaderCacheIndexTrailer)) % sizeof(ShaderCacheIndexEntry)) != 0))
+    {
+        return 0;
+    }
+
+    const uint8_t*const pPayload = reinterpret_cast<const uint8_t*>(pRecord + 1);
+    const size_t entriesSize = pRecord->size - sizeof(ShaderCacheIndexTrailer);
+    const auto*const pTrailer = reinterpret_cast<const ShaderCacheIndexTrailer*>(pPayload + entriesSize);
+    if ((pTrailer->recordOffset != offset) ||
+        (pTrailer->magic != ShaderCacheFileMagic) ||
+        (pTrailer->entryCrc != CalculateCrc(pPayload, entriesSize)))
+    {
+        return 0;
+    }
+
+    // All shader records listed must lie before the index record.
+    const auto*const pEntries = reinterpret_cast<const ShaderCacheIndexEntry*>(pPayload);
+    const size_t entryCount = entriesSize / sizeof(ShaderCacheIndexEntry);
+    for (size_t i = 0; i < entryCount; ++i)
+    {
+        const ShaderCacheIndexEntry& entry = pEntries[i];
+        if ((entry.offset < pFileHeader->headerSize) ||
+            (entry.header.size < sizeof(ShaderHeader)) ||
+            (entry.header.size > offset - sizeof(ShaderCacheRecordHeader)) ||
+            (entry.offset > offset - sizeof(ShaderCacheRecordHeader) - entry.header.size))
+        {
+            return 0;
+        }
+    }
+
+    for (size_t i = 0; i < entryCount; ++i)
+    {
+        const ShaderCacheIndexEntry& entry = pEntries[i];
+        const auto*const pHeader =
+            reinterpret_cast<const ShaderHeader*>(pFileData + entry.offset + sizeof(ShaderCacheRecordHeader));
+
+        // The header stored in the index is used, so that the shader data is not touched unless its CRC is checked.
+        if (verifyCrc &&
+            ((memcmp(pHeader, &entry.header, sizeof(ShaderHeader)) != 0) ||
+             (CalculateCrc(reinterpret_cast<const uint8_t*>(pHeader + 1), pHeader->size - sizeof(ShaderHeader)) !=
+              pHeader->crc)))
+        {
+            // Leave out a corrupted shader, it will be compiled again.
+            continue;
+        }
+        AddShaderFromFile(storage, entry.header, pHeader, entry.offset, verifyCrc);
+    }
+
+    return offset + sizeof(ShaderCacheRecordHeader) + pRecord->size;
+}
+
+// =====================================================================================================================
+// Scans the records of an on-disk cache file from the specified offset, adding the shaders found to the cache. Stops at
+// the end of the file, or at the first torn or corrupted record. Returns the file offset that the scan stopped at,
+// which is the end of the last valid record.
+uint64_t ShaderCache::ScanRecords(
+    const std::shared_ptr<void>& storage,       // [in] Storage holding the file
+    const uint8_t*               pFileData,     // [in] File data
+    size_t                       fileSize,      // Size of the file in bytes
+    uint64_t                     offset,        // File offset of the first record to scan
+    bool                         verifyCrc)     // Whether to check the CRCs of the shader data now
+{
+    while (offset <= fileSize - sizeof(ShaderCacheRecordHeader))
+    {
+        const auto*const pRecord = reinterpret_cast<const ShaderCacheRecordHeader*>(pFileData + offset);
+        if ((pRecord->check != CalculateRecordCheck(pRecord)) ||
+            (pRecord->size > fileSize - offset - sizeof(ShaderCacheRecordHeader)))
+        {
+            break;
+        }
+
+        if (pRecord->type == ShaderCacheRecordType::Shader)
+        {
+            const auto*const pHeader = reinterpret_cast<const ShaderHeader*>(pRecord + 1);
+            if ((pRecord->size < sizeof(ShaderHeader)) || (pHeader->size != pRecord->size))
+            {
+                break;
+            }
+            if (verifyCrc &&
+                (CalculateCrc(reinterpret_cast<const uint8_t*>(pHeader + 1), pHeader->size - sizeof(ShaderHeader)) !=
+                 pHeader->crc))
+            {
+                break;
+            }
+
+            // A later record of the same shader, written by UpgradeShader, replaces an earlier one.
+            AddShaderFromFile(storage, *pHeader, pHeader, offset, verifyCrc);
+            ++m_recordsSinceIndex;
+        }
+        else if (pRecord->type == ShaderCacheRecordType::Index)
+        {
+            // The shader records before an index record have been scanned already.
+            m_recordsSinceIndex = 0;
+        }
+        else
+        {
+            break;
+        }
+
+        offset += sizeof(ShaderCacheRecordHeader) + pRecord->size;
+    }
+
+    return offset;
+}
+
+// =====================================================================================================================
+// Adds a shader loaded from the on-disk cache file to the cache and to the index of the file.
+//
+// NOTE: This function assumes that the calling function has exclusive access to the shader cache.
+void ShaderCache::AddShaderFromFile(
+    const std::shared_ptr<void>& storage,         // [in] Storage holding the file
+    const ShaderHeader&          header,          // [in] Shader header
+    const ShaderHeader*          pDataBlob,       // [in] Shader header in the file, followed by the shader data
+    uint64_t                     recordOffset,    // File offset of the shader record
+    bool                         verified)        // Whether the CRC of the shader data has been checked
+{
+    ShaderIndexMap& indexMap = GetShard(header.key)->indexMap;
+    ShaderIndex*& pIndex = indexMap[header.key];
+    if (pIndex == nullptr)
+    {
+        pIndex = new ShaderIndex();
+        pIndex->state    = ShaderEntryState::Ready;
+        pIndex->upgraded = false;
+    }
+    SetShaderData(pIndex, header, pDataBlob, storage);
+    pIndex->verified = verified;
+
+    ShaderCacheIndexEntry& entry = m_fileIndex[header.key];
+    entry.header = header;
+    entry.offset = recordOffset;
+}
+
 // =====================================================================================================================
 // Loads all shader data from a client provided initial data blob. Returns true if the file contents were loaded
 // successfully or false if invalid data was found.
@@ -837,13 +1849,14 @@ Result ShaderCache::LoadCacheFromBlob(
     {
         // The header appears valid so allocate space for the shader data.
         const size_t dataSize = initialDataSize - pHeader->headerSize;
-        void* pDataMem = GetCacheSpace(dataSize);
+        std::shared_ptr<void> storage = GetCacheSpace(dataSize);
+        void* pDataMem = storage.get();
 
         if (pDataMem != nullptr)
         {
             // Then copy the data and setup the shader index hash map.
             memcpy(pDataMem, VoidPtrInc(pInitialData, pHeader->headerSize), dataSize);
-            result = PopulateIndexMap(pDataMem, dataSize);
+            result = PopulateIndexMap(storage, pDataMem, dataSize, pHeader->shaderCount, true);
         }
         else
         {
@@ -856,10 +1869,14 @@ Result ShaderCache::LoadCacheFromBlob(
 
 // =====================================================================================================================
 // Validates shader data (from a file or a blob) by checking the CRCs and adding index hash map entries if successful.
-// Will return a failure if any of the shader data is invalid.
+// Will return a failure if any of the shader data is invalid. If the CRCs are not checked here, they are checked when
+// each shader is first used.
 Result ShaderCache::PopulateIndexMap(
-    void*  pDataStart,    // [in] Start pointer of cached shader data
-    size_t dataSize)      // Shader data size in bytes
+    const std::shared_ptr<void>& storage,       // [in] Storage holding the shader data
+    void*                        pDataStart,    // [in] Start pointer of cached shader data
+    size_t                       dataSize,      // Shader data size in bytes
+    size_t                       shaderCount,   // Count of shaders in the shader data
+    bool                         verifyCrc)     // Whether to check the CRCs of the shader data now
 {
     Result result = Result::Success;
 
@@ -868,10 +1885,17 @@ Result ShaderCache::PopulateIndexMap(
     // take the hit each time we add shader data to the file.
     auto* pHeader = static_cast<ShaderHeader*>(pDataStart);
 
-    for (uint32_t shader = 0; ((shader < m_totalShaders) && (result == Result::Success)); ++shader)
+    for (size_t shader = 0; ((shader < shaderCount) && (result == Result::Success)); ++shader)
     {
-        // Guard against buffer overruns.
-        assert(VoidPtrDiff(pHeader, pDataStart) <= dataSize);
+        // Guard against buffer overruns. The data may not have been read in full, so this cannot be left to the CRC.
+        const size_t offset = VoidPtrDiff(pHeader, pDataStart);
+        if ((offset + sizeof(ShaderHeader) > dataSize) ||
+            (pHeader->size < sizeof(ShaderHeader)) ||
+            (pHeader->size > dataSize - offset))
+        {
+            result = Result::ErrorUnknown;
+            break;
+        }
 
         // TODO: Add a static function to RelocatableShader to validate the input data.
 
@@ -879,21 +1903,30 @@ Result ShaderCache::PopulateIndexMap(
         void*const pDataBlob = (pHeader + 1);
 
         // Verify the CRC
-        const uint64_t crc = CalculateCrc(static_cast<uint8_t*>(pDataBlob), (pHeader->size - sizeof(ShaderHeader)));
+        const bool crcValid = (verifyCrc == false) ||
+            (CalculateCrc(static_cast<uint8_t*>(pDataBlob), (pHeader->size - sizeof(ShaderHeader))) == pHeader->crc);
 
-        if (crc == pHeader->crc)
+        if (crcValid)
         {
             // It all checks out, so add this shader to the hash map!
+            // NOTE: A shader that was upgraded by UpgradeShader appears again later in the data, so a later entry
+            // replaces an earlier one with the same key.
             ShaderIndex* pIndex = nullptr;
-            auto indexMap = m_shaderIndexMap.find(pHeader->key);
-            if (indexMap == m_shaderIndexMap.end())
+            ShaderIndexMap& shardIndexMap = GetShard(pHeader->key)->indexMap;
+            auto indexMap = shardIndexMap.find(pHeader->key);
+            if (indexMap == shardIndexMap.end())
             {
-                pIndex = new ShaderIndex;
-                pIndex->header    = (*pHeader);
-                pIndex->pDataBlob = pHeader;
-                pIndex->state     = ShaderEntryState::Ready;
-                m_shaderIndexMap[pHeader->key] = pIndex;
+                pIndex = new ShaderIndex();
+                pIndex->state    = ShaderEntryState::Ready;
+                pIndex->upgraded = false;
+                shardIndexMap[pHeader->key] = pIndex;
             }
+            else
+            {
+                pIndex = indexMap->second;
+            }
+            SetShaderData(pIndex, *pHeader, pHeader, storage);
+            pIndex->verified = verifyCrc;
         }
         else
         {
@@ -908,17 +1941,18 @@ Result ShaderCache::PopulateIndexMap(
 }
 
 // =====================================================================================================================
-// Caclulates a 64-bit CRC of the data provided
+// Caclulates a 64-bit checksum of the data provided. It is a 64-bit MetroHash, which processes 32 bytes per step, so
+// files written with the table-driven CRC64 of earlier versions of the on-disk file format are rejected on load by
+// their version.
 uint64_t ShaderCache::CalculateCrc(
     const uint8_t* pData,         // [in]  Data need generate CRC
     size_t         numBytes)      // Data size in bytes
 {
-    uint64_t crc = CrcInitialValue;
-    for (uint32_t byte = 0; byte < numBytes; ++byte)
-    {
-        uint8_t tableIndex = static_cast<uint8_t>(crc >> (CrcWidth - 8)) & 0xFF;
-        crc = (crc << 8) ^ CrcLookup[tableIndex] ^ pData[byte];
-    }
+    // The initial value of the CRC is used as the seed.
+    uint64_t crc = 0;
+    uint8_t hash[sizeof(crc)];
+    MetroHash::MetroHash64::Hash(pData, numBytes, hash, CrcInitialValue);
+    memcpy(&crc, hash, sizeof(crc));
 
     return crc;
 }
@@ -942,18 +1976,16 @@ Result ShaderCache::ValidateAndLoadHeader(
         (memcmp(&pHeader->buildId.gfxIp, &buildId.gfxIp, sizeof(buildId.gfxIp)) == 0) &&
         (memcmp(&pHeader->buildId.hash, &buildId.hash, sizeof(buildId.hash)) == 0))
     {
-        // The header appears valid so copy the header data to the runtime cache
-        m_totalShaders  = pHeader->shaderCount;
-        m_shaderDataEnd = pHeader->shaderDataEnd;
+        // The header appears valid
     }
     else
     {
         result = Result::ErrorUnknown;
     }
 
-    // Make sure the shader data end value is correct. It's ok for there to be unused space at the end of the file, but
-    // if the shaderDataEnd is beyond the end of the file we have a problem.
-    if ((result == Result::Success) && (m_shaderDataEnd > dataSourceSize))
+    // Make sure the shader data end value is correct. It's ok for there to be unused space at the end of the blob, but
+    // if the shaderDataEnd is beyond the end of the blob we have a problem.
+    if ((result == Result::Success) && (pHeader->shaderDataEnd > dataSourceSize))
     {
         result = Result::ErrorUnknown;
     }
@@ -962,15 +1994,474 @@ Result ShaderCache::ValidateAndLoadHeader(
 }
 
 // =====================================================================================================================
-// Allocates memory from the shader cache's linear allocator. This function assumes that a write lock has been taken by
-// the calling function.
-void* ShaderCache::GetCacheSpace(
+// Allocates storage for shader data. The storage is freed once it is no longer referenced by a cache entry or by a user
+// of the data.
+std::shared_ptr<void> ShaderCache::GetCacheSpace(
     size_t numBytes)    // Allocation size in bytes
 {
-    auto p = new uint8_t[numBytes];
-    m_allocationList.push_back(std::pair<uint8_t*, size_t>(p, numBytes));
-    m_serializedSize += numBytes;
-    return p;
+    return std::shared_ptr<void>(new uint8_t[numBytes], std::default_delete<uint8_t[]>());
+}
+
+// =====================================================================================================================
+// Allocates storage for a shader and stores the shader data in it, after a shader header. The shader data is
+// compressed if compression is enabled, unless it is too small or does not shrink. Returns the storage, or nullptr if
+// it could not be allocated.
+std::shared_ptr<void> ShaderCache::PackShader(
+    uint64_t    hashKey,      // Hash key of the shader
+    const void* pBlob,        // [in] Shader data
+    size_t      shaderSize)   // Size of the shader data in bytes
+{
+    SmallVector<char, 0> compressedData;
+    if (m_compressShaders && (shaderSize >= MinCompressionSize))
+    {
+        StringRef shaderData(static_cast<const char*>(pBlob), shaderSize);
+        if (errorToBool(zlib::compress(shaderData, compressedData)) || (compressedData.size() >= shaderSize))
+        {
+            compressedData.clear();
+        }
+    }
+
+    const bool compressed = (compressedData.empty() == false);
+    const size_t dataSize = compressed ? compressedData.size() : shaderSize;
+    std::shared_ptr<void> storage = GetCacheSpace(sizeof(ShaderHeader) + dataSize);
+    auto*const pHeader = static_cast<ShaderHeader*>(storage.get());
+    if (pHeader != nullptr)
+    {
+        void*const pDataBlob = (pHeader + 1);
+        memcpy(pDataBlob, compressed ? compressedData.data() : pBlob, dataSize);
+
+        // Compute a CRC for the stored data (useful for detecting data corruption).
+        memset(pHeader, 0, sizeof(ShaderHeader));
+        pHeader->key     = hashKey;
+        pHeader->crc     = CalculateCrc(static_cast<uint8_t*>(pDataBlob), dataSize);
+        pHeader->size    = sizeof(ShaderHeader) + dataSize;
+        pHeader->flags   = compressed ? ShaderHeaderCompressed : 0;
+        pHeader->rawSize = shaderSize;
+    }
+
+    return storage;
+}
+
+// =====================================================================================================================
+// Decompresses the compressed shader data stored after the specified shader header. Returns true if the data was
+// decompressed to the expected size.
+bool ShaderCache::UnpackShader(
+    const ShaderHeader& header,       // [in] Shader header
+    const void*         pDataBlob,    // [in] Copy of the shader header, followed by the compressed shader data
+    void*               pShaderData)  // [out] Shader data, of header.rawSize bytes
+{
+    StringRef compressedData(static_cast<const char*>(VoidPtrInc(pDataBlob, sizeof(ShaderHeader))),
+                             (header.size - sizeof(ShaderHeader)));
+    size_t shaderSize = header.rawSize;
+    const bool failed = errorToBool(zlib::uncompress(compressedData, static_cast<char*>(pShaderData), shaderSize)) ||
+                        (shaderSize != header.rawSize);
+    if (failed)
+    {
+        LLPC_ERRS("Failed to decompress shader cache entry " << format_hex(header.key, 18) << "\n");
+    }
+
+    return (failed == false);
+}
+
+// =====================================================================================================================
+// Sets the shader data of a cache entry, replacing any data it held. This function assumes that the calling function
+// has exclusive access to the entry, either by holding the write lock of its shard or by owning it in the Compiling
+// state.
+void ShaderCache::SetShaderData(
+    ShaderIndex*          pIndex,     // [in,out] Shader cache entry
+    const ShaderHeader&   header,     // [in] Shader header
+    const void*           pDataBlob,  // [in] Copy of the shader header in the storage, followed by the shader data
+    std::shared_ptr<void> storage)    // Storage holding the shader header and data
+{
+    ReleaseShaderData(pIndex);
+    pIndex->header      = header;
+    pIndex->pDataBlob   = const_cast<void*>(pDataBlob);
+    pIndex->dataStorage = std::move(storage);
+    m_residentSize += header.size;
+}
+
+// =====================================================================================================================
+// Releases the shader data of a cache entry. The storage itself is freed once no other entry or user of the data
+// references it. This function makes the same assumption as SetShaderData.
+void ShaderCache::ReleaseShaderData(
+    ShaderIndex* pIndex)    // [in,out] Shader cache entry
+{
+    if (pIndex->pDataBlob != nullptr)
+    {
+        m_residentSize -= pIndex->header.size;
+    }
+    pIndex->header.size = 0;
+    pIndex->pDataBlob   = nullptr;
+    pIndex->dataStorage.reset();
+}
+
+// =====================================================================================================================
+// Checks the shader data held and the on-disk file against their budgets. Returns true if shaders must be evicted or
+// the file compacted, along with the size the shader data must be brought down to and whether to compact the file.
+bool ShaderCache::IsOverBudget(
+    size_t* pTargetSize,    // [out] Size the shader data held must be brought down to, SIZE_MAX if no shader need
+                            //       be evicted
+    bool*   pCompactFile)   // [out] Whether the on-disk file must be compacted
+{
+    std::lock_guard<sys::Mutex> lock(m_fileLock);
+    const size_t residentSize = m_residentSize;
+
+    // Evict an eighth more than needed, so that the eviction sweep, which locks the whole cache, is not needed again
+    // for each new shader.
+    *pTargetSize  = SIZE_MAX;
+    *pCompactFile = false;
+    if ((m_memoryBudget != 0) && (residentSize > m_memoryBudget))
+    {
+        *pTargetSize = m_memoryBudget - (m_memoryBudget / 8);
+    }
+
+    if (m_onDiskFile.IsOpen() && (m_compactionFailed == false))
+    {
+        const size_t headerSize = sizeof(ShaderCacheFileHeader);
+        const size_t fileDataSize = m_shaderDataEnd - headerSize;
+        if ((m_fileBudget != 0) && (m_shaderDataEnd > m_fileBudget))
+        {
+            // The compacted file holds the shaders held in memory, so evict enough of them to fit the file budget.
+            const size_t fileTarget = m_fileBudget - (m_fileBudget / 8);
+            *pTargetSize  = std::min(*pTargetSize, (fileTarget > headerSize) ? (fileTarget - headerSize) : 0);
+            *pCompactFile = true;
+        }
+        else if ((fileDataSize >= MinCompactionDataSize) && ((fileDataSize / 2) > residentSize))
+        {
+            // Most of the file is taken by shaders that have been evicted or replaced by an upgrade.
+            *pCompactFile = true;
+        }
+    }
+
+    return (*pTargetSize != SIZE_MAX) || (*pCompactFile);
+}
+
+// =====================================================================================================================
+// Evicts shaders and compacts the on-disk file as needed to bring them within their budgets. This is called without
+// any lock held, after shader data has been added to the cache.
+void ShaderCache::EnforceBudgets()
+{
+    size_t targetSize = 0;
+    bool compactFile = false;
+    if (IsOverBudget(&targetSize, &compactFile))
+    {
+        LockCacheMap(false);
+        ApplyBudgets();
+        UnlockCacheMap(false);
+    }
+}
+
+// =====================================================================================================================
+// Evicts shaders and compacts the on-disk file as needed to bring them within their budgets. This function assumes
+// that write locks on all shards have been taken by the calling function.
+void ShaderCache::ApplyBudgets()
+{
+    size_t targetSize = 0;
+    bool compactFile = false;
+    if (IsOverBudget(&targetSize, &compactFile))
+    {
+        EvictShaders(targetSize);
+
+        if (compactFile && (CompactCacheFile() != Result::Success))
+        {
+            // Do not try again for each new shader; the file is compacted when the cache is next loaded instead.
+            m_compactionFailed = true;
+        }
+    }
+}
+
+// =====================================================================================================================
+// Evicts shaders in CLOCK order until the size of the shader data held is at most the specified size. An evicted entry
+// is kept in the index map in the New state, so that handles to it stay valid, and its data is released once no longer
+// in use. This function assumes that write locks on all shards have been taken by the calling function.
+void ShaderCache::EvictShaders(
+    size_t targetSize)    // Size the shader data held must be brought down to
+{
+    // Sweep the shards in turn, each from the entry the last sweep of it stopped at. An entry that has been looked up
+    // since it was last passed gets another chance, and has its reference flag cleared; the first round of sweeps
+    // clears all flags, so at most two rounds are needed.
+    for (uint32_t sweep = 0; (sweep < 2 * ShaderIndexShardCount) && (m_residentSize > targetSize); ++sweep)
+    {
+        ShaderIndexShard* pShard = &m_shards[m_clockShard];
+        m_clockShard = (m_clockShard + 1) % ShaderIndexShardCount;
+
+        ShaderIndexMap& indexMap = pShard->indexMap;
+        if (indexMap.empty())
+        {
+            continue;
+        }
+
+        auto it = indexMap.find(pShard->clockHand);
+        if (it == indexMap.end())
+        {
+            it = indexMap.begin();
+        }
+
+        for (size_t visited = 0; (visited < indexMap.size()) && (m_residentSize > targetSize); ++visited)
+        {
+            ShaderIndex* pIndex = it->second;
+            if ((pIndex->state == ShaderEntryState::Ready) &&
+                (pIndex->pDataBlob != nullptr) &&
+                (pIndex->referenced.exchange(false, std::memory_order_relaxed) == false))
+            {
+                ++m_counters.evictionCount;
+                m_counters.evictedBytes += pIndex->header.size;
+                ReleaseShaderData(pIndex);
+                pIndex->state    = ShaderEntryState::New;
+                pIndex->upgraded = false;
+                pIndex->verified = true;
+            }
+
+            if (++it == indexMap.end())
+            {
+                it = indexMap.begin();
+            }
+        }
+        pShard->clockHand = it->first;
+    }
+}
+
+// =====================================================================================================================
+// Rewrites the on-disk file to hold only the shaders held in memory, dropping shaders that have been evicted or
+// replaced by an upgrade. This function assumes that write locks on all shards have been taken by the calling function.
+Result ShaderCache::CompactCacheFile()
+{
+    std::lock_guard<sys::Mutex> lock(m_fileLock);
+    assert(m_onDiskFile.IsOpen());
+
+    // The shaders are written to a new file, which then replaces the cache file. The cache file is not rewritten in
+    // place, as it may be mapped. The new file has a unique name, so that it is not shared with another process that
+    // compacts the same cache file.
+    SmallString<MaxFilePathLen> tempFilePath;
+    std::error_code errCode = sys::fs::createUniqueFile(Twine(m_fileFullPath) + ".%%%%%%%%.tmp", tempFilePath);
+    Result result = errCode ? Result::ErrorUnknown : Result::Success;
+
+    File tempFile;
+    if (result == Result::Success)
+    {
+        result = tempFile.Open(tempFilePath.c_str(), (FileAccessWrite | FileAccessBinary));
+    }
+
+    ShaderCacheFileHeader header = {};
+    GetFileHeader(&header);
+
+    if (result == Result::Success)
+    {
+        result = tempFile.Write(&header, header.headerSize);
+    }
+
+    ShaderCacheFileIndex fileIndex;
+    uint64_t dataEnd = header.headerSize;
+    for (auto& shard : m_shards)
+    {
+        for (auto it : shard.indexMap)
+        {
+            const ShaderIndex* pIndex = it.second;
+            if ((result == Result::Success) &&
+                (pIndex->state == ShaderEntryState::Ready) &&
+                (pIndex->pDataBlob != nullptr))
+            {
+                result = WriteRecord(&tempFile,
+                                     dataEnd,
+                                     ShaderCacheRecordType::Shader,
+                                     pIndex->pDataBlob,
+                                     pIndex->header.size);
+
+                ShaderCacheIndexEntry& entry = fileIndex[pIndex->header.key];
+                entry.header = pIndex->header;
+                entry.offset = dataEnd;
+                dataEnd += sizeof(ShaderCacheRecordHeader) + pIndex->header.size;
+            }
+        }
+    }
+
+    if (result == Result::Success)
+    {
+        // End the file with an index record, and write the header again to locate it.
+        size_t recordSize = 0;
+        result = WriteIndexRecord(&tempFile, dataEnd, fileIndex, &recordSize);
+        header.lastIndexOffset = dataEnd;
+        dataEnd += recordSize;
+    }
+    if (result == Result::Success)
+    {
+        tempFile.Rewind();
+        result = tempFile.Write(&header, header.headerSize);
+    }
+    if (result == Result::Success)
+    {
+        result = tempFile.Flush();
+    }
+    tempFile.Close();
+
+    if (result == Result::Success)
+    {
+        // A file that is open or mapped cannot be replaced on some platforms, so close the cache file, and move the
+        // shaders held in its mapping to storage of their own, before the rename. The mapping is then released once
+        // no user of the shader data retrieved from it is left.
+        m_onDiskFile.Close();
+        if (m_mapCacheFile)
+        {
+            MoveShaderData(nullptr, nullptr);
+        }
+
+        if (sys::fs::rename(tempFilePath, m_fileFullPath))
+        {
+            result = Result::ErrorUnknown;
+        }
+        else
+        {
+            m_fileIndex.swap(fileIndex);
+            m_shaderDataEnd     = dataEnd;
+            m_recordsSinceIndex = 0;
+        }
+
+        // Reopen the cache file, whether or not it was replaced. If that fails, new shaders are no longer written to
+        // the file.
+        Result openResult = m_onDiskFile.Open(m_fileFullPath, (FileAccessReadUpdate | FileAccessBinary));
+
+        // Map the compacted file, and move the shaders back to the records in it.
+        if ((result == Result::Success) && (openResult == Result::Success) && m_mapCacheFile)
+        {
+            auto mappedFile = MemoryBuffer::getFileSlice(m_fileFullPath, dataEnd, 0);
+            if (mappedFile)
+            {
+                const uint8_t* pFileData = reinterpret_cast<const uint8_t*>((*mappedFile)->getBufferStart());
+                MoveShaderData(std::shared_ptr<MemoryBuffer>(std::move(*mappedFile)), pFileData);
+            }
+        }
+    }
+
+    if (result != Result::Success)
+    {
+        LLPC_ERRS("Failed to compact shader cache file " << m_fileFullPath << "\n");
+        if (tempFilePath.empty() == false)
+        {
+            sys::fs::remove(tempFilePath);
+        }
+    }
+
+    return result;
+}
+
+// =====================================================================================================================
+// Moves the data of the shaders held in memory either to storage of their own, if pFileData is nullptr, or to their
+// records in the on-disk file held in the specified storage, as located by the file index. This function assumes that
+// write locks on all shards and the file lock have been taken by the calling function.
+void ShaderCache::MoveShaderData(
+    const std::shared_ptr<void>& storage,     // [in] Storage holding the on-disk file, or nullptr
+    const uint8_t*               pFileData)   // [in] Data of the on-disk file, or nullptr
+{
+    for (auto& shard : m_shards)
+    {
+        for (auto it : shard.indexMap)
+        {
+            ShaderIndex* pIndex = it.second;
+            if ((pIndex->state != ShaderEntryState::Ready) || (pIndex->pDataBlob == nullptr))
+            {
+                continue;
+            }
+
+            if (pFileData == nullptr)
+            {
+                std::shared_ptr<void> dataStorage = GetCacheSpace(pIndex->header.size);
+                memcpy(dataStorage.get(), pIndex->pDataBlob, pIndex->header.size);
+                pIndex->pDataBlob   = dataStorage.get();
+                pIndex->dataStorage = std::move(dataStorage);
+            }
+            else
+            {
+                auto entry = m_fileIndex.find(pIndex->header.key);
+                if (entry != m_fileIndex.end())
+                {
+                    pIndex->pDataBlob   = const_cast<uint8_t*>(pFileData) + entry->second.offset +
+                                          sizeof(ShaderCacheRecordHeader);
+                    pIndex->dataStorage = storage;
+                }
+            }
+        }
+    }
+}
+
+// =====================================================================================================================
+// Gets statistics of the shader cache.
+void ShaderCache::GetStats(
+    ShaderCacheStats* pStats)   // [out] Shader cache statistics
+{
+    *pStats = {};
+    pStats->lookupCount       = m_counters.lookupCount;
+    pStats->hitCount          = m_counters.hitCount;
+    pStats->missCount         = m_counters.missCount;
+    pStats->waitCount         = m_counters.waitCount;
+    pStats->sharedDirHitCount = m_counters.sharedDirHitCount;
+    pStats->externalHitCount  = m_counters.externalHitCount;
+    pStats->externalMissCount = m_counters.externalMissCount;
+    pStats->insertCount       = m_counters.insertCount;
+    pStats->insertBytes       = m_counters.insertBytes;
+    pStats->upgradeCount      = m_counters.upgradeCount;
+    pStats->evictionCount     = m_counters.evictionCount;
+    pStats->evictedBytes      = m_counters.evictedBytes;
+    pStats->residentBytes     = m_residentSize;
+    m_counters.waitLatency.Get(&pStats->waitLatency);
+    m_counters.externalGetLatency.Get(&pStats->externalGetLatency);
+    m_counters.externalStoreLatency.Get(&pStats->externalStoreLatency);
+
+    std::lock_guard<sys::Mutex> lock(m_fileLock);
+    if (m_onDiskFile.IsOpen())
+    {
+        pStats->fileBytes = m_shaderDataEnd;
+    }
+}
+
+// =====================================================================================================================
+// Rewrites the on-disk file to hold only the shaders held in memory, e.g. before the file is shipped. Does nothing if
+// there is no on-disk file, or it is only read.
+Result ShaderCache::Compact()
+{
+    Result result = Result::Success;
+
+    LockCacheMap(false);
+    if (m_onDiskFile.IsOpen() && (m_fileReadOnly == false))
+    {
+        result = CompactCacheFile();
+    }
+    UnlockCacheMap(false);
+
+    return result;
+}
+
+// =====================================================================================================================
+// Records the latency of an operation that started at the specified time and has just ended.
+void ShaderCacheLatencyCounter::Record(
+    std::chrono::steady_clock::time_point startTime)    // Start time of the operation
+{
+    const auto latency = std::chrono::steady_clock::now() - startTime;
+    const uint64_t latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    const uint32_t bucket = (latencyUs == 0) ? 0 : std::min(Log2_64(latencyUs) + 1, ShaderCacheLatencyBucketCount - 1);
+
+    ++m_count;
+    m_totalUs += latencyUs;
+    ++m_buckets[bucket];
+
+    uint64_t maxUs = m_maxUs;
+    while ((latencyUs > maxUs) && (m_maxUs.compare_exchange_weak(maxUs, latencyUs) == false))
+    {
+    }
+}
+
+// =====================================================================================================================
+// Gets the latency histogram.
+void ShaderCacheLatencyCounter::Get(
+    ShaderCacheLatencyHistogram* pHistogram    // [out] Latency histogram
+    ) const
+{
+    pHistogram->count   = m_count;
+    pHistogram->totalUs = m_totalUs;
+    pHistogram->maxUs   = m_maxUs;
+    for (uint32_t i = 0; i < ShaderCacheLatencyBucketCount; ++i)
+    {
+        pHistogram->buckets[i] = m_buckets[i];
+    }
 }
 
 // =====================================================================================================================
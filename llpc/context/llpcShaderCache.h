@@ -30,11 +30,15 @@
  */
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include "llvm/Support/Mutex.h"
+#include "llvm/Support/RWMutex.h"
 
 #include "llpc.h"
 #include "llpcFile.h"
@@ -44,12 +48,21 @@
 namespace Llpc
 {
 
+// Enumerates the flags of the shader data stored in the cache.
+enum ShaderHeaderFlags : uint32_t
+{
+    ShaderHeaderCompressed = 0x1,    // The shader data is compressed with zlib
+};
+
 // Header data that is stored with each shader in the cache.
 struct ShaderHeader
 {
-    uint64_t    key;    // Compacted hash key used to identify shaders
-    uint64_t    crc;    // CRC of the shader cache entry, used to detect data corruption.
-    size_t      size;   // Total size of the shader data in the storage file
+    uint64_t    key;      // Compacted hash key used to identify shaders
+    uint64_t    crc;      // CRC of the shader cache entry, used to detect data corruption.
+    size_t      size;     // Total size of the shader data in the storage file
+    uint32_t    flags;    // Flags of the shader data, from ShaderHeaderFlags
+    uint32_t    reserved; // Reserved, must be 0
+    size_t      rawSize;  // Size of the shader data before it was compressed
 };
 
 // Enum defining the states a shader cache entry can be in
@@ -72,17 +85,86 @@ enum ShaderCacheMode
 };
 
 // Stores data in the hash map of cached shaders and helps correlated a shader in the hash to a location in the
-// cache's linear allocators where the shader is actually stored.
+// cache's storage where the shader is actually stored.
 struct ShaderIndex
 {
     ShaderHeader                header;      // Shader header data (key, crc, size)
     volatile ShaderEntryState   state;       // Shader entry state
+    bool                        upgraded;    // Whether the shader data was replaced with that of a fully optimized
+                                             //  build, after the entry was populated by a fast build
     void*                       pDataBlob;   // Serialized data blob representing a cached RelocatableShader object.
+    std::shared_ptr<void>       dataStorage; // Storage holding the shader data, which may also hold the data of other
+                                             //  entries, and is kept alive by users of the data after eviction
+    bool                        verified = true; // Whether the CRC of the shader data has been checked
+    std::atomic<bool>           referenced{ false }; // Whether the shader has been looked up since the last eviction
+                                                     //  sweep passed it
+    uint32_t                    waiterCount = 0; // Count of threads waiting for the entry to leave the Compiling state
+
+    // Condition variable signalled when the entry leaves the Compiling state, present only while there are waiters
+    std::condition_variable_any* pReadyCond = nullptr;
 };
 
 // The key in hash map is a 64-bit compacted Shader Hash
 typedef std::unordered_map<uint64_t, ShaderIndex*> ShaderIndexMap;
 
+// Count of shards of the shader index map, must be a power of 2
+static constexpr uint32_t ShaderIndexShardCount = 16;
+
+// Represents one shard of the shader index map. A shader belongs to the shard selected by the low bits of its hash key,
+// and each shard has its own reader/writer lock, so that accesses to different shaders do not contend.
+struct ShaderIndexShard
+{
+    llvm::sys::RWMutex  lock;       // Reader/writer lock for the index map of this shard and its entries
+    ShaderIndexMap      indexMap;   // Map of shader index data of this shard
+    uint64_t            clockHand = 0; // Key of the entry the next eviction sweep of this shard starts from
+};
+
+// Represents the latency histogram of a shader cache operation, which is updated concurrently.
+class ShaderCacheLatencyCounter
+{
+public:
+    void Record(std::chrono::steady_clock::time_point startTime);
+    void Get(ShaderCacheLatencyHistogram* pHistogram) const;
+
+private:
+    std::atomic<uint64_t>   m_count{ 0 };                                // Count of operations
+    std::atomic<uint64_t>   m_totalUs{ 0 };                              // Total latency in microseconds
+    std::atomic<uint64_t>   m_maxUs{ 0 };                                // Maximum latency in microseconds
+    std::atomic<uint64_t>   m_buckets[ShaderCacheLatencyBucketCount] = {}; // Count of operations in each bucket
+};
+
+// Represents the counters of the statistics of a shader cache, which are updated concurrently.
+struct ShaderCacheCounters
+{
+    std::atomic<uint64_t>   lookupCount{ 0 };
+    std::atomic<uint64_t>   hitCount{ 0 };
+    std::atomic<uint64_t>   missCount{ 0 };
+    std::atomic<uint64_t>   waitCount{ 0 };
+    std::atomic<uint64_t>   sharedDirHitCount{ 0 };
+    std::atomic<uint64_t>   externalHitCount{ 0 };
+    std::atomic<uint64_t>   externalMissCount{ 0 };
+    std::atomic<uint64_t>   insertCount{ 0 };
+    std::atomic<uint64_t>   insertBytes{ 0 };
+    std::atomic<uint64_t>   upgradeCount{ 0 };
+    std::atomic<uint64_t>   evictionCount{ 0 };
+    std::atomic<uint64_t>   evictedBytes{ 0 };
+
+    ShaderCacheLatencyCounter   waitLatency;
+    ShaderCacheLatencyCounter   externalGetLatency;
+    ShaderCacheLatencyCounter   externalStoreLatency;
+};
+
+class ShaderCache;
+
+// Represents a store to the client's external cache that is in flight. It holds the storage of the shader data until
+// the client reports that the store has completed.
+struct ShaderCachePendingStore
+{
+    ShaderCache*                            pCache;     // Shader cache the store was started by
+    std::shared_ptr<void>                   storage;    // Storage holding the shader header and data
+    std::chrono::steady_clock::time_point   startTime;  // Time the store was started, for the latency statistics
+};
+
 // Specifies auxiliary info necessary to create a shader cache object.
 struct ShaderCacheAuxCreateInfo
 {
@@ -91,6 +173,14 @@ struct ShaderCacheAuxCreateInfo
     MetroHash::Hash        hash;               // Hash code of compilation options
     const char*            pCacheFilePath;     // root directory of cache file
     const char*            pExecutableName;    // Name of executable file
+    bool                   mapCacheFile;       // Whether to map the on-disk cache file into memory instead of reading
+                                               //  it, checking the CRC of each shader on its first use
+    size_t                 memoryBudget;       // Maximum size in bytes of the shader data held, 0 for no limit
+    size_t                 fileBudget;         // Maximum size in bytes of the on-disk cache file, 0 for no limit
+    bool                   compressShaders;    // Whether to compress the shader data stored in the cache
+    bool                   shareCacheDir;      // Whether to share the on-disk cache with other processes, storing each
+                                               //  shader in its own file of a directory shared by all executables,
+                                               //  which is not bounded by fileBudget
 };
 
 // Length of date field used in BuildUniqueId
@@ -121,6 +211,61 @@ struct ShaderCacheSerializedHeader
     size_t              shaderDataEnd; // Offset to the end of shader data
 };
 
+// Magic number identifying an on-disk shader cache file ("LLPCSHDC")
+static constexpr uint64_t ShaderCacheFileMagic = 0x4344485343504C4C;
+
+// Version of the on-disk shader cache file format
+static constexpr uint32_t ShaderCacheFileVersion = 4;
+
+// This the header of an on-disk shader cache file. The rest of the file is an append-only log of records, so the header
+// is written when the file is created and never rewritten, apart from the lastIndexOffset hint.
+struct ShaderCacheFileHeader
+{
+    uint64_t            magic;           // Magic number, must be ShaderCacheFileMagic
+    uint32_t            version;         // Version of the file format, must be ShaderCacheFileVersion
+    uint32_t            headerSize;      // Size of the header structure
+    BuildUniqueId       buildId;         // Build time/date of the LLPC version that created the cache file
+    uint64_t            lastIndexOffset; // Offset of the last index record written, or 0; only a hint, as it is
+                                         //  validated before use
+};
+
+// Enumerates the types of records in an on-disk shader cache file.
+enum class ShaderCacheRecordType : uint32_t
+{
+    Shader = 1,     // A shader: a ShaderHeader followed by the shader data
+    Index  = 2,     // An index of all shaders in the records before it: ShaderCacheIndexEntry array followed by a
+                    //  ShaderCacheIndexTrailer
+};
+
+// Header of each record in an on-disk shader cache file. A record is self-describing, so the file can be scanned and
+// recovered up to the last valid record without any other data.
+struct ShaderCacheRecordHeader
+{
+    ShaderCacheRecordType type;      // Type of the record
+    uint32_t              reserved;  // Reserved, must be 0
+    uint64_t              size;      // Size in bytes of the payload following this header
+    uint64_t              check;     // CRC of the fields above, used to detect a torn or corrupted record
+};
+
+// Entry of an index record, locating the latest shader record for one shader.
+struct ShaderCacheIndexEntry
+{
+    ShaderHeader        header;      // Header of the shader
+    uint64_t            offset;      // File offset of the shader record
+};
+
+// Trailer ending the payload of an index record. When an index record is the last record, as it is after the file has
+// been closed cleanly, the trailer is at the end of the file, so the index is found without scanning any record.
+struct ShaderCacheIndexTrailer
+{
+    uint64_t            recordOffset; // File offset of the index record
+    uint64_t            entryCrc;     // CRC of the index entries
+    uint64_t            magic;        // Magic number, must be ShaderCacheFileMagic
+};
+
+// Map from the compacted hash key of a shader to the location of its latest record in the on-disk file
+typedef std::unordered_map<uint64_t, ShaderCacheIndexEntry> ShaderCacheFileIndex;
+
 constexpr uint32_t MaxFilePathLen = 256;
 
 typedef void* CacheEntryHandle;
@@ -141,6 +286,10 @@ public:
 
     virtual Result Merge(uint32_t srcCacheCount, const IShaderCache** ppSrcCaches);
 
+    virtual void GetStats(ShaderCacheStats* pStats);
+
+    Result Compact();
+
     ShaderEntryState FindShader(MetroHash::Hash   hash,
                                 bool              allocateOnMiss,
                                 CacheEntryHandle* phEntry);
@@ -151,9 +300,16 @@ public:
 
     void ResetShader(CacheEntryHandle         hEntry);
 
-    Result RetrieveShader(CacheEntryHandle   hEntry,
-                          const void**       ppBlob,
-                          size_t*            pSize);
+    void UpgradeShader(MetroHash::Hash hash,
+                       const void*     pBlob,
+                       size_t          size);
+
+    bool IsShaderUpgraded(CacheEntryHandle hEntry);
+
+    Result RetrieveShader(CacheEntryHandle       hEntry,
+                          const void**           ppBlob,
+                          size_t*                pSize,
+                          std::shared_ptr<void>* pStorage = nullptr);
 
     bool IsCompatible(const ShaderCacheCreateInfo* pCreateInfo, const ShaderCacheAuxCreateInfo* pAuxCreateInfo);
 
@@ -167,53 +323,135 @@ private:
                          bool*        pCacheFileExists);
     Result ValidateAndLoadHeader(const ShaderCacheSerializedHeader* pHeader, size_t dataSourceSize);
     Result LoadCacheFromBlob(const void* pInitialData, size_t initialDataSize);
-    Result PopulateIndexMap(void* pDataStart, size_t dataSize);
+    Result PopulateIndexMap(const std::shared_ptr<void>& storage,
+                            void*                        pDataStart,
+                            size_t                       dataSize,
+                            size_t                       shaderCount,
+                            bool                         verifyCrc);
     uint64_t CalculateCrc(const uint8_t* pData, size_t numBytes);
 
     Result LoadCacheFromFile();
+    bool IsValidFileHeader(const ShaderCacheFileHeader* pHeader, size_t fileSize);
+    void GetFileHeader(ShaderCacheFileHeader* pHeader);
+    uint64_t LoadIndexRecord(const std::shared_ptr<void>& storage,
+                             const uint8_t*               pFileData,
+                             size_t                       fileSize,
+                             uint64_t                     offset,
+                             bool                         verifyCrc);
+    uint64_t ScanRecords(const std::shared_ptr<void>& storage,
+                         const uint8_t*               pFileData,
+                         size_t                       fileSize,
+                         uint64_t                     offset,
+                         bool                         verifyCrc);
+    void AddShaderFromFile(const std::shared_ptr<void>& storage,
+                           const ShaderHeader&          header,
+                           const ShaderHeader*          pDataBlob,
+                           uint64_t                     recordOffset,
+                           bool                         verified);
+    uint64_t CalculateRecordCheck(const ShaderCacheRecordHeader* pRecord);
+    Result WriteRecord(File*                 pFile,
+                       uint64_t              offset,
+                       ShaderCacheRecordType type,
+                       const void*           pPayload,
+                       size_t                payloadSize);
+    Result WriteIndexRecord(File* pFile, uint64_t offset, const ShaderCacheFileIndex& fileIndex, size_t* pRecordSize);
     void ResetCacheFile();
-    void AddShaderToFile(const ShaderIndex* pIndex);
-
-    void* GetCacheSpace(size_t numBytes);
-
-    // Lock cache map
-    void LockCacheMap(bool readOnly) { m_lock.lock(); }
-
-    // Unlock cache map
-    void UnlockCacheMap(bool readOnly) { m_lock.unlock(); }
+    void AddShaderToFile(const ShaderHeader* pDataBlob);
+    void CloseCacheFile();
+    Result CompactCacheFile();
+    void MoveShaderData(const std::shared_ptr<void>& storage, const uint8_t* pFileData);
+
+    Result BuildSharedDirName(const char* pCacheFilePath, GfxIpVersion gfxIp);
+    void GetSharedFileName(uint64_t hashKey, char* pFileName);
+    bool LoadShaderFromSharedDir(ShaderIndex* pIndex);
+    void StoreShaderToSharedDir(const ShaderHeader* pDataBlob);
+
+    bool LoadShaderFromExternalCache(ShaderIndex* pIndex);
+    Result GetExternalValue(uint64_t hashKey, std::shared_ptr<void>* pStorage, size_t* pDataSize);
+    void VerifyShader(ShaderIndex* pIndex);
+    void WakeWaiters(ShaderIndex* pIndex);
+    void StoreShader(const ShaderHeader* pDataBlob, const std::shared_ptr<void>& storage);
+    void StoreShaderToExternalCache(const ShaderHeader* pDataBlob, const std::shared_ptr<void>& storage);
+    static void ExternalStoreDone(void* pStoreData, Result result);
+    void WaitForPendingStores();
+
+    std::shared_ptr<void> GetCacheSpace(size_t numBytes);
+    std::shared_ptr<void> PackShader(uint64_t hashKey, const void* pBlob, size_t shaderSize);
+    bool UnpackShader(const ShaderHeader& header, const void* pDataBlob, void* pShaderData);
+    void SetShaderData(ShaderIndex*          pIndex,
+                       const ShaderHeader&   header,
+                       const void*           pDataBlob,
+                       std::shared_ptr<void> storage);
+    void ReleaseShaderData(ShaderIndex* pIndex);
+
+    bool IsOverBudget(size_t* pTargetSize, bool* pCompactFile);
+    void EnforceBudgets();
+    void ApplyBudgets();
+    void EvictShaders(size_t targetSize);
+
+    // Gets the shard of the shader index map that the specified hash key belongs to
+    ShaderIndexShard* GetShard(uint64_t hashKey) { return &m_shards[hashKey & (ShaderIndexShardCount - 1)]; }
+
+    void LockCacheMap(bool readOnly);
+    void UnlockCacheMap(bool readOnly);
 
     bool UseExternalCache()
-        { return ((m_pfnGetValueFunc != nullptr) && (m_pfnStoreValueFunc != nullptr)); }
+    {
+        return (((m_pfnGetValueFunc != nullptr) || (m_pfnGetValueV2Func != nullptr)) &&
+                ((m_pfnStoreValueFunc != nullptr) || (m_pfnStoreValueAsyncFunc != nullptr)) &&
+                (m_externalCacheUnavailable == false));
+    }
 
     void ResetRuntimeCache();
     void GetBuildTime(BuildUniqueId *pBuildId);
 
     // -----------------------------------------------------------------------------------------------------------------
 
-    llvm::sys::Mutex  m_lock;       // Read/Write lock for access to the shader cache hash map
-    File              m_onDiskFile; // File for on-disk storage of the cache
+    llvm::sys::Mutex  m_fileLock;    // Lock for the on-disk file, its index and the end of its valid records
+    File              m_onDiskFile;  // File for on-disk storage of the cache
     bool              m_disableCache; // Whether disable cache completely
-
-    // Map of shader index data which detail the hash, crc, size and CPU memory location for each shader
+    bool              m_mapCacheFile; // Whether to map the on-disk file into memory instead of reading it
+    size_t            m_memoryBudget; // Maximum size of the shader data held, 0 for no limit
+    size_t            m_fileBudget;   // Maximum size of the on-disk file, 0 for no limit
+    std::atomic<bool> m_compactionFailed; // Whether compaction of the on-disk file failed, so is not tried again
+    bool              m_compressShaders; // Whether to compress the shader data stored in the cache
+    bool              m_sharedDir;    // Whether the on-disk cache is a directory shared with other processes
+    bool              m_sharedDirReadOnly; // Whether shaders are only read from the shared directory
+    bool              m_fileReadOnly; // Whether the on-disk file is only read, so is never written or truncated
+
+    // Sharded map of shader index data which detail the hash, crc, size and CPU memory location for each shader
     // in the cache.
-    ShaderIndexMap  m_shaderIndexMap;
+    ShaderIndexShard  m_shards[ShaderIndexShardCount];
+    uint32_t          m_clockShard;   // Shard the next eviction sweep starts from
 
-    // In memory copy of the shaderDataEnd and totalShaders stored in the on-disk file. We keep a copy to avoid having
-    //  to do a read/modify/write of the value when adding a new shader.
-    size_t          m_shaderDataEnd;
-    size_t          m_totalShaders;
+    // State of the on-disk file: the offset of the end of its valid records, where the next record is appended, the
+    // location of the latest record of each shader in it, and the count of shader records since the last index record.
+    uint64_t             m_shaderDataEnd;
+    ShaderCacheFileIndex m_fileIndex;
+    size_t               m_recordsSinceIndex;
 
     char            m_fileFullPath[MaxFilePathLen]; // Full path/filename of the shader cache on-disk file
+    char            m_sharedDirPath[MaxFilePathLen]; // Full path of the shared shader cache directory
 
-    std::list<std::pair<uint8_t*, size_t> > m_allocationList;  // Memory allcoated by GetCacheSpace
-    uint32_t                 m_serializedSize;      // Serialized byte size of whole shader cache
-    std::mutex               m_conditionMutex;      // Mutex that will be used with the condition variable
-    std::condition_variable  m_conditionVariable;   // Condition variable that will be used to wait compile finish
+    std::atomic<size_t>      m_residentSize;        // Size of the shader data referenced by the index map
     const void*              m_pClientData;         // Client data that will be used by function GetValue and StoreValue
     ShaderCacheGetValue      m_pfnGetValueFunc;     // GetValue function used to query an external cache for shader data
     ShaderCacheStoreValue    m_pfnStoreValueFunc;   // StoreValue function used to store shader data in an external cache
+    ShaderCacheGetValueV2    m_pfnGetValueV2Func;   // GetValue function used to query an external cache in a single
+                                                    //  call, handing back a lease on a buffer owned by the client
+    ShaderCacheReleaseValue  m_pfnReleaseValueFunc; // Function used to release a lease handed back by GetValueV2
+    ShaderCacheStoreValueAsync m_pfnStoreValueAsyncFunc; // StoreValue function used to store shader data in an external
+                                                         //  cache without waiting for it
+    std::atomic<bool>        m_externalCacheUnavailable; // Whether the external cache reported to be unavailable
     GfxIpVersion             m_gfxIp;               // Graphics IP version info
     MetroHash::Hash          m_hash;                // Hash code of compilation options
+    ShaderCacheCounters      m_counters;            // Counters of the statistics of the cache
+
+    // Count of stores to the external cache that are in flight, and the lock and condition variable used to wait for
+    // them to complete before the cache is destroyed.
+    std::mutex               m_pendingStoreLock;
+    std::condition_variable  m_pendingStoreCond;
+    uint32_t                 m_pendingStoreCount;
 };
 
 } // Llpc
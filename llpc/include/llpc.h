@@ -130,12 +130,88 @@ struct ComputePipelineBuildOut
     BinaryData          pipelineBin;        ///< Output pipeline binary data
 };
 
+/// Represents statistics of the pool of LLPC contexts that is shared by all compiler instances.
+struct ContextPoolStats
+{
+    uint64_t    acquireCount;       ///< Count of contexts acquired for compiles
+    uint64_t    hitCount;           ///< Count of acquires served by an idle context in the pool
+    uint64_t    createCount;        ///< Count of contexts created
+    uint64_t    waitCount;          ///< Count of acquires that waited for a release because the pool was at its limit
+    uint64_t    overflowCount;      ///< Count of transient contexts created beyond the pool limit
+    uint64_t    destroyCount;       ///< Count of contexts destroyed because of the pool limits or trimming
+    uint32_t    liveCount;          ///< Count of contexts currently alive, idle or in use
+    uint32_t    idleCount;          ///< Count of contexts currently idle in the pool
+};
+
+/// Count of buckets of a ShaderCacheLatencyHistogram. Bucket 0 counts latencies under 1 microsecond, bucket i counts
+/// latencies from 2^(i-1) up to 2^i microseconds, and the last bucket also counts all longer latencies.
+static const uint32_t ShaderCacheLatencyBucketCount = 24;
+
+/// Represents a histogram of the latencies of a shader cache operation.
+struct ShaderCacheLatencyHistogram
+{
+    uint64_t    count;                                  ///< Count of operations
+    uint64_t    totalUs;                                ///< Total latency of the operations, in microseconds
+    uint64_t    maxUs;                                  ///< Maximum latency of an operation, in microseconds
+    uint64_t    buckets[ShaderCacheLatencyBucketCount]; ///< Count of operations in each latency bucket
+};
+
+/// Represents statistics of a shader cache, including its use of the client's external cache, if any.
+struct ShaderCacheStats
+{
+    uint64_t    lookupCount;        ///< Count of shader lookups
+    uint64_t    hitCount;           ///< Count of lookups that found a ready shader, in memory or from a backing store
+    uint64_t    missCount;          ///< Count of lookups that returned an entry for the caller to compile
+    uint64_t    waitCount;          ///< Count of lookups that waited for another thread compiling the same shader
+    uint64_t    sharedDirHitCount;  ///< Count of lookups served from the shader cache directory shared by processes
+    uint64_t    externalHitCount;   ///< Count of lookups served from the external cache
+    uint64_t    externalMissCount;  ///< Count of queries of the external cache that did not find the shader
+    uint64_t    insertCount;        ///< Count of shaders inserted
+    uint64_t    insertBytes;        ///< Size of the shader data inserted, as stored (after any compression)
+    uint64_t    upgradeCount;       ///< Count of shaders replaced with a fully optimized build
+    uint64_t    evictionCount;      ///< Count of shaders evicted to keep within the memory budget
+    uint64_t    evictedBytes;       ///< Size of the shader data evicted
+    uint64_t    residentBytes;      ///< Size of the shader data currently held in memory
+    uint64_t    fileBytes;          ///< Size of the on-disk cache file, or 0 if there is none
+
+    ShaderCacheLatencyHistogram waitLatency;          ///< Time spent waiting for shaders compiled by other threads
+    ShaderCacheLatencyHistogram externalGetLatency;   ///< Latency of the external cache's GetValue callback
+    ShaderCacheLatencyHistogram externalStoreLatency; ///< Latency of the external cache's StoreValue callback
+};
+
 /// Defines callback function used to lookup shader cache info in an external cache
 typedef Result (*ShaderCacheGetValue)(const void* pClientData, uint64_t hash, void* pValue, size_t* pValueLen);
 
 /// Defines callback function used to store shader cache info in an external cache
 typedef Result (*ShaderCacheStoreValue)(const void* pClientData, uint64_t hash, const void* pValue, size_t valueLen);
 
+/// Defines callback function used to lookup shader cache info in an external cache in a single call. On success, the
+/// client hands back the cached data in a buffer that it owns, aligned to 8 bytes, together with a lease on the buffer.
+/// The buffer must remain valid until the lease is released through ShaderCacheReleaseValue, which may happen after
+/// the shader cache has been destroyed, as pipeline binaries may still reference the data.
+typedef Result (*ShaderCacheGetValueV2)(const void*  pClientData,
+                                        uint64_t     hash,
+                                        const void** ppValue,
+                                        size_t*      pValueLen,
+                                        void**       ppLease);
+
+/// Defines callback function used to release a lease on a buffer handed back by ShaderCacheGetValueV2
+typedef void (*ShaderCacheReleaseValue)(const void* pClientData, void* pLease);
+
+/// Defines callback function used to report the completion of a store started by ShaderCacheStoreValueAsync
+typedef void (*ShaderCacheStoreDone)(void* pStoreData, Result result);
+
+/// Defines callback function used to store shader cache info in an external cache asynchronously. Returns Success if
+/// the store was started, in which case the client calls pfnStoreDone with pStoreData exactly once when the store
+/// completes, possibly before returning; the data remains valid until then. Any other result means the store was not
+/// started, and pfnStoreDone is not called.
+typedef Result (*ShaderCacheStoreValueAsync)(const void*          pClientData,
+                                             uint64_t             hash,
+                                             const void*          pValue,
+                                             size_t               valueLen,
+                                             ShaderCacheStoreDone pfnStoreDone,
+                                             void*                pStoreData);
+
 /// Specifies all information necessary to create a shader cache object.
 struct ShaderCacheCreateInfo
 {
@@ -151,6 +227,87 @@ struct ShaderCacheCreateInfo
     const void*            pClientData;
     ShaderCacheGetValue    pfnGetValueFunc;    ///< [Optional] Function to lookup shader cache data in an external cache
     ShaderCacheStoreValue  pfnStoreValueFunc;  ///< [Optional] Function to store shader cache data in an external cache
+
+    // [Optional] Functions of the second version of the external cache protocol. Each one is used instead of its first
+    // version counterpart if it is given. The lookup takes a single round trip and uses the client's buffer in place,
+    // and the store does not wait for the external cache.
+    ShaderCacheGetValueV2      pfnGetValueV2Func;      ///< [Optional] Function to lookup shader cache data in a single
+                                                       ///  call, requires pfnReleaseValueFunc (shader cache creation
+                                                       ///  fails with ErrorInvalidValue without it)
+    ShaderCacheReleaseValue    pfnReleaseValueFunc;    ///< [Optional] Function to release a lease on looked up data
+    ShaderCacheStoreValueAsync pfnStoreValueAsyncFunc; ///< [Optional] Function to store shader cache data
+                                                       ///  asynchronously
+};
+
+/// Enumerates priorities of asynchronous pipeline builds. A pending build of higher priority is always started before
+/// a pending build of lower priority.
+enum class PipelineBuildPriority : uint32_t
+{
+    Background = 0,     ///< Background build, such as prefetching a pipeline that may be needed later
+    Normal,             ///< Normal build
+    Urgent,             ///< Urgent build, such as a pipeline that is needed for the next draw
+};
+
+// =====================================================================================================================
+/// Represents the interface of an asynchronous pipeline build job, as returned by ICompiler::BuildGraphicsPipelineAsync
+/// and ICompiler::BuildComputePipelineAsync. The output of the build is delivered through pfnOutputAlloc and the
+/// pipeline build out structure, in the same way as for a synchronous build.
+class IPipelineBuildJob
+{
+public:
+    /// Polls the state of the job.
+    ///
+    /// @returns Delayed if the build has not finished yet, ErrorUnavailable if it was cancelled. Otherwise, the
+    ///          result of the build is returned.
+    virtual Result Poll() = 0;
+
+    /// Waits for the job to finish. If the build has not been started by a worker thread yet, it is run on the
+    /// calling thread instead.
+    ///
+    /// @returns ErrorUnavailable if the build was cancelled. Otherwise, the result of the build is returned.
+    virtual Result Wait() = 0;
+
+    /// Cancels the job, if the build has not been started yet.
+    ///
+    /// @returns True if the job was cancelled, false if the build has already started or finished.
+    virtual bool Cancel() = 0;
+
+    /// Frees all resources associated with this object. A build that has not started yet is cancelled, and a build
+    /// that is running is waited for.
+    virtual void Destroy() = 0;
+
+protected:
+    /// @internal Constructor. Prevent use of new operator on this interface.
+    IPipelineBuildJob() {}
+
+    /// @internal Destructor. Prevent use of delete operator on this interface.
+    virtual ~IPipelineBuildJob() {}
+};
+
+// =====================================================================================================================
+/// Represents the interface of a read-only, reference-counted view of a pipeline binary, as returned by
+/// ICompiler::BuildGraphicsPipelineView and ICompiler::BuildComputePipelineView. When the pipeline is found in the
+/// compiler's shader cache, the view refers directly to the cache's storage, so no copy of the binary is made.
+class IPipelineBinaryView
+{
+public:
+    /// Gets the pipeline binary, which stays valid until the last reference to the view is released.
+    ///
+    /// @returns Pipeline binary data
+    virtual BinaryData GetBinary() const = 0;
+
+    /// Adds a reference to the view.
+    virtual void AddRef() = 0;
+
+    /// Releases a reference to the view. The view is freed when its last reference is released.
+    virtual void Release() = 0;
+
+protected:
+    /// @internal Constructor. Prevent use of new operator on this interface.
+    IPipelineBinaryView() {}
+
+    /// @internal Destructor. Prevent use of delete operator on this interface.
+    virtual ~IPipelineBinaryView() {}
 };
 
 // =====================================================================================================================
@@ -186,6 +343,11 @@ public:
         uint32_t             srcCacheCount,
         const IShaderCache** ppSrcCaches) = 0;
 
+    /// Gets statistics of the shader cache, which can be used to tune cache sizes and to track its hit rate.
+    ///
+    /// @param [out] pStats  Shader cache statistics
+    virtual void GetStats(ShaderCacheStats* pStats) = 0;
+
     /// Frees all resources associated with this object.
     virtual void Destroy() = 0;
 
@@ -274,6 +436,124 @@ public:
         IShaderCache**               ppShaderCache) = 0;
 #endif
 
+    /// Starts an asynchronous build of a graphics pipeline on a worker thread owned by the compiler. The build info,
+    /// including everything it points to, and the build out structure must stay valid until the job has finished or
+    /// been cancelled.
+    ///
+    /// @param [in]  pPipelineInfo  Info to build this graphics pipeline
+    /// @param [out] pPipelineOut   Output of building this graphics pipeline, filled in when the build finishes
+    /// @param [in]  priority       Priority of the build
+    /// @param [out] ppJob          Job of the build, which must be freed with IPipelineBuildJob::Destroy
+    ///
+    /// @returns Result::Success if the build was started. Other return codes indicate failure.
+    virtual Result BuildGraphicsPipelineAsync(const GraphicsPipelineBuildInfo* pPipelineInfo,
+                                              GraphicsPipelineBuildOut*        pPipelineOut,
+                                              PipelineBuildPriority            priority,
+                                              IPipelineBuildJob**              ppJob) = 0;
+
+    /// Starts an asynchronous build of a compute pipeline on a worker thread owned by the compiler. The build info,
+    /// including everything it points to, and the build out structure must stay valid until the job has finished or
+    /// been cancelled.
+    ///
+    /// @param [in]  pPipelineInfo  Info to build this compute pipeline
+    /// @param [out] pPipelineOut   Output of building this compute pipeline, filled in when the build finishes
+    /// @param [in]  priority       Priority of the build
+    /// @param [out] ppJob          Job of the build, which must be freed with IPipelineBuildJob::Destroy
+    ///
+    /// @returns Result::Success if the build was started. Other return codes indicate failure.
+    virtual Result BuildComputePipelineAsync(const ComputePipelineBuildInfo* pPipelineInfo,
+                                             ComputePipelineBuildOut*        pPipelineOut,
+                                             PipelineBuildPriority           priority,
+                                             IPipelineBuildJob**             ppJob) = 0;
+
+    /// Builds a graphics pipeline, returning a read-only view of the pipeline binary rather than copying it into memory
+    /// from pfnOutputAlloc. This makes a shader cache hit independent of the size of the binary.
+    ///
+    /// @param [in]  pPipelineInfo  Info to build this graphics pipeline
+    /// @param [out] ppView         View of the pipeline binary, with one reference, which must be released with
+    ///                             IPipelineBinaryView::Release
+    ///
+    /// @returns Result::Success if successful. Other return codes indicate failure.
+    virtual Result BuildGraphicsPipelineView(const GraphicsPipelineBuildInfo* pPipelineInfo,
+                                             IPipelineBinaryView**            ppView) = 0;
+
+    /// Builds a compute pipeline, returning a read-only view of the pipeline binary rather than copying it into memory
+    /// from pfnOutputAlloc. This makes a shader cache hit independent of the size of the binary.
+    ///
+    /// @param [in]  pPipelineInfo  Info to build this compute pipeline
+    /// @param [out] ppView         View of the pipeline binary, with one reference, which must be released with
+    ///                             IPipelineBinaryView::Release
+    ///
+    /// @returns Result::Success if successful. Other return codes indicate failure.
+    virtual Result BuildComputePipelineView(const ComputePipelineBuildInfo* pPipelineInfo,
+                                            IPipelineBinaryView**           ppView) = 0;
+
+    /// Builds a graphics pipeline with a minimal set of optimizations, so that it is available quickly at the expense
+    /// of shader performance. If ppUpgradeJob is not nullptr, a fully optimized rebuild is then started at background
+    /// priority on a worker thread owned by the compiler. When it finishes, it replaces the fast build in the shader
+    /// cache, so building the pipeline again, with this function or with BuildGraphicsPipeline, returns the fully
+    /// optimized binary. The build info, including everything it points to, must stay valid until the rebuild has
+    /// finished or been cancelled.
+    ///
+    /// @param [in]  pPipelineInfo  Info to build this graphics pipeline
+    /// @param [out] pPipelineOut   Output of building this graphics pipeline
+    /// @param [out] ppUpgradeJob   Job of the fully optimized rebuild, which must be freed with
+    ///                             IPipelineBuildJob::Destroy, or nullptr if the shader cache already held the fully
+    ///                             optimized binary (optional)
+    ///
+    /// @returns Result::Success if successful. Other return codes indicate failure.
+    virtual Result BuildGraphicsPipelineFast(const GraphicsPipelineBuildInfo* pPipelineInfo,
+                                             GraphicsPipelineBuildOut*        pPipelineOut,
+                                             IPipelineBuildJob**              ppUpgradeJob) = 0;
+
+    /// Builds a compute pipeline with a minimal set of optimizations, in the same way as BuildGraphicsPipelineFast.
+    ///
+    /// @param [in]  pPipelineInfo  Info to build this compute pipeline
+    /// @param [out] pPipelineOut   Output of building this compute pipeline
+    /// @param [out] ppUpgradeJob   Job of the fully optimized rebuild, which must be freed with
+    ///                             IPipelineBuildJob::Destroy, or nullptr if the shader cache already held the fully
+    ///                             optimized binary (optional)
+    ///
+    /// @returns Result::Success if successful. Other return codes indicate failure.
+    virtual Result BuildComputePipelineFast(const ComputePipelineBuildInfo* pPipelineInfo,
+                                            ComputePipelineBuildOut*        pPipelineOut,
+                                            IPipelineBuildJob**             ppUpgradeJob) = 0;
+
+    /// Builds a batch of graphics pipelines. A SPIR-V shader stage that is shared by several pipelines of the batch is
+    /// translated and lowered only once, and the pipelines are built concurrently on worker threads owned by the
+    /// compiler. The call returns when all the pipelines have been built.
+    ///
+    /// @param [in]  pipelineCount    Count of graphics pipelines to build
+    /// @param [in]  ppPipelineInfos  Info to build each graphics pipeline
+    /// @param [out] pPipelineOuts    Output of building each graphics pipeline
+    /// @param [out] pResults         Result of building each graphics pipeline (optional)
+    ///
+    /// @returns Result::Success if all the pipelines were built. Otherwise, the result of the first pipeline that
+    ///          failed to build.
+    virtual Result BuildGraphicsPipelines(uint32_t                               pipelineCount,
+                                          const GraphicsPipelineBuildInfo*const* ppPipelineInfos,
+                                          GraphicsPipelineBuildOut*              pPipelineOuts,
+                                          Result*                                pResults) = 0;
+
+    /// Gets statistics of the pool of LLPC contexts that is shared by all compiler instances, which can be used to
+    /// size the pool with the -context-pool-* options.
+    ///
+    /// @param [out] pStats  Context pool statistics
+    virtual void GetContextPoolStats(ContextPoolStats* pStats) const = 0;
+
+    /// Gets statistics of the compiler's internal shader cache. Statistics of application shader caches are got from
+    /// the caches themselves.
+    ///
+    /// @param [out] pStats  Shader cache statistics
+    virtual void GetShaderCacheStats(ShaderCacheStats* pStats) const = 0;
+
+    /// Rewrites the on-disk file of the compiler's internal shader cache to hold only the shaders held in the cache,
+    /// dropping records that have been evicted or replaced by an upgrade. Does nothing if the cache has no writable
+    /// on-disk file.
+    ///
+    /// @returns Result::Success if successful. Other return codes indicate failure.
+    virtual Result CompactShaderCache() = 0;
+
 protected:
     ICompiler() {}
     /// Destructor
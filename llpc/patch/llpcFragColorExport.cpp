@@ -32,6 +32,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 
+#include "llpcBuilderContext.h"
 #include "llpcFragColorExport.h"
 #include "llpcIntrinsDefs.h"
 #include "llpcPipelineState.h"
@@ -67,7 +68,13 @@ Value* FragColorExport::Run(
     const uint32_t origLoc = pResUsage->inOutUsage.fs.outputOrigLocs[location];
 
     ExportFormat expFmt = EXP_FORMAT_ZERO;
-    if (m_pPipelineState->GetColorExportState().dualSourceBlendEnable)
+    if (m_pPipelineState->GetBuilderContext()->GenericColorExport())
+    {
+        // The color target formats are not known to a generic fragment shader, so export the full 32-bit color and
+        // leave the conversion to the target format to the CB.
+        expFmt = EXP_FORMAT_32_ABGR;
+    }
+    else if (m_pPipelineState->GetColorExportState().dualSourceBlendEnable)
     {
         // Dual source blending is enabled
         expFmt= ComputeExportFormat(pOutputTy, 0);
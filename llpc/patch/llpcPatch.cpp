@@ -167,7 +167,14 @@ void Patch::AddPasses(
 
     if (cl::DisablePatchOpt == false)
     {
-        AddOptimizationPasses(passMgr);
+        if (pPipelineState->GetOptions().fastCompile)
+        {
+            AddFastOptimizationPasses(passMgr);
+        }
+        else
+        {
+            AddOptimizationPasses(passMgr);
+        }
     }
 
     // Stop timer for optimization passes and restart timer for patching passes.
@@ -347,6 +354,22 @@ void Patch::AddOptimizationPasses(
     }
 }
 
+// =====================================================================================================================
+// Add the minimal set of optimization passes used for a fast build. This cleans up after the patching passes, so that
+// the backend does not spend time on dead or trivially redundant code, but leaves out the loop and global
+// optimizations of the full set.
+void Patch::AddFastOptimizationPasses(
+    legacy::PassManager&  passMgr)  // [in/out] Pass manager to add passes to
+{
+    passMgr.add(createSROAPass());
+    passMgr.add(createEarlyCSEPass());
+    passMgr.add(createInstructionCombiningPass(false, 1));
+    passMgr.add(CreatePatchPeepholeOpt());
+    passMgr.add(createCFGSimplificationPass());
+    passMgr.add(createAggressiveDCEPass());
+    passMgr.add(createGlobalDCEPass());
+}
+
 // =====================================================================================================================
 // Initializes the pass according to the specified module.
 //
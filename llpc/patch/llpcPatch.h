@@ -148,6 +148,7 @@ protected:
 
 private:
     static void AddOptimizationPasses(llvm::legacy::PassManager& passMgr);
+    static void AddFastOptimizationPasses(llvm::legacy::PassManager& passMgr);
 
     Patch() = delete;
     Patch(const Patch&) = delete;
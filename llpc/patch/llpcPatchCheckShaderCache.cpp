@@ -54,26 +54,6 @@ PatchCheckShaderCache* CreatePatchCheckShaderCache()
 
 } // Llpc
 
-namespace
-{
-
-// =====================================================================================================================
-// Stream each map key and value for later inclusion in a hash
-template <class MapType>
-static void StreamMapEntries(MapType&     map,    // [in] Map to stream
-                             raw_ostream& stream) // [in/out] Stream to output map entries to
-{
-    size_t mapCount = map.size();
-    stream << StringRef(reinterpret_cast<const char*>(&mapCount), sizeof(mapCount));
-    for (auto mapIt : map)
-    {
-        stream << StringRef(reinterpret_cast<const char*>(&mapIt.first), sizeof(mapIt.first));
-        stream << StringRef(reinterpret_cast<const char*>(&mapIt.second), sizeof(mapIt.second));
-    }
-}
-
-} // anonymous
-
 // =====================================================================================================================
 PatchCheckShaderCache::PatchCheckShaderCache()
     :
@@ -125,48 +105,28 @@ bool PatchCheckShaderCache::runOnModule(
         }
     }
 
-    std::string inOutUsageStreams[ShaderStageGfxCount];
-    ArrayRef<uint8_t> inOutUsageValues[ShaderStageGfxCount];
+    uint64_t stageHashes[ShaderStageGfxCount] = {};
+    uint32_t hashStageMask = 0;
     PipelineState* pPipelineState = getAnalysis<PipelineStateWrapper>().GetPipelineState(&module);
     auto stageMask = pPipelineState->GetShaderStageMask();
 
-    // Build input/output layout hash per shader stage
-    for (auto stage = ShaderStageVertex; stage < ShaderStageGfxCount; stage = static_cast<ShaderStage>(stage + 1))
+    // Gather the per-stage hashes. Each is the input hash of the shader, with any data from other shaders that was
+    // used in compiling it folded in by the passes that used it.
+    for (auto& func : module)
     {
-        if ((stageMask & ShaderStageToMask(stage)) == 0)
-        {
-            continue;
-        }
-
-        auto pResUsage = pPipelineState->GetShaderResourceUsage(stage);
-        raw_string_ostream stream(inOutUsageStreams[stage]);
-
-        // Update input/output usage
-        StreamMapEntries(pResUsage->inOutUsage.inputLocMap, stream);
-        StreamMapEntries(pResUsage->inOutUsage.outputLocMap, stream);
-        StreamMapEntries(pResUsage->inOutUsage.inOutLocMap, stream);
-        StreamMapEntries(pResUsage->inOutUsage.perPatchInputLocMap, stream);
-        StreamMapEntries(pResUsage->inOutUsage.perPatchOutputLocMap, stream);
-        StreamMapEntries(pResUsage->inOutUsage.builtInInputLocMap, stream);
-        StreamMapEntries(pResUsage->inOutUsage.builtInOutputLocMap, stream);
-        StreamMapEntries(pResUsage->inOutUsage.perPatchBuiltInInputLocMap, stream);
-        StreamMapEntries(pResUsage->inOutUsage.perPatchBuiltInOutputLocMap, stream);
-
-        if (stage == ShaderStageGeometry)
+        if ((func.empty() == false) && (func.getLinkage() != GlobalValue::InternalLinkage))
         {
-            // NOTE: For geometry shader, copy shader will use this special map info (from built-in outputs to
-            // locations of generic outputs). We have to add it to shader hash calculation.
-            StreamMapEntries(pResUsage->inOutUsage.gs.builtInOutLocs, stream);
+            auto stage = GetShaderStageFromFunction(&func);
+            if ((stage != ShaderStageInvalid) && (stage < ShaderStageGfxCount) &&
+                GetShaderHash(&func, &stageHashes[stage]))
+            {
+                hashStageMask |= ShaderStageToMask(stage);
+            }
         }
-
-        // Store the result of the hash for this shader stage.
-        stream.flush();
-        inOutUsageValues[stage] = ArrayRef<uint8_t>(reinterpret_cast<const uint8_t*>(inOutUsageStreams[stage].data()),
-                                                    inOutUsageStreams[stage].size());
     }
 
     // Ask callback function if it wants to remove any shader stages.
-    uint32_t modifiedStageMask = m_callbackFunc(&module, stageMask, inOutUsageValues);
+    uint32_t modifiedStageMask = m_callbackFunc(&module, stageMask, stageHashes, hashStageMask);
     if (modifiedStageMask == stageMask)
     {
         return false;
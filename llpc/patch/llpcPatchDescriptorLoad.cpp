@@ -29,10 +29,12 @@
  ***********************************************************************************************************************
  */
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicsAMDGPU.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "llpcBuilderContext.h"
 #include "llpcPatchDescriptorLoad.h"
 #include "llpcTargetInfo.h"
 
@@ -435,7 +437,12 @@ Value* PatchDescriptorLoad::LoadDescriptor(
                 "",
                 pInsertPoint);
 
-            auto pDescOffset = ConstantInt::get(Type::getInt32Ty(*m_pContext), descOffset);
+            auto pDescOffset = GetDescriptorOffset(nodeType1,
+                                                   foundNodeType,
+                                                   descSet,
+                                                   binding,
+                                                   descOffset,
+                                                   pInsertPoint);
 
             pDescElem0 = BinaryOperator::CreateAdd(pDescElem0, pDescOffset, "", pInsertPoint);
 
@@ -509,7 +516,12 @@ Value* PatchDescriptorLoad::LoadDescriptor(
         }
         else
         {
-            auto pDescOffset = ConstantInt::get(Type::getInt32Ty(*m_pContext), descOffset);
+            auto pDescOffset = GetDescriptorOffset(nodeType1,
+                                                   foundNodeType,
+                                                   descSet,
+                                                   binding,
+                                                   descOffset,
+                                                   pInsertPoint);
             auto pDescSize   = ConstantInt::get(Type::getInt32Ty(*m_pContext), descSize, 0);
 
             Value* pOffset = BinaryOperator::CreateMul(pArrayOffset, pDescSize, "", pInsertPoint);
@@ -597,6 +609,58 @@ Constant* PatchDescriptorLoad::GetDescriptorRangeValue(
     return nullptr;
 }
 
+// =====================================================================================================================
+// Gets the byte offset of a descriptor in its descriptor table.
+//
+// When building a relocatable shader ELF, the offset is not known until the shader is linked into a pipeline, so it
+// is emitted as a relocation against a "doff_<set>_<binding>_<type>" symbol, which the linker resolves to the byte
+// offset of the matching resource node in the pipeline's descriptor tables. That includes a descriptor that is not
+// found, which is relocated against the node type asked for, as the offsets of the descriptors in descriptor tables
+// are not part of the key of a relocatable shader ELF.
+Value* PatchDescriptorLoad::GetDescriptorOffset(
+    ResourceMappingNodeType   nodeType,       // Resource node type of the descriptor being loaded
+    ResourceMappingNodeType   foundNodeType,  // Resource node type actually found for the descriptor
+    uint32_t                  descSet,        // ID of descriptor set
+    uint32_t                  binding,        // ID of descriptor binding
+    uint32_t                  descOffset,     // Byte offset of the descriptor in the current pipeline layout
+    Instruction*              pInsertPoint)   // [in] Insert point
+{
+    if ((m_pPipelineState->GetBuilderContext()->BuildingRelocatableElf() == false) ||
+        (descSet == InternalResourceTable) ||
+        (descSet == InternalPerShaderTable) ||
+        (foundNodeType == ResourceMappingNodeType::DescriptorYCbCrSampler))
+    {
+        return ConstantInt::get(Type::getInt32Ty(*m_pContext), descOffset);
+    }
+
+    if (foundNodeType == ResourceMappingNodeType::Unknown)
+    {
+        foundNodeType = nodeType;
+    }
+
+    std::string relocName = DescOffsetRelocPrefix;
+    relocName += std::to_string(descSet) + "_" + std::to_string(binding) + "_" +
+                 std::to_string(static_cast<uint32_t>(foundNodeType));
+
+    auto pRelocFunc = Intrinsic::getDeclaration(m_pModule, Intrinsic::amdgcn_reloc_constant);
+    auto pRelocName = MetadataAsValue::get(*m_pContext,
+                                           MDNode::get(*m_pContext, MDString::get(*m_pContext, relocName)));
+    Value* pDescOffset = CallInst::Create(pRelocFunc, pRelocName, "", pInsertPoint);
+
+    // The sampler of a combined texture follows the image in the same resource node.
+    if ((foundNodeType == ResourceMappingNodeType::DescriptorCombinedTexture) &&
+        (nodeType == ResourceMappingNodeType::DescriptorSampler))
+    {
+        pDescOffset = BinaryOperator::CreateAdd(pDescOffset,
+                                                ConstantInt::get(Type::getInt32Ty(*m_pContext),
+                                                                 DescriptorSizeResource),
+                                                "",
+                                                pInsertPoint);
+    }
+
+    return pDescOffset;
+}
+
 // =====================================================================================================================
 // Build buffer compact descriptor
 Value* PatchDescriptorLoad::BuildBufferCompactDesc(
@@ -88,6 +88,13 @@ private:
                                             uint32_t                  descSet,
                                             uint32_t                  binding) const;
 
+    llvm::Value* GetDescriptorOffset(ResourceMappingNodeType   nodeType,
+                                     ResourceMappingNodeType   foundNodeType,
+                                     uint32_t                  descSet,
+                                     uint32_t                  binding,
+                                     uint32_t                  descOffset,
+                                     llvm::Instruction*        pInsertPoint);
+
     void PatchWaterfallLastUseCalls();
 
     llvm::Value* BuildBufferCompactDesc(llvm::Value* pDesc, llvm::Instruction* pInsertPoint);
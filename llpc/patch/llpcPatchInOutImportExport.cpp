@@ -1541,6 +1541,15 @@ void PatchInOutImportExport::visitReturnInst(
             auto pResUsage = m_pPipelineState->GetShaderResourceUsage(m_shaderStage);
             for(auto locMap : pResUsage->inOutUsage.outputLocMap)
             {
+                if (m_shaderStage == ShaderStageCopyShader)
+                {
+                    // Only the outputs of the rasterization stream are exported.
+                    uint32_t outLocInfo = locMap.first;
+                    if (reinterpret_cast<GsOutLocInfo*>(&outLocInfo)->streamId != inOutUsage.gs.rasterStream)
+                    {
+                        continue;
+                    }
+                }
                 if (m_expLocs.count(locMap.second) != 0)
                 {
                     continue;
@@ -2127,8 +2136,6 @@ void PatchInOutImportExport::PatchVsGenericOutputExport(
 {
     auto pOutputTy = pOutput->getType();
 
-    m_expLocs.insert(location);
-
     if (m_hasTs)
     {
         auto pLdsOffset = CalcLdsOffsetForVsOutput(pOutputTy, location, compIdx, pInsertPos);
@@ -6342,6 +6349,8 @@ void PatchInOutImportExport::AddExportInstForGenericOutput(
     assert(useExpInst);
     (void(useExpInst)); // unused
 
+    m_expLocs.insert(location);
+
     auto pOutputTy = pOutput->getType();
 
     auto& inOutUsage = m_pPipelineState->GetShaderResourceUsage(m_shaderStage)->inOutUsage;
@@ -6486,6 +6495,7 @@ void PatchInOutImportExport::AddExportInstForGenericOutput(
 
         // Do the second exporting
         const uint32_t channelMask = ((1 << (numChannels - 4)) - 1);
+        m_expLocs.insert(location + 1);
 
         args.clear();
         args.push_back(ConstantInt::get(Type::getInt32Ty(*m_pContext), EXP_TARGET_PARAM_0 + location + 1)); // tgt
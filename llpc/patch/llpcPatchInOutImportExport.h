@@ -348,7 +348,7 @@ private:
     std::vector<llvm::CallInst*> m_exportCalls; // List of "call" instructions to export outputs
     PipelineState*          m_pPipelineState = nullptr; // Pipeline state from PipelineStateWrapper pass
 
-    std::set<uint32_t>       m_expLocs; // The locations that already have an export instruction for the vertex shader.
+    std::set<uint32_t>       m_expLocs; // The locations that already have an export instruction in the hardware VS.
 };
 
 } // Llpc
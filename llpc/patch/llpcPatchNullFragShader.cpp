@@ -168,6 +168,17 @@ bool PatchNullFragShader::runOnModule(
     auto pExecModelMetaNode = MDNode::get(*m_pContext, pExecModelMeta);
     pEntryPoint->addMetadata(LlpcName::ShaderStageMetadata, *pExecModelMetaNode);
 
+    // If the other shaders are being checked against the per-stage shader cache, the null fragment shader is too. It
+    // has no input shader hash of its own.
+    for (Function& func : module)
+    {
+        if (func.getMetadata(LlpcName::ShaderHashMetadata) != nullptr)
+        {
+            SetShaderHash(pEntryPoint, 0);
+            break;
+        }
+    }
+
     // Initialize shader info.
     auto pResUsage = pPipelineState->GetShaderResourceUsage(ShaderStageFragment);
     pPipelineState->SetShaderStageMask(pPipelineState->GetShaderStageMask() | ShaderStageToMask(ShaderStageFragment));
@@ -127,11 +127,74 @@ bool PatchResourceCollect::runOnModule(
             bool gsOnChip = CheckGsOnChipValidity();
             m_pPipelineState->SetGsOnChip(gsOnChip);
         }
+
+        // Record the input/output mapping decisions in the per-stage shader cache hashes.
+        UpdateInterShaderHashes();
     }
 
     return true;
 }
 
+// =====================================================================================================================
+// Stream each map key and value for later inclusion in a hash
+template <class MapType>
+static void StreamMapEntries(
+    MapType&     map,    // [in] Map to stream
+    raw_ostream& stream) // [in/out] Stream to output map entries to
+{
+    size_t mapCount = map.size();
+    stream << StringRef(reinterpret_cast<const char*>(&mapCount), sizeof(mapCount));
+    for (auto mapIt : map)
+    {
+        stream << StringRef(reinterpret_cast<const char*>(&mapIt.first), sizeof(mapIt.first));
+        stream << StringRef(reinterpret_cast<const char*>(&mapIt.second), sizeof(mapIt.second));
+    }
+}
+
+// =====================================================================================================================
+// Folds the input/output location mapping of each shader stage into the inter-shader data tracking hash of its
+// entry-point. The mapping of a stage is decided together with its neighbouring stages, so it is the inter-shader
+// data that the per-stage shader cache key of the stage has to reflect.
+//
+// NOTE: Shaders that do not carry a hash are not being checked against the per-stage shader cache, and are left
+// alone.
+void PatchResourceCollect::UpdateInterShaderHashes()
+{
+    for (auto stage = ShaderStageVertex; stage < ShaderStageGfxCount; stage = static_cast<ShaderStage>(stage + 1))
+    {
+        Function* pEntryPoint = m_pPipelineShaders->GetEntryPoint(stage);
+        if ((pEntryPoint == nullptr) || (pEntryPoint->getMetadata(LlpcName::ShaderHashMetadata) == nullptr))
+        {
+            continue;
+        }
+
+        auto pResUsage = m_pPipelineState->GetShaderResourceUsage(stage);
+        std::string inOutUsage;
+        raw_string_ostream stream(inOutUsage);
+
+        StreamMapEntries(pResUsage->inOutUsage.inputLocMap, stream);
+        StreamMapEntries(pResUsage->inOutUsage.outputLocMap, stream);
+        StreamMapEntries(pResUsage->inOutUsage.inOutLocMap, stream);
+        StreamMapEntries(pResUsage->inOutUsage.perPatchInputLocMap, stream);
+        StreamMapEntries(pResUsage->inOutUsage.perPatchOutputLocMap, stream);
+        StreamMapEntries(pResUsage->inOutUsage.builtInInputLocMap, stream);
+        StreamMapEntries(pResUsage->inOutUsage.builtInOutputLocMap, stream);
+        StreamMapEntries(pResUsage->inOutUsage.perPatchBuiltInInputLocMap, stream);
+        StreamMapEntries(pResUsage->inOutUsage.perPatchBuiltInOutputLocMap, stream);
+
+        if (stage == ShaderStageGeometry)
+        {
+            // NOTE: For geometry shader, copy shader will use this special map info (from built-in outputs to
+            // locations of generic outputs). We have to add it to shader hash calculation.
+            StreamMapEntries(pResUsage->inOutUsage.gs.builtInOutLocs, stream);
+        }
+
+        stream.flush();
+        UpdateShaderHash(pEntryPoint,
+                         ArrayRef<uint8_t>(reinterpret_cast<const uint8_t*>(inOutUsage.data()), inOutUsage.size()));
+    }
+}
+
 // =====================================================================================================================
 // Sets NGG control settings
 void PatchResourceCollect::SetNggControl()
@@ -1514,10 +1577,13 @@ void PatchResourceCollect::visitCallInst(
 // Clears inactive (those actually unused) inputs.
 void PatchResourceCollect::ClearInactiveInput()
 {
-    bool buildingRelocatableElf = m_pPipelineState->GetBuilderContext()->BuildingRelocatableElf();
+    // NOTE: When building relocatable ELF, the inputs of the vertex and fragment shaders are kept, as they face
+    // interfaces that are not known at this point. The inputs of other stages are matched within the pipeline.
+    bool keepInputs = m_pPipelineState->GetBuilderContext()->BuildingRelocatableElf() &&
+                      ((m_shaderStage == ShaderStageVertex) || (m_shaderStage == ShaderStageFragment));
     // Clear those inactive generic inputs, remove them from location mappings
     if (m_pPipelineState->IsGraphics() && (m_hasDynIndexedInput == false) && (m_shaderStage != ShaderStageTessEval)
-        && !buildingRelocatableElf)
+        && !keepInputs)
     {
         // TODO: Here, we keep all generic inputs of tessellation evaluation shader. This is because corresponding
         // generic outputs of tessellation control shader might involve in output import and dynamic indexing, which
@@ -2002,8 +2068,9 @@ void PatchResourceCollect::MatchGenericInOut()
     auto& perPatchInLocMap  = inOutUsage.perPatchInputLocMap;
     auto& perPatchOutLocMap = inOutUsage.perPatchOutputLocMap;
 
-    // Do input/output matching
-    if (!m_pPipelineState->GetBuilderContext()->BuildingRelocatableElf() && m_shaderStage != ShaderStageFragment)
+    // Do input/output matching. When building relocatable ELF, the fragment shader is built separately, so the last
+    // pre-rasterization stage has no next stage here and its outputs are kept.
+    if (m_shaderStage != ShaderStageFragment)
     {
         const auto nextStage = m_pPipelineState->GetNextShaderStage(m_shaderStage);
 
@@ -2145,7 +2212,8 @@ void PatchResourceCollect::MatchGenericInOut()
                 {
                     location = 0;
                 }
-                if (m_pPipelineState->GetColorExportFormat(location).dfmt == BufDataFormatInvalid)
+                if ((m_pPipelineState->GetBuilderContext()->GenericColorExport() == false) &&
+                    (m_pPipelineState->GetColorExportFormat(location).dfmt == BufDataFormatInvalid))
                 {
                     locMapIt = outLocMap.erase(locMapIt);
                     continue;
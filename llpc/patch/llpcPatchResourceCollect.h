@@ -81,6 +81,8 @@ private:
 
     void ProcessShader();
 
+    void UpdateInterShaderHashes();
+
     bool IsVertexReuseDisabled();
 
     void ClearInactiveInput();
@@ -63,8 +63,13 @@
     #endif
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <sstream>
 #include <stdlib.h> // getenv
+#include <thread>
+#include <unordered_set>
 
 // NOTE: To enable VLD, please add option BUILD_WIN_VLD=1 in build option.To run amdllpc with VLD enabled,
 // please copy vld.ini and all files in.\winVisualMemDetector\bin\Win64 to current directory of amdllpc.
@@ -81,6 +86,7 @@
 #include "llpc.h"
 #include "llpcDebug.h"
 #include "llpcElfReader.h"
+#include "llpcShaderCache.h"
 #include "llpcShaderModuleHelper.h"
 #include "llpcSpirvLowerUtil.h"
 
@@ -261,6 +267,11 @@ static cl::opt<bool> CheckAutoLayoutCompatible(
     "check-auto-layout-compatible",
     cl::desc("check if auto descriptor layout got from spv file is commpatible with real layout"));
 
+// -shader-cache-stats: print statistics of the shader cache at exit
+static cl::opt<bool> EnableShaderCacheStats("shader-cache-stats",
+                                            cl::desc("Print statistics of the shader cache at exit"),
+                                            cl::init(false));
+
 namespace llvm
 {
 
@@ -271,6 +282,8 @@ extern opt<bool> EnablePipelineDump;
 extern opt<std::string> PipelineDumpDir;
 extern opt<bool> DisableNullFragShader;
 extern opt<bool> EnableTimerProfile;
+extern opt<uint32_t> ShaderCacheMode;
+extern opt<bool> TrimDebugInfo;
 
 // -filter-pipeline-dump-by-type: filter which kinds of pipeline should be disabled.
 static opt<uint32_t> FilterPipelineDumpByType("filter-pipeline-dump-by-type",
@@ -297,6 +310,37 @@ static opt<bool> DumpDuplicatePipelines("dump-duplicate-pipelines",
 
 } // llvm
 
+// =====================================================================================================================
+// Parser of the -prewarm option, which also enables the on-disk shader cache unless the shader cache mode is specified
+// externally, as the shaders compiled in pre-warm mode are only of use in the shader cache file.
+class PrewarmParser : public cl::parser<bool>
+{
+public:
+    PrewarmParser(cl::Option& option) : cl::parser<bool>(option) {}
+
+    bool parse(cl::Option& option, StringRef argName, StringRef arg, bool& value)
+    {
+        bool error = cl::parser<bool>::parse(option, argName, arg, value);
+        if ((error == false) && value && (cl::ShaderCacheMode.getNumOccurrences() == 0))
+        {
+            // A later -shader-cache-mode still overrides this.
+            cl::ShaderCacheMode.setValue(ShaderCacheEnableOnDisk);
+        }
+        return error;
+    }
+};
+
+// -prewarm: compile the pipeline dumps of the inputs into the on-disk shader cache
+static cl::opt<bool, false, PrewarmParser> Prewarm("prewarm",
+                                                   cl::desc("Compile the pipeline info files (.pipe) in the input "
+                                                            "directories into the on-disk shader cache"),
+                                                   cl::init(false));
+
+// -prewarm-threads: number of threads to compile pipelines on in pre-warm mode
+static cl::opt<uint32_t> PrewarmThreads("prewarm-threads",
+                                        cl::desc("Number of threads in pre-warm mode (0 - number of hardware threads)"),
+                                        cl::init(0));
+
 #ifdef WIN_OS
 // -assert-to-msgbox: pop message box when an assert is hit, only valid in Windows
 static cl::opt<bool>        AssertToMsgBox("assert-to-msgbox", cl::desc("Pop message box when assert is hit"));
@@ -341,6 +385,53 @@ struct CompileInfo
                                                                 // same as specified pipeline layout
 };
 
+// =====================================================================================================================
+// Prints a latency histogram of shader cache statistics, skipping empty buckets.
+static void PrintLatencyHistogram(
+    const char*                        pName,        // [in] Name of the operation
+    const ShaderCacheLatencyHistogram& histogram)    // [in] Latency histogram of the operation
+{
+    const uint64_t averageUs = (histogram.count > 0) ? (histogram.totalUs / histogram.count) : 0;
+    outs() << pName << ": count = " << histogram.count << ", average = " << averageUs << " us, max = " <<
+        histogram.maxUs << " us\n";
+    for (uint32_t i = 0; i < ShaderCacheLatencyBucketCount; ++i)
+    {
+        if (histogram.buckets[i] > 0)
+        {
+            const uint64_t lowerUs = (i == 0) ? 0 : (1ull << (i - 1));
+            outs() << "    >= " << format("%8llu", static_cast<unsigned long long>(lowerUs)) << " us: " <<
+                histogram.buckets[i] << "\n";
+        }
+    }
+}
+
+// =====================================================================================================================
+// Prints statistics of the internal shader cache of the compiler. They are printed whether or not -enable-outs is on,
+// as they are requested explicitly.
+static void PrintShaderCacheStats(
+    ICompiler* pCompiler)   // [in] LLPC compiler object
+{
+    ShaderCacheStats stats = {};
+    pCompiler->GetShaderCacheStats(&stats);
+
+    outs() << "\n===============================================================================\n";
+    outs() << "// Shader cache statistics\n\n";
+    outs() << "lookups          = " << stats.lookupCount << "\n";
+    outs() << "hits             = " << stats.hitCount << " (shared directory: " << stats.sharedDirHitCount <<
+        ", external cache: " << stats.externalHitCount << ")\n";
+    outs() << "misses           = " << stats.missCount << "\n";
+    outs() << "waits            = " << stats.waitCount << "\n";
+    outs() << "external misses  = " << stats.externalMissCount << "\n";
+    outs() << "inserts          = " << stats.insertCount << " (" << stats.insertBytes << " bytes)\n";
+    outs() << "upgrades         = " << stats.upgradeCount << "\n";
+    outs() << "evictions        = " << stats.evictionCount << " (" << stats.evictedBytes << " bytes)\n";
+    outs() << "resident bytes   = " << stats.residentBytes << "\n";
+    outs() << "file bytes       = " << stats.fileBytes << "\n";
+    PrintLatencyHistogram("wait latency", stats.waitLatency);
+    PrintLatencyHistogram("external get latency", stats.externalGetLatency);
+    PrintLatencyHistogram("external store latency", stats.externalStoreLatency);
+}
+
 // =====================================================================================================================
 // Checks whether the input data is actually a ELF binary
 static bool IsElfBinary(
@@ -1119,19 +1210,17 @@ static Result CheckAutoLayoutCompatibleFunc(
 }
 
 // =====================================================================================================================
-// Builds pipeline and do linking.
-static Result BuildPipeline(
-    ICompiler*    pCompiler,        // [in] LLPC compiler object
-    CompileInfo*  pCompileInfo)     // [in,out] Compilation info of LLPC standalone tool
+// Fills the shader info of the pipeline from the shader modules, and sets the pipeline state that is given a default
+// value by the tool. The shader module data is left null for shader modules that have not been built yet.
+//
+// NOTE: This is done again when the pipeline is built, which is harmless unless user data is laid out automatically.
+static void FillPipelineShaderInfo(
+    CompileInfo* pCompileInfo,  // [in,out] Compilation info of LLPC standalone tool
+    bool         isGraphics)    // Whether the pipeline is a graphics pipeline
 {
-    Result result = Result::Success;
-
-    bool isGraphics = (pCompileInfo->stageMask & (ShaderStageToMask(ShaderStageCompute) -1)) ? true : false;
     if (isGraphics)
     {
-        // Build graphics pipeline
         GraphicsPipelineBuildInfo* pPipelineInfo = &pCompileInfo->gfxPipelineInfo;
-        GraphicsPipelineBuildOut*  pPipelineOut  = &pCompileInfo->gfxPipelineOut;
 
         // Fill pipeline shader info
         PipelineShaderInfo* shaderInfo[ShaderStageGfxCount] =
@@ -1146,7 +1235,6 @@ static Result BuildPipeline(
         uint32_t userDataOffset = 0;
         for (uint32_t i = 0; i < pCompileInfo->shaderModuleDatas.size(); ++i)
         {
-
             PipelineShaderInfo*         pShaderInfo = shaderInfo[pCompileInfo->shaderModuleDatas[i].shaderStage];
             const ShaderModuleBuildOut* pShaderOut  = &(pCompileInfo->shaderModuleDatas[i].shaderOut);
 
@@ -1170,10 +1258,6 @@ static Result BuildPipeline(
             }
         }
 
-        pPipelineInfo->pInstance      = nullptr; // Dummy, unused
-        pPipelineInfo->pUserData      = &pCompileInfo->pPipelineBuf;
-        pPipelineInfo->pfnOutputAlloc = AllocateBuffer;
-
         // NOTE: If number of patch control points is not specified, we set it to 3.
         if (pPipelineInfo->iaState.patchControlPoints == 0)
         {
@@ -1181,6 +1265,58 @@ static Result BuildPipeline(
         }
 
         pPipelineInfo->options.robustBufferAccess = RobustBufferAccess;
+    }
+    else
+    {
+        ComputePipelineBuildInfo*   pPipelineInfo = &pCompileInfo->compPipelineInfo;
+        PipelineShaderInfo*         pShaderInfo   = &pPipelineInfo->cs;
+        const ShaderModuleBuildOut* pShaderOut    = &pCompileInfo->shaderModuleDatas[0].shaderOut;
+
+        if (pShaderInfo->pEntryTarget == nullptr)
+        {
+            // If entry target is not specified, use the one from command line option
+            pShaderInfo->pEntryTarget = EntryTarget.c_str();
+        }
+
+        pShaderInfo->entryStage = ShaderStageCompute;
+        pShaderInfo->pModuleData  = pShaderOut->pModuleData;
+
+        // If not compiling from pipeline, lay out user data now.
+        if (pCompileInfo->doAutoLayout)
+        {
+            uint32_t userDataOffset = 0;
+            DoAutoLayoutDesc(ShaderStageCompute,
+                             pCompileInfo->shaderModuleDatas[0].spirvBin,
+                             nullptr,
+                             pShaderInfo,
+                             userDataOffset,
+                             false);
+        }
+
+        pPipelineInfo->options.robustBufferAccess = RobustBufferAccess;
+    }
+}
+
+// =====================================================================================================================
+// Builds pipeline and do linking.
+static Result BuildPipeline(
+    ICompiler*    pCompiler,        // [in] LLPC compiler object
+    CompileInfo*  pCompileInfo)     // [in,out] Compilation info of LLPC standalone tool
+{
+    Result result = Result::Success;
+
+    bool isGraphics = (pCompileInfo->stageMask & (ShaderStageToMask(ShaderStageCompute) -1)) ? true : false;
+    if (isGraphics)
+    {
+        // Build graphics pipeline
+        GraphicsPipelineBuildInfo* pPipelineInfo = &pCompileInfo->gfxPipelineInfo;
+        GraphicsPipelineBuildOut*  pPipelineOut  = &pCompileInfo->gfxPipelineOut;
+
+        FillPipelineShaderInfo(pCompileInfo, isGraphics);
+
+        pPipelineInfo->pInstance      = nullptr; // Dummy, unused
+        pPipelineInfo->pUserData      = &pCompileInfo->pPipelineBuf;
+        pPipelineInfo->pfnOutputAlloc = AllocateBuffer;
 
         void* pPipelineDumpHandle = nullptr;
         if (llvm::cl::EnablePipelineDump)
@@ -1230,34 +1366,11 @@ static Result BuildPipeline(
         ComputePipelineBuildInfo* pPipelineInfo = &pCompileInfo->compPipelineInfo;
         ComputePipelineBuildOut*  pPipelineOut  = &pCompileInfo->compPipelineOut;
 
-        PipelineShaderInfo*         pShaderInfo = &pPipelineInfo->cs;
-        const ShaderModuleBuildOut* pShaderOut  = &pCompileInfo->shaderModuleDatas[0].shaderOut;
-
-        if (pShaderInfo->pEntryTarget == nullptr)
-        {
-            // If entry target is not specified, use the one from command line option
-            pShaderInfo->pEntryTarget = EntryTarget.c_str();
-        }
-
-        pShaderInfo->entryStage = ShaderStageCompute;
-        pShaderInfo->pModuleData  = pShaderOut->pModuleData;
-
-        // If not compiling from pipeline, lay out user data now.
-        if (pCompileInfo->doAutoLayout)
-        {
-            uint32_t userDataOffset = 0;
-            DoAutoLayoutDesc(ShaderStageCompute,
-                             pCompileInfo->shaderModuleDatas[0].spirvBin,
-                             nullptr,
-                             pShaderInfo,
-                             userDataOffset,
-                             false);
-        }
+        FillPipelineShaderInfo(pCompileInfo, isGraphics);
 
         pPipelineInfo->pInstance      = nullptr; // Dummy, unused
         pPipelineInfo->pUserData      = &pCompileInfo->pPipelineBuf;
         pPipelineInfo->pfnOutputAlloc = AllocateBuffer;
-        pPipelineInfo->options.robustBufferAccess = RobustBufferAccess;
 
         void* pPipelineDumpHandle = nullptr;
         if (llvm::cl::EnablePipelineDump)
@@ -1756,6 +1869,258 @@ static Result ProcessPipeline(
     return result;
 }
 
+
+// =====================================================================================================================
+// Builds the pipeline of a pipeline info file to pre-warm the shader cache, unless a pipeline with the same cache hash
+// has already been built. The pipeline binary is discarded.
+static Result PrewarmPipeline(
+    ICompiler*                    pCompiler,        // [in] LLPC compiler object
+    const std::string&            inFile,           // [in] Pipeline info file
+    std::mutex*                   pLock,            // [in] Lock of the VFX parser and of the pipeline hash set
+    std::unordered_set<uint64_t>* pPipelineHashes,  // [in,out] Cache hashes of the pipelines built so far
+    bool*                         pDuplicate)       // [out] Whether the pipeline is skipped as a duplicate
+{
+    Result result = Result::Success;
+    CompileInfo compileInfo = {};
+    VfxPipelineStatePtr pPipelineState = nullptr;
+    const char* pLog = nullptr;
+
+    *pDuplicate = false;
+    result = InitCompileInfo(&compileInfo);
+
+    {
+        // NOTE: The VFX parser is not known to be thread-safe, so pipeline info files are parsed one at a time.
+        std::lock_guard<std::mutex> lock(*pLock);
+        if (Vfx::vfxParseFile(inFile.c_str(),
+                              0,
+                              nullptr,
+                              VfxDocTypePipeline,
+                              &compileInfo.pPipelineInfoFile,
+                              &pLog))
+        {
+            Vfx::vfxGetPipelineDoc(compileInfo.pPipelineInfoFile, &pPipelineState);
+        }
+    }
+
+    if (pPipelineState == nullptr)
+    {
+        LLPC_ERRS("Failed to parse input file: " << inFile << "\n" << pLog << "\n");
+        result = Result::ErrorInvalidShader;
+    }
+    else if (pPipelineState->version != Llpc::Version)
+    {
+        LLPC_ERRS("Version incompatible, SPVGEN::Version = " << pPipelineState->version <<
+                  " AMDLLPC::Version = " << Llpc::Version << " in " << inFile << "\n");
+        result = Result::ErrorInvalidShader;
+    }
+
+    if (result == Result::Success)
+    {
+        compileInfo.compPipelineInfo = pPipelineState->compPipelineInfo;
+        compileInfo.gfxPipelineInfo  = pPipelineState->gfxPipelineInfo;
+        compileInfo.pFileNames       = inFile.c_str();
+
+        for (uint32_t stage = 0; stage < pPipelineState->numStages; ++stage)
+        {
+            if (pPipelineState->stages[stage].dataSize > 0)
+            {
+                ::ShaderModuleData shaderModuleData = {};
+                shaderModuleData.spirvBin.codeSize = pPipelineState->stages[stage].dataSize;
+                shaderModuleData.spirvBin.pCode = pPipelineState->stages[stage].pData;
+                shaderModuleData.shaderStage = pPipelineState->stages[stage].stage;
+
+                compileInfo.shaderModuleDatas.push_back(shaderModuleData);
+                compileInfo.stageMask |= ShaderStageToMask(pPipelineState->stages[stage].stage);
+            }
+        }
+
+        bool isGraphics = (compileInfo.stageMask & ShaderStageToMask(ShaderStageCompute)) ? false : true;
+        for (uint32_t i = 0; i < compileInfo.shaderModuleDatas.size(); ++i)
+        {
+            compileInfo.shaderModuleDatas[i].shaderInfo.options.pipelineOptions = isGraphics ?
+                                                                    compileInfo.gfxPipelineInfo.options :
+                                                                    compileInfo.compPipelineInfo.options;
+        }
+
+        // Fill the shader info as BuildPipeline() does, so that the cache hash is the one of the pipeline built. The
+        // cache hash is calculated from the SPIR-V binaries, so that a duplicate does not build its shader modules.
+        FillPipelineShaderInfo(&compileInfo, isGraphics);
+
+        uint64_t hash = 0;
+        if (isGraphics)
+        {
+            BinaryData shaderBins[ShaderStageGfxCount] = {};
+            for (uint32_t i = 0; i < compileInfo.shaderModuleDatas.size(); ++i)
+            {
+                shaderBins[compileInfo.shaderModuleDatas[i].shaderStage] = compileInfo.shaderModuleDatas[i].spirvBin;
+            }
+            hash = IPipelineDumper::GetPipelineCacheHash(&compileInfo.gfxPipelineInfo, shaderBins, cl::TrimDebugInfo);
+        }
+        else
+        {
+            hash = IPipelineDumper::GetPipelineCacheHash(&compileInfo.compPipelineInfo,
+                                                         &compileInfo.shaderModuleDatas[0].spirvBin,
+                                                         cl::TrimDebugInfo);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(*pLock);
+            *pDuplicate = (pPipelineHashes->insert(hash).second == false);
+        }
+
+        if (*pDuplicate == false)
+        {
+            result = BuildShaderModules(pCompiler, &compileInfo);
+            if (result == Result::Delayed)
+            {
+                result = Result::Success;
+            }
+
+            if (result == Result::Success)
+            {
+                result = BuildPipeline(pCompiler, &compileInfo);
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(*pLock);
+        CleanupCompileInfo(&compileInfo);
+    }
+
+    return result;
+}
+
+// =====================================================================================================================
+// Collects the pipeline info files to pre-warm the shader cache with. Each input is either a pipeline info file or a
+// directory, which is searched recursively for pipeline info files.
+static Result CollectPrewarmFiles(
+    std::vector<std::string>* pFiles)   // [out] Pipeline info files, sorted by name
+{
+    Result result = Result::Success;
+
+    for (uint32_t i = 0; (i < InFiles.size()) && (result == Result::Success); ++i)
+    {
+        const std::string& inFile = InFiles[i];
+        if (sys::fs::is_directory(inFile))
+        {
+            std::error_code errCode;
+            for (sys::fs::recursive_directory_iterator it(inFile, errCode), itEnd;
+                 (it != itEnd) && (!errCode);
+                 it.increment(errCode))
+            {
+                if (IsPipelineInfoFile(it->path()))
+                {
+                    pFiles->push_back(it->path());
+                }
+            }
+
+            if (errCode)
+            {
+                LLPC_ERRS("Failed to read directory " << inFile << ": " << errCode.message() << "\n");
+                result = Result::ErrorInvalidValue;
+            }
+        }
+        else if (IsPipelineInfoFile(inFile))
+        {
+            pFiles->push_back(inFile);
+        }
+        else
+        {
+            LLPC_ERRS(inFile << " is neither a directory nor a pipeline info file\n");
+            result = Result::ErrorInvalidValue;
+        }
+    }
+
+    // Sort the files so that runs over the same inputs write the cache file in the same order.
+    std::sort(pFiles->begin(), pFiles->end());
+
+    return result;
+}
+
+// =====================================================================================================================
+// Pre-warms the shader cache: compiles the pipeline info files of the inputs on multiple threads, skipping pipelines
+// whose cache hash has been seen already, then compacts the shader cache file so that it can be shipped.
+static Result PrewarmShaderCache(
+    ICompiler* pCompiler)   // [in] LLPC compiler object
+{
+    std::vector<std::string> files;
+    Result result = CollectPrewarmFiles(&files);
+
+    if (result == Result::Success)
+    {
+        // NOTE: As for any pipeline info file, we set the option -disable-null-frag-shader to FALSE unconditionally.
+        // This is done before the worker threads are started, as they must not modify options.
+        cl::DisableNullFragShader.setValue(false);
+
+        uint32_t threadCount = PrewarmThreads;
+        if (threadCount == 0)
+        {
+            threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        threadCount = std::max(std::min(threadCount, static_cast<uint32_t>(files.size())), 1u);
+
+        std::mutex                   lock;
+        std::unordered_set<uint64_t> pipelineHashes;
+        std::atomic<uint32_t>        nextFile(0);
+        std::atomic<uint32_t>        builtCount(0);
+        std::atomic<uint32_t>        duplicateCount(0);
+        std::atomic<uint32_t>        failedCount(0);
+
+        auto worker = [&]()
+        {
+            for (uint32_t i = nextFile++; i < files.size(); i = nextFile++)
+            {
+                bool duplicate = false;
+                if (PrewarmPipeline(pCompiler, files[i], &lock, &pipelineHashes, &duplicate) != Result::Success)
+                {
+                    LLPC_ERRS("Failed to pre-warm the shader cache with " << files[i] << "\n");
+                    ++failedCount;
+                }
+                else if (duplicate)
+                {
+                    ++duplicateCount;
+                }
+                else
+                {
+                    ++builtCount;
+                }
+            }
+        };
+
+        // The calling thread is one of the workers.
+        std::vector<std::thread> threads;
+        for (uint32_t i = 1; i < threadCount; ++i)
+        {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        outs() << "Pre-warmed shader cache with " << files.size() << " pipeline files on " << threadCount
+               << " threads: " << builtCount << " built, " << duplicateCount << " duplicates, "
+               << failedCount << " failed\n";
+
+        if (failedCount > 0)
+        {
+            result = Result::ErrorInvalidShader;
+        }
+
+        // Write one compacted cache file, without the records of shaders that were replaced while pre-warming.
+        Result compactResult = pCompiler->CompactShaderCache();
+        if (compactResult != Result::Success)
+        {
+            LLPC_ERRS("Failed to compact the shader cache file\n");
+            result = (result == Result::Success) ? compactResult : result;
+        }
+    }
+
+    return result;
+}
+
 #ifdef WIN_OS
 // =====================================================================================================================
 // Finds all filenames which can match input file name
@@ -1831,7 +2196,11 @@ int32_t main(
     }
 #endif
 
-    if (IsPipelineInfoFile(InFiles[0]) || IsLlvmIrFile(InFiles[0]))
+    if ((result == Result::Success) && Prewarm)
+    {
+        result = PrewarmShaderCache(pCompiler);
+    }
+    else if (IsPipelineInfoFile(InFiles[0]) || IsLlvmIrFile(InFiles[0]))
     {
         uint32_t nextFile = 0;
 
@@ -1915,6 +2284,11 @@ int32_t main(
         }
     }
 
+    if (EnableShaderCacheStats && (pCompiler != nullptr))
+    {
+        PrintShaderCacheStats(pCompiler);
+    }
+
     pCompiler->Destroy();
 
     if (result == Result::Success)
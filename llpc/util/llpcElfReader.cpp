@@ -30,6 +30,7 @@
  */
 #include <algorithm>
 #include <string.h>
+#include <type_traits>
 #include "llpcElfReader.h"
 
 #define DEBUG_TYPE "llpc-elf-reader"
@@ -151,6 +152,11 @@ Result ElfReader<Elf>::ReadFromBuffer(
     // Get section index
     m_symSecIdx    = GetSectionIndex(SymTabName);
     m_relocSecIdx  = GetSectionIndex(RelocName);
+    if (m_relocSecIdx < 0)
+    {
+        // Relocatable shader ELF from the LLVM back-end keeps its relocations in ".rela.text".
+        m_relocSecIdx = GetSectionIndex(RelaTextName);
+    }
     m_strtabSecIdx = GetSectionIndex(StrTabName);
     m_textSecIdx   = GetSectionIndex(TextName);
 
@@ -199,7 +205,8 @@ uint32_t ElfReader<Elf>::GetSymbolCount() const
 template<class Elf>
 void ElfReader<Elf>::GetSymbol(
     uint32_t   idx,       // Symbol index
-    ElfSymbol* pSymbol)   // [out] Info of the symbol
+    ElfSymbol* pSymbol    // [out] Info of the symbol
+    ) const
 {
     auto& pSection = m_sections[m_symSecIdx];
     const char* pStrTab = reinterpret_cast<const char*>(m_sections[m_strtabSecIdx]->pData);
@@ -216,7 +223,7 @@ void ElfReader<Elf>::GetSymbol(
 // =====================================================================================================================
 // Gets the count of relocations in the relocation section.
 template<class Elf>
-uint32_t ElfReader<Elf>::GetRelocationCount()
+uint32_t ElfReader<Elf>::GetRelocationCount() const
 {
     uint32_t relocCount = 0;
     if (m_relocSecIdx >= 0)
@@ -232,13 +239,25 @@ uint32_t ElfReader<Elf>::GetRelocationCount()
 template<class Elf>
 void ElfReader<Elf>::GetRelocation(
     uint32_t  idx,      // Relocation index
-    ElfReloc* pReloc)   // [out] Info of the relocation
+    ElfReloc* pReloc    // [out] Info of the relocation
+    ) const
 {
     auto& pSection = m_sections[m_relocSecIdx];
 
-    auto relocs = reinterpret_cast<const typename Elf::Reloc*>(pSection->pData);
-    pReloc->offset = relocs[idx].r_offset;
-    pReloc->symIdx = relocs[idx].r_symbol;
+    // NOTE: A relocation with explicit addend has the same layout as one without, followed by the addend, so the
+    // entry size of the section is used as the stride.
+    auto pRelocData = pSection->pData + idx * pSection->secHead.sh_entsize;
+    auto pEntry = reinterpret_cast<const typename Elf::Reloc*>(pRelocData);
+    pReloc->offset = pEntry->r_offset;
+    pReloc->symIdx = pEntry->r_symbol;
+    pReloc->type   = pEntry->r_type;
+    pReloc->addend = 0;
+
+    if (pSection->secHead.sh_entsize > sizeof(typename Elf::Reloc))
+    {
+        typedef typename std::make_signed<decltype(pEntry->r_offset)>::type Addend;
+        pReloc->addend = *reinterpret_cast<const Addend*>(pRelocData + sizeof(typename Elf::Reloc));
+    }
 }
 
 // =====================================================================================================================
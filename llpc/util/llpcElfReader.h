@@ -166,10 +166,14 @@ static const char   StrTabName[]       = ".strtab";    // Name of ".strtab" sect
 static const char   SymTabName[]       = ".symtab";    // Name of ".symtab" section
 static const char   NoteName[]         = ".note";      // Name of ".note" section
 static const char   RelocName[]        = ".reloc";     // Name of ".reloc" section
+static const char   RelaTextName[]     = ".rela.text"; // Name of ".rela.text" section
 static const char   CommentName[]      = ".comment";   // Name of ".comment" section
 
 static const uint32_t NT_AMD_AMDGPU_ISA = 11;          // Note type of AMDGPU ISA version
 
+static const uint32_t R_AMDGPU_ABS32_LO = 1;           // Relocation type of the low 32 bits of an absolute value
+static const uint32_t R_AMDGPU_ABS32    = 6;           // Relocation type of a 32-bit absolute value
+
 // Represents the layout of standard note header
 struct NoteHeader
 {
@@ -398,6 +402,8 @@ struct ElfReloc
 {
     uint64_t          offset;     // Location
     uint32_t          symIdx;     // Index of this symbol in the symbol table
+    uint32_t          type;       // Type of relocation
+    int64_t           addend;     // Constant addend (zero if the relocation has no explicit addend)
 };
 
 // Represents info of ELF note
@@ -469,7 +475,7 @@ public:
     bool IsSectionPresent(const char* pName) const { return (m_map.find(pName) != m_map.end()); }
 
     uint32_t GetSymbolCount() const;
-    void GetSymbol(uint32_t idx, ElfSymbol* pSymbol);
+    void GetSymbol(uint32_t idx, ElfSymbol* pSymbol) const;
 
     bool IsValidSymbol(const char* pSymbolName);
 
@@ -477,8 +483,8 @@ public:
 
     void GetSymbolsBySectionIndex(uint32_t secIndx, std::vector<ElfSymbol>& secSymbols) const;
 
-    uint32_t GetRelocationCount();
-    void GetRelocation(uint32_t idx, ElfReloc* pReloc);
+    uint32_t GetRelocationCount() const;
+    void GetRelocation(uint32_t idx, ElfReloc* pReloc) const;
 
     // Gets the section index for the specified section name.
     int32_t GetSectionIndex(const char* pName) const
@@ -34,6 +34,7 @@
 #include "llvm/BinaryFormat/MsgPackDocument.h"
 
 #include "llpcContext.h"
+#include "llpcDebug.h"
 #include "llpcElfWriter.h"
 
 #define DEBUG_TYPE "llpc-elf-writer"
@@ -1126,7 +1127,9 @@ Result ElfWriter<Elf>::LinkGraphicsRelocatableElf(
     Context* pContext)                                // [in] Acquired context
 {
     Reinitialize();
-    assert(relocatableElfs.size() == 2 && "Can only handle VsPs Shaders for now.");
+    // NOTE: The first ELF holds all pre-rasterization stages (including merged and NGG hardware stages), and the
+    // second one the fragment shader.
+    assert(relocatableElfs.size() == 2 && "Expected pre-rasterization and fragment shader ELFs.");
 
     // Get the main data for the header, the parts that change will be updated when writing to buffer.
     m_header = relocatableElfs[0]->m_header;
@@ -1165,7 +1168,8 @@ Result ElfWriter<Elf>::LinkGraphicsRelocatableElf(
     relocatableElfs[0]->GetSectionDataBySectionIndex(relocatableElfs[0]->m_symSecIdx, &pSymbolTableSection);
     m_sections[m_symSecIdx].secHead = pSymbolTableSection->secHead;
 
-    // Now get the symbols that belong in the symbol table.
+    // Now get the symbols that belong in the symbol table, and apply the relocations of each ELF to its code.
+    Result result = Result::Success;
     uint32_t offset = 0;
     for (const ElfReader<Elf>* pElf : relocatableElfs)
     {
@@ -1174,8 +1178,8 @@ Result ElfWriter<Elf>::LinkGraphicsRelocatableElf(
         pElf->GetSymbolsBySectionIndex(relocElfTextSectionId, symbols);
         for (auto sym : symbols)
         {
-            // When relocations start being used, we will have to filter out symbols related to relocations.
-            // We should be able to filter the BB* symbols as well.
+            // NOTE: The symbols of relocations are undefined, so they are not in the .text section and need no
+            // filtering. We should be able to filter the BB* symbols as well.
             ElfSymbol *pNewSym = GetSymbol(sym.pSymName);
             pNewSym->secIdx = m_textSecIdx;
             pNewSym->pSecName = nullptr;
@@ -1184,15 +1188,17 @@ Result ElfWriter<Elf>::LinkGraphicsRelocatableElf(
             pNewSym->info = sym.info;
         }
 
+        if (result == Result::Success)
+        {
+            result = ApplyRelocations(*pElf, offset, pContext);
+        }
+
         // Update the offset for the next elf file.
         ElfSectionBuffer<typename Elf::SectionHeader>* pTextSection = nullptr;
         pElf->GetSectionDataBySectionIndex(relocElfTextSectionId, &pTextSection);
         offset += alignTo(pTextSection->secHead.sh_size, 0x100);
     }
 
-    // Apply relocations
-    // There are no relocations to apply yet.
-
     // Set the .note section header
     ElfSectionBuffer<typename Elf::SectionHeader>* pNoteSection = nullptr;
     relocatableElfs[0]->GetSectionDataBySectionIndex(relocatableElfs[0]->GetSectionIndex(NoteName), &pNoteSection);
@@ -1207,7 +1213,7 @@ Result ElfWriter<Elf>::LinkGraphicsRelocatableElf(
 
     // Merge other sections.  For now, none of the other sections are important, so we will not do anything.
 
-    return Result::Success;
+    return result;
 }
 
 // =====================================================================================================================
@@ -1217,13 +1223,153 @@ Result ElfWriter<Elf>::LinkComputeRelocatableElf(
     const ElfReader<Elf>& relocatableElf,   // [in] Relocatable compute shader elf
     Context* pContext)                      // [in] Acquired context
 {
-    // Currently nothing to do, just copy the elf.
     CopyFromReader(relocatableElf);
 
-    // Apply relocations
-    // There are no relocations to apply yet.
+    // Drop the undefined symbols of relocations from the symbol table.
+    for (auto& symbol : m_symbols)
+    {
+        if (strncmp(symbol.pSymName, DescOffsetRelocPrefix, strlen(DescOffsetRelocPrefix)) == 0)
+        {
+            symbol.secIdx = InvalidValue;
+        }
+    }
+
+    return ApplyRelocations(relocatableElf, 0, pContext);
+}
+
+// =====================================================================================================================
+// Finds the resource node of the specified descriptor in the descriptor tables among the given resource mapping nodes,
+// including nested descriptor tables. Returns nullptr if there is no such node.
+static const ResourceMappingNode* FindDescriptorTableNode(
+    const ResourceMappingNode* pNodes,      // [in] Resource mapping nodes
+    uint32_t                   nodeCount,   // Count of resource mapping nodes
+    bool                       isTable,     // Whether the nodes are the contents of a descriptor table
+    uint32_t                   descSet,     // ID of descriptor set
+    uint32_t                   binding,     // ID of descriptor binding
+    uint32_t                   nodeType)    // Resource node type
+{
+    for (uint32_t i = 0; i < nodeCount; ++i)
+    {
+        const ResourceMappingNode& node = pNodes[i];
+        if (node.type == ResourceMappingNodeType::DescriptorTableVaPtr)
+        {
+            const ResourceMappingNode* pInnerNode = FindDescriptorTableNode(node.tablePtr.pNext,
+                                                                            node.tablePtr.nodeCount,
+                                                                            true,
+                                                                            descSet,
+                                                                            binding,
+                                                                            nodeType);
+            if (pInnerNode != nullptr)
+            {
+                return pInnerNode;
+            }
+        }
+        else if (isTable &&
+                 (static_cast<uint32_t>(node.type) == nodeType) &&
+                 (node.srdRange.set == descSet) &&
+                 (node.srdRange.binding == binding))
+        {
+            return &node;
+        }
+    }
+    return nullptr;
+}
 
-    return Result::Success;
+// =====================================================================================================================
+// Gets the value of a descriptor offset relocation symbol ("doff_<set>_<binding>_<type>") from the user data nodes of
+// the pipeline, that is the byte offset of the matching resource node in its descriptor table. The value is 0 if no
+// shader stage has such a resource node, the same offset as a descriptor that is not found when it is compiled.
+//
+// Returns false if the symbol is not a descriptor offset.
+template<class Elf>
+bool ElfWriter<Elf>::GetDescriptorOffsetRelocValue(
+    Context*    pContext,       // [in] Acquired context
+    const char* pSymbolName,    // [in] Name of the relocation symbol
+    uint32_t*   pValue)         // [out] Value of the relocation symbol
+{
+    const size_t prefixLen = strlen(DescOffsetRelocPrefix);
+    uint32_t descSet = 0;
+    uint32_t binding = 0;
+    uint32_t nodeType = 0;
+    if ((strncmp(pSymbolName, DescOffsetRelocPrefix, prefixLen) != 0) ||
+        (sscanf(pSymbolName + prefixLen, "%u_%u_%u", &descSet, &binding, &nodeType) != 3))
+    {
+        return false;
+    }
+
+    // Search the user data nodes of every shader stage, as a resource may be used by some stages only.
+    *pValue = 0;
+    const uint32_t stageMask = pContext->GetShaderStageMask();
+    for (uint32_t stage = 0; stage < ShaderStageCount; ++stage)
+    {
+        if ((stageMask & ShaderStageToMask(static_cast<ShaderStage>(stage))) == 0)
+        {
+            continue;
+        }
+
+        const PipelineShaderInfo* pShaderInfo = pContext->GetPipelineShaderInfo(static_cast<ShaderStage>(stage));
+        const ResourceMappingNode* pNode = FindDescriptorTableNode(pShaderInfo->pUserDataNodes,
+                                                                   pShaderInfo->userDataNodeCount,
+                                                                   false,
+                                                                   descSet,
+                                                                   binding,
+                                                                   nodeType);
+        if (pNode != nullptr)
+        {
+            *pValue = pNode->offsetInDwords * sizeof(uint32_t);
+            break;
+        }
+    }
+
+    return true;
+}
+
+// =====================================================================================================================
+// Applies the relocations of a relocatable ELF to its code, which has been placed at the given offset of the .text
+// section of this ELF.
+template<class Elf>
+Result ElfWriter<Elf>::ApplyRelocations(
+    const ElfReader<Elf>& reader,       // [in] Relocatable ELF
+    uint64_t              textOffset,   // Byte offset of the code of the relocatable ELF in the .text section
+    Context*              pContext)     // [in] Acquired context
+{
+    Result result = Result::Success;
+
+    // NOTE: The .text section data is owned by this writer, so it can be patched in place.
+    auto pTextSection = &m_sections[m_textSecIdx];
+    auto pTextData = const_cast<uint8_t*>(pTextSection->pData);
+
+    const uint32_t relocCount = reader.GetRelocationCount();
+    for (uint32_t i = 0; (i < relocCount) && (result == Result::Success); ++i)
+    {
+        ElfReloc reloc = {};
+        reader.GetRelocation(i, &reloc);
+        ElfSymbol relocSymbol = {};
+        reader.GetSymbol(reloc.symIdx, &relocSymbol);
+
+        uint32_t value = 0;
+        if ((reloc.type != R_AMDGPU_ABS32_LO) && (reloc.type != R_AMDGPU_ABS32))
+        {
+            LLPC_ERRS("Unsupported relocation type " << reloc.type << " in relocatable shader ELF: " <<
+                      relocSymbol.pSymName << "\n");
+            result = Result::ErrorInvalidShader;
+        }
+        else if (GetDescriptorOffsetRelocValue(pContext, relocSymbol.pSymName, &value))
+        {
+            // All relocations of descriptor offsets are 32-bit absolute values.
+            const uint64_t relocOffset = textOffset + reloc.offset;
+            assert(relocOffset + sizeof(uint32_t) <= pTextSection->secHead.sh_size);
+            value += static_cast<uint32_t>(reloc.addend);
+            memcpy(pTextData + relocOffset, &value, sizeof(value));
+        }
+        else
+        {
+            LLPC_ERRS("Unresolved relocation in relocatable shader ELF: " << relocSymbol.pSymName << "\n");
+            result = Result::ErrorInvalidShader;
+        }
+    }
+
+    return result;
 }
 
 template class ElfWriter<Elf64>;
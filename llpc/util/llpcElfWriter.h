@@ -121,6 +121,10 @@ private:
 
     void Reinitialize();
 
+    static bool GetDescriptorOffsetRelocValue(Context* pContext, const char* pSymbolName, uint32_t* pValue);
+
+    Result ApplyRelocations(const ElfReader<Elf>& reader, uint64_t textOffset, Context* pContext);
+
     // -----------------------------------------------------------------------------------------------------------------
 
     GfxIpVersion                      m_gfxIp;    // Graphics IP version info (used by ELF dump only)
@@ -32,6 +32,11 @@
 #include <cassert>
 #include <stdarg.h>
 #include <sys/stat.h>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 #define DEBUG_TYPE "llpc-file"
 
@@ -350,6 +355,30 @@ Result File::Flush() const
     return result;
 }
 
+// =====================================================================================================================
+// Flushes pending I/O to the file, and waits for the file data to reach the storage device.
+Result File::Sync() const
+{
+    Result result = Result::Success;
+
+    if (m_pFileHandle == nullptr)
+    {
+        result = Result::ErrorUnavailable;
+    }
+    else
+    {
+        fflush(m_pFileHandle);
+#if defined(_WIN32)
+        const bool synced = (_commit(_fileno(m_pFileHandle)) == 0);
+#else
+        const bool synced = (fsync(fileno(m_pFileHandle)) == 0);
+#endif
+        result = synced ? Result::Success : Result::ErrorUnknown;
+    }
+
+    return result;
+}
+
 // =====================================================================================================================
 // Sets the file position to the beginning of the file.
 void File::Rewind()
@@ -361,15 +390,19 @@ void File::Rewind()
 }
 
 // =====================================================================================================================
-// Sets the file position to the beginning of the file.
+// Sets the file position. The offset is 64-bit, so positions beyond 2GB can be reached on all platforms.
 void File::Seek(
-    int32_t offset,         // Number of bytes to offset
+    int64_t offset,         // Number of bytes to offset
     bool   fromOrigin)      // If true, the seek will be relative to the file origin;
                             // if false, it will be from the current position
 {
     if (m_pFileHandle != nullptr)
     {
-        int32_t ret = fseek(m_pFileHandle, offset, fromOrigin ? SEEK_SET : SEEK_CUR);
+#if defined(_WIN32)
+        int32_t ret = _fseeki64(m_pFileHandle, offset, fromOrigin ? SEEK_SET : SEEK_CUR);
+#else
+        int32_t ret = fseeko(m_pFileHandle, offset, fromOrigin ? SEEK_SET : SEEK_CUR);
+#endif
 
         assert(ret == 0);
         (void(ret)); // unused
@@ -377,15 +410,36 @@ void File::Seek(
 }
 
 // =====================================================================================================================
-// Returns true if a file with the given name exists.
+// Truncates the file to the specified size. Pending output is flushed first.
+Result File::Truncate(
+    uint64_t size)          // New size of the file in bytes
+{
+    Result result = Result::ErrorUnavailable;
+
+    if (m_pFileHandle != nullptr)
+    {
+        fflush(m_pFileHandle);
+#if defined(_WIN32)
+        const bool truncated = (_chsize_s(_fileno(m_pFileHandle), size) == 0);
+#else
+        const bool truncated = (ftruncate(fileno(m_pFileHandle), size) == 0);
+#endif
+        result = truncated ? Result::Success : Result::ErrorUnknown;
+    }
+
+    return result;
+}
+
+// =====================================================================================================================
+// Returns the size of the file with the given name, or 0 if it does not exist.
 size_t File::GetFileSize(
     const char* pFilename)     // [in] Name of the file to check
 {
 #if defined(_WIN32)
     // On MS compilers the function and structure to retrieve/store file status information is named '_stat' (with
-    // underbar)...
-    struct _stat fileStatus = { };
-    const int32_t result = _stat(pFilename, &fileStatus);
+    // underbar). The 64-bit variant is used, so that the size of files beyond 2GB is correct...
+    struct _stat64 fileStatus = { };
+    const int32_t result = _stat64(pFilename, &fileStatus);
 #else
     // ...however, on other compilers, they are named 'stat' (no underbar).
     struct stat fileStatus = {};
@@ -68,8 +68,10 @@ public:
     Result Printf(const char* pFormatStr, ...) const;
     Result VPrintf(const char* pFormatStr, va_list argList);
     Result Flush() const;
+    Result Sync() const;
     void Rewind();
-    void Seek(int32_t offset, bool fromOrigin);
+    void Seek(int64_t offset, bool fromOrigin);
+    Result Truncate(uint64_t size);
 
     // Returns true if the file is presently open.
     bool IsOpen() const { return (m_pFileHandle != nullptr); }
@@ -44,6 +44,7 @@
 
 #include "llpcBuilderBase.h"
 #include "llpcInternal.h"
+#include "llpcMetroHash.h"
 
 #define DEBUG_TYPE "llpc-internal"
 
@@ -200,6 +201,59 @@ ShaderStage GetShaderStageFromFunction(
     return ShaderStageInvalid;
 }
 
+// =====================================================================================================================
+// Gets the inter-shader data tracking hash of the specified shader entry-point. Returns false if the shader has not
+// been given a hash, for example an internally generated shader. Any value, including 0, is a valid hash.
+bool GetShaderHash(
+    const Function* pFunc,  // [in] Shader entry-point
+    uint64_t*       pHash)  // [out] Hash value
+{
+    MDNode* pHashMetaNode = pFunc->getMetadata(LlpcName::ShaderHashMetadata);
+    if (pHashMetaNode == nullptr)
+    {
+        return false;
+    }
+    *pHash = mdconst::dyn_extract<ConstantInt>(pHashMetaNode->getOperand(0))->getZExtValue();
+    return true;
+}
+
+// =====================================================================================================================
+// Sets the inter-shader data tracking hash of the specified shader entry-point.
+//
+// The front-end initializes it with the input hash of the shader. It is kept as metadata on the entry-point so that
+// it is carried through linking and through passes that clone the entry-point.
+void SetShaderHash(
+    Function* pFunc,    // [in/out] Shader entry-point
+    uint64_t  hash)     // Hash value
+{
+    auto pHashValue = ConstantInt::get(Type::getInt64Ty(pFunc->getContext()), hash);
+    pFunc->setMetadata(LlpcName::ShaderHashMetadata,
+                       MDNode::get(pFunc->getContext(), { ConstantAsMetadata::get(pHashValue) }));
+}
+
+// =====================================================================================================================
+// Folds data obtained from other shaders into the inter-shader data tracking hash of the specified shader entry-point,
+// i.e. computes h_new = h(h_old | data). A pass that makes a decision for one shader based on data from another shader
+// must call this with that data, so the per-stage shader cache key of the shader reflects it.
+void UpdateShaderHash(
+    Function*         pFunc,    // [in/out] Shader entry-point
+    ArrayRef<uint8_t> data)     // [in] Inter-shader data used in compiling the shader
+{
+    // NOTE: A shader without a hash is not checked against the per-stage shader cache, so it is not given one here.
+    uint64_t hash = 0;
+    if (GetShaderHash(pFunc, &hash) == false)
+    {
+        return;
+    }
+
+    MetroHash::MetroHash64 hasher;
+    hasher.Update(hash);
+    hasher.Update(data.data(), data.size());
+
+    hasher.Finalize(reinterpret_cast<uint8_t*>(&hash));
+    SetShaderHash(pFunc, hash);
+}
+
 // =====================================================================================================================
 // Gets the shader stage from the specified calling convention.
 ShaderStage GetShaderStageFromCallingConv(
@@ -145,6 +145,7 @@ namespace LlpcName
     const static char NullFsEntryPoint[]              = "llpc.shader.FS.null.main";
 
     const static char ShaderStageMetadata[]           = "llpc.shaderstage";
+    const static char ShaderHashMetadata[]            = "llpc.hash";
 } // LlpcName
 
 // Well-known metadata names
@@ -172,6 +173,9 @@ static const uint32_t DescRelocMagic        = 0xA5A5A500;
 static const uint32_t DescRelocMagicMask    = 0xFFFFFF00;
 static const uint32_t DescSetMask           = 0x000000FF;
 
+// Prefix of the relocation symbols of descriptor offsets in relocatable shader ELF
+static const char DescOffsetRelocPrefix[] = "doff_";
+
 // Internal resource table's virtual bindings
 static const uint32_t SI_DRV_TABLE_SCRATCH_GFX_SRD_OFFS = 0;
 static const uint32_t SI_DRV_TABLE_SCRATCH_CS_SRD_OFFS  = 1;
@@ -218,6 +222,15 @@ std::string GetTypeName(llvm::Type* pTy);
 // Gets the shader stage from the specified LLVM function.
 ShaderStage GetShaderStageFromFunction(const llvm::Function* pFunc);
 
+// Gets the inter-shader data tracking hash of the specified shader entry-point, returning false if it has none.
+bool GetShaderHash(const llvm::Function* pFunc, uint64_t* pHash);
+
+// Sets the inter-shader data tracking hash of the specified shader entry-point.
+void SetShaderHash(llvm::Function* pFunc, uint64_t hash);
+
+// Folds data obtained from other shaders into the inter-shader data tracking hash of the specified shader entry-point.
+void UpdateShaderHash(llvm::Function* pFunc, llvm::ArrayRef<uint8_t> data);
+
 // Gets the shader stage from the specified calling convention.
 ShaderStage GetShaderStageFromCallingConv(uint32_t stageMask, llvm::CallingConv::ID callConv);
 
@@ -42,6 +42,7 @@
 #include "llpcDebug.h"
 #include "llpcElfReader.h"
 #include "llpcPipelineDumper.h"
+#include "llpcShaderModuleHelper.h"
 #include "llpcUtil.h"
 
 #define DEBUG_TYPE "llpc-pipeline-dumper"
@@ -241,6 +242,90 @@ uint64_t VKAPI_CALL IPipelineDumper::GetPipelineHash(
     return MetroHash::Compact64(&hash);
 }
 
+// =====================================================================================================================
+// Fills in the cache hash code of stand-in shader module data for a shader binary, as building its shader module would,
+// so that the cache hash code of a pipeline can be calculated without building its shader modules.
+static void InitShaderModuleCacheHash(
+    const BinaryData* pShaderBin,       // [in] Shader binary
+    bool              trimDebugInfo,    // Whether debug instructions are trimmed from the cached shader binary
+    ShaderModuleData* pModuleData)      // [out] Stand-in shader module data
+{
+    *pModuleData = {};
+
+    // NOTE: Only a SPIR-V binary has a cache hash code. An invalid binary is still hashed; building its shader module
+    // reports the error.
+    if ((pShaderBin->codeSize > 0) && ShaderModuleHelper::IsSpirvBinary(pShaderBin))
+    {
+        ShaderModuleUsage            usage = {};
+        std::vector<ShaderEntryName> entryNames;
+        uint32_t                     codeSize = 0;
+        MetroHash::Hash              hash = {};
+        MetroHash::Hash              cacheHash = {};
+
+        ShaderModuleHelper::ScanSpirvBinary(pShaderBin,
+                                            &usage,
+                                            entryNames,
+                                            trimDebugInfo,
+                                            nullptr,
+                                            &codeSize,
+                                            &hash,
+                                            &cacheHash);
+
+        memcpy(pModuleData->hash, &hash, sizeof(hash));
+        memcpy(pModuleData->cacheHash, cacheHash.dwords, sizeof(cacheHash));
+    }
+}
+
+// =====================================================================================================================
+// Calculates the hash code that the shader cache keys a graphics pipeline by, from the shader binaries of its stages.
+uint64_t VKAPI_CALL IPipelineDumper::GetPipelineCacheHash(
+    const GraphicsPipelineBuildInfo* pPipelineInfo, // [in] Info to build this graphics pipeline
+    const BinaryData*                pShaderBins,   // [in] Shader binaries, indexed by graphics shader stage
+    bool                             trimDebugInfo) // Whether debug instructions are trimmed from cached shaders
+{
+    GraphicsPipelineBuildInfo pipelineInfo = *pPipelineInfo;
+    PipelineShaderInfo* shaderInfo[ShaderStageGfxCount] =
+    {
+        &pipelineInfo.vs,
+        &pipelineInfo.tcs,
+        &pipelineInfo.tes,
+        &pipelineInfo.gs,
+        &pipelineInfo.fs,
+    };
+
+    ShaderModuleData moduleData[ShaderStageGfxCount] = {};
+    for (uint32_t stage = 0; stage < ShaderStageGfxCount; ++stage)
+    {
+        shaderInfo[stage]->pModuleData = nullptr;
+        if (pShaderBins[stage].codeSize > 0)
+        {
+            InitShaderModuleCacheHash(&pShaderBins[stage], trimDebugInfo, &moduleData[stage]);
+            shaderInfo[stage]->pModuleData = &moduleData[stage];
+        }
+    }
+
+    auto hash = PipelineDumper::GenerateHashForGraphicsPipeline(&pipelineInfo, true);
+    return MetroHash::Compact64(&hash);
+}
+
+// =====================================================================================================================
+// Calculates the hash code that the shader cache keys a compute pipeline by, from the shader binary of its compute
+// shader.
+uint64_t VKAPI_CALL IPipelineDumper::GetPipelineCacheHash(
+    const ComputePipelineBuildInfo* pPipelineInfo,  // [in] Info to build this compute pipeline
+    const BinaryData*               pShaderBin,     // [in] Compute shader binary
+    bool                            trimDebugInfo)  // Whether debug instructions are trimmed from cached shaders
+{
+    ComputePipelineBuildInfo pipelineInfo = *pPipelineInfo;
+
+    ShaderModuleData moduleData = {};
+    InitShaderModuleCacheHash(pShaderBin, trimDebugInfo, &moduleData);
+    pipelineInfo.cs.pModuleData = &moduleData;
+
+    auto hash = PipelineDumper::GenerateHashForComputePipeline(&pipelineInfo, true);
+    return MetroHash::Compact64(&hash);
+}
+
 // =====================================================================================================================
 // Gets the file name of SPIR-V binary according the specified shader hash.
 std::string PipelineDumper::GetSpirvBinaryFileName(
@@ -872,27 +957,52 @@ void PipelineDumper::DumpGraphicsPipelineInfo(
 MetroHash::Hash PipelineDumper::GenerateHashForGraphicsPipeline(
     const GraphicsPipelineBuildInfo* pPipeline,   // [in] Info to build a graphics pipeline
     bool                            isCacheHash,  // TRUE if the hash is used by shader cache
-    uint32_t                        stage)        // [in] The stage for which we are building the hash.
+    uint32_t                        stage,        // [in] The stage for which we are building the hash.
                                                   // ShaderStageInvalid if building for the entire pipeline.
+    bool                            genericColorExport) // Whether a relocatable fragment shader is built with generic
+                                                        // color export
 {
     MetroHash64 hasher;
 
+    // NOTE: The cache hash of a single stage is the key of a relocatable shader ELF.
+    const bool isRelocatableShader = isCacheHash && (stage != ShaderStageInvalid);
+
     switch (stage)
     {
         case ShaderStageVertex:
-            UpdateHashForPipelineShaderInfo(ShaderStageVertex, &pPipeline->vs, isCacheHash, &hasher);
+            UpdateHashForPipelineShaderInfo(ShaderStageVertex,
+                                            &pPipeline->vs,
+                                            isCacheHash,
+                                            &hasher,
+                                            isRelocatableShader);
             break;
         case ShaderStageTessControl:
-            UpdateHashForPipelineShaderInfo(ShaderStageTessControl, &pPipeline->tcs, isCacheHash, &hasher);
+            UpdateHashForPipelineShaderInfo(ShaderStageTessControl,
+                                            &pPipeline->tcs,
+                                            isCacheHash,
+                                            &hasher,
+                                            isRelocatableShader);
             break;
         case ShaderStageTessEval:
-            UpdateHashForPipelineShaderInfo(ShaderStageTessEval, &pPipeline->tes, isCacheHash, &hasher);
+            UpdateHashForPipelineShaderInfo(ShaderStageTessEval,
+                                            &pPipeline->tes,
+                                            isCacheHash,
+                                            &hasher,
+                                            isRelocatableShader);
             break;
         case ShaderStageGeometry:
-            UpdateHashForPipelineShaderInfo(ShaderStageGeometry, &pPipeline->gs, isCacheHash, &hasher);
+            UpdateHashForPipelineShaderInfo(ShaderStageGeometry,
+                                            &pPipeline->gs,
+                                            isCacheHash,
+                                            &hasher,
+                                            isRelocatableShader);
             break;
         case ShaderStageFragment:
-            UpdateHashForPipelineShaderInfo(ShaderStageFragment, &pPipeline->fs, isCacheHash, &hasher);
+            UpdateHashForPipelineShaderInfo(ShaderStageFragment,
+                                            &pPipeline->fs,
+                                            isCacheHash,
+                                            &hasher,
+                                            isRelocatableShader);
             break;
         case ShaderStageInvalid:
             UpdateHashForPipelineShaderInfo(ShaderStageVertex, &pPipeline->vs, isCacheHash, &hasher);
@@ -916,7 +1026,8 @@ MetroHash::Hash PipelineDumper::GenerateHashForGraphicsPipeline(
 
     if (stage == ShaderStageFragment || stage == ShaderStageInvalid)
     {
-        UpdateHashForFragmentState(pPipeline, &hasher);
+        // NOTE: A relocatable fragment shader with generic color export does not depend on the color target formats.
+        UpdateHashForFragmentState(pPipeline, isRelocatableShader && genericColorExport, &hasher);
     }
 
     MetroHash::Hash hash = {};
@@ -928,13 +1039,13 @@ MetroHash::Hash PipelineDumper::GenerateHashForGraphicsPipeline(
 // =====================================================================================================================
 // Builds hash code from compute pipline build info.
 MetroHash::Hash PipelineDumper::GenerateHashForComputePipeline(
-    const ComputePipelineBuildInfo* pPipeline,   // [in] Info to build a compute pipeline
-    bool                            isCacheHash  // TRUE if the hash is used by shader cache
-    )
+    const ComputePipelineBuildInfo* pPipeline,            // [in] Info to build a compute pipeline
+    bool                            isCacheHash,          // TRUE if the hash is used by shader cache
+    bool                            isRelocatableShader)  // TRUE if the hash is the key of a relocatable shader ELF
 {
     MetroHash64 hasher;
 
-    UpdateHashForPipelineShaderInfo(ShaderStageCompute, &pPipeline->cs, isCacheHash, &hasher);
+    UpdateHashForPipelineShaderInfo(ShaderStageCompute, &pPipeline->cs, isCacheHash, &hasher, isRelocatableShader);
     hasher.Update(pPipeline->deviceIndex);
     hasher.Update(pPipeline->options.includeDisassembly);
     hasher.Update(pPipeline->options.scalarBlockLayout);
@@ -1052,8 +1163,10 @@ void PipelineDumper::UpdateHashForNonFragmentState(
 // =====================================================================================================================
 // Update hash code from fragment pipeline state
 void PipelineDumper::UpdateHashForFragmentState(
-    const GraphicsPipelineBuildInfo* pPipeline,     // [in] Info to build a graphics pipeline
-    MetroHash64*                     pHasher)       // [in,out] Hasher to generate hash code
+    const GraphicsPipelineBuildInfo* pPipeline,             // [in] Info to build a graphics pipeline
+    bool                             genericColorExport,    // TRUE if color outputs are exported regardless of the
+                                                            //  color target formats
+    MetroHash64*                     pHasher)               // [in,out] Hasher to generate hash code
 {
     auto pRsState = &pPipeline->rsState;
     pHasher->Update(pRsState->innerCoverage);
@@ -1064,7 +1177,7 @@ void PipelineDumper::UpdateHashForFragmentState(
     auto pCbState = &pPipeline->cbState;
     pHasher->Update(pCbState->alphaToCoverageEnable);
     pHasher->Update(pCbState->dualSourceBlendEnable);
-    for (uint32_t i = 0; i < MaxColorTargets; ++i)
+    for (uint32_t i = 0; (i < MaxColorTargets) && (genericColorExport == false); ++i)
     {
         if (pCbState->target[i].format != VK_FORMAT_UNDEFINED)
         {
@@ -1081,9 +1194,9 @@ void PipelineDumper::UpdateHashForFragmentState(
 void PipelineDumper::UpdateHashForPipelineShaderInfo(
     ShaderStage               stage,           // shader stage
     const PipelineShaderInfo* pShaderInfo,     // [in] Shader info in specified shader stage
-    bool                      isCacheHash,     // TRUE if the hash is used by shader cache
-    MetroHash64*              pHasher          // [in,out] Haher to generate hash code
-    )
+    bool                      isCacheHash,          // TRUE if the hash is used by shader cache
+    MetroHash64*              pHasher,              // [in,out] Haher to generate hash code
+    bool                      isRelocatableShader)  // TRUE if the hash is the key of a relocatable shader ELF
 {
     if (pShaderInfo->pModuleData)
     {
@@ -1153,7 +1266,7 @@ void PipelineDumper::UpdateHashForPipelineShaderInfo(
             for (uint32_t i = 0; i < pShaderInfo->userDataNodeCount; ++i)
             {
                 auto pUserDataNode = &pShaderInfo->pUserDataNodes[i];
-                UpdateHashForResourceMappingNode(pUserDataNode, true, pHasher);
+                UpdateHashForResourceMappingNode(pUserDataNode, true, pHasher, isRelocatableShader);
             }
         }
 
@@ -1192,13 +1305,21 @@ void PipelineDumper::UpdateHashForPipelineShaderInfo(
 // NOTE: This function will be called recusively if node's type is "DescriptorTableVaPtr"
 void PipelineDumper::UpdateHashForResourceMappingNode(
     const ResourceMappingNode* pUserDataNode,    // [in] Resource mapping node
-    bool                       isRootNode,       // TRUE if the node is in root level
-    MetroHash64*               pHasher           // [in,out] Haher to generate hash code
-    )
+    bool                       isRootNode,           // TRUE if the node is in root level
+    MetroHash64*               pHasher,              // [in,out] Haher to generate hash code
+    bool                       isRelocatableShader)  // TRUE if the hash is the key of a relocatable shader ELF
 {
     pHasher->Update(pUserDataNode->type);
     pHasher->Update(pUserDataNode->sizeInDwords);
-    pHasher->Update(pUserDataNode->offsetInDwords);
+
+    // NOTE: The offsets of descriptors in descriptor tables are relocations in a relocatable shader ELF, resolved
+    // when it is linked into a pipeline, so they are left out of its key.
+    if (isRootNode ||
+        (isRelocatableShader == false) ||
+        (pUserDataNode->type == ResourceMappingNodeType::DescriptorYCbCrSampler))
+    {
+        pHasher->Update(pUserDataNode->offsetInDwords);
+    }
 
     switch (pUserDataNode->type)
     {
@@ -1218,7 +1339,10 @@ void PipelineDumper::UpdateHashForResourceMappingNode(
         {
             for (uint32_t i = 0; i < pUserDataNode->tablePtr.nodeCount; ++i)
             {
-                UpdateHashForResourceMappingNode(&pUserDataNode->tablePtr.pNext[i], false, pHasher);
+                UpdateHashForResourceMappingNode(&pUserDataNode->tablePtr.pNext[i],
+                                                 false,
+                                                 pHasher,
+                                                 isRelocatableShader);
             }
             break;
         }
@@ -1528,9 +1652,9 @@ OStream& operator<<(
                 assert(offset <= pSection->secHead.sh_size);
             }
         }
-        else if (strcmp(pSection->pName, RelocName) == 0)
+        else if ((strcmp(pSection->pName, RelocName) == 0) || (strcmp(pSection->pName, RelaTextName) == 0))
         {
-            // Output .reloc section
+            // Output .reloc or .rela.text section
             out << pSection->pName << " (size = " << pSection->secHead.sh_size << " bytes)\n";
             const uint32_t relocCount = reader.GetRelocationCount();
             for (uint32_t i = 0; i < relocCount; ++i)
@@ -1542,7 +1666,7 @@ OStream& operator<<(
                 auto length = snprintf(formatBuf, sizeof(formatBuf), "    %-35s", elfSym.pSymName);
                 (void(length)); // unused
                 out << "#" << i << "    " << formatBuf
-                    << "    offset = " << reloc.offset << "\n";
+                    << "    offset = " << reloc.offset << "    addend = " << reloc.addend << "\n";
             }
         }
         else if (strncmp(pSection->pName, AmdGpuConfigName, sizeof(AmdGpuConfigName) - 1) == 0)
@@ -83,9 +83,12 @@ public:
 
     static MetroHash::Hash GenerateHashForGraphicsPipeline(const GraphicsPipelineBuildInfo* pPipeline,
                                                            bool                             isCacheHash,
-                                                           uint32_t                         stage = ShaderStageInvalid);
+                                                           uint32_t                         stage = ShaderStageInvalid,
+                                                           bool                             genericColorExport = false);
 
-    static MetroHash::Hash GenerateHashForComputePipeline(const ComputePipelineBuildInfo* pPipeline, bool isCacheHash);
+    static MetroHash::Hash GenerateHashForComputePipeline(const ComputePipelineBuildInfo* pPipeline,
+                                                          bool                            isCacheHash,
+                                                          bool                            isRelocatableShader = false);
 
     static std::string GetPipelineInfoFileName(PipelineBuildInfo                pipelineInfo,
                                                const MetroHash::Hash*           pHash);
@@ -94,10 +97,11 @@ public:
                                                 const PipelineShaderInfo* pShaderInfo,
                                                 bool                      isCacheHash,
 #if defined(SINGLE_EXTERNAL_METROHASH)
-                                                Util::MetroHash64*        pHasher);
+                                                Util::MetroHash64*        pHasher,
 #else
-                                                MetroHash::MetroHash64*   pHasher);
+                                                MetroHash::MetroHash64*   pHasher,
 #endif
+                                                bool                      isRelocatableShader = false);
 
     static void UpdateHashForVertexInputState(const VkPipelineVertexInputStateCreateInfo* pVertexInput,
 #if defined(SINGLE_EXTERNAL_METROHASH)
@@ -133,6 +137,7 @@ public:
 
     static void UpdateHashForFragmentState(
         const GraphicsPipelineBuildInfo* pPipeline,
+        bool                             genericColorExport,
 #if defined(SINGLE_EXTERNAL_METROHASH)
         Util::MetroHash64*               pHasher);
 #else
@@ -166,10 +171,11 @@ private:
     static void UpdateHashForResourceMappingNode(const ResourceMappingNode* pUserDataNode,
                                                  bool                       isRootNode,
 #if defined(SINGLE_EXTERNAL_METROHASH)
-                                                 Util::MetroHash64*         pHasher);
+                                                 Util::MetroHash64*         pHasher,
 #else
-                                                 MetroHash::MetroHash64*    pHasher);
+                                                 MetroHash::MetroHash64*    pHasher,
 #endif
+                                                 bool                       isRelocatableShader = false);
 };
 
 } // Llpc
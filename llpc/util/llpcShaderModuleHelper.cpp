@@ -32,40 +32,104 @@
 #include "llpcDebug.h"
 #include "llpcUtil.h"
 #include "spirvExt.h"
-#include <unordered_set>
-#include <set>
+#include <bitset>
 
 #include "llvm/Support/raw_ostream.h"
 using namespace llvm;
+using namespace MetroHash;
 
 using namespace spv;
 
 namespace Llpc
 {
 // =====================================================================================================================
-// Collect information from SPIR-V binary
-Result ShaderModuleHelper::CollectInfoFromSpirvBinary(
-    const BinaryData*                pSpvBinCode,           // [in] SPIR-V binary data
-    ShaderModuleUsage*               pShaderModuleUsage,    // [out] Shader module usage info
-    std::vector<ShaderEntryName>&    shaderEntryNames,      // [out] Entry names for this shader module
-    uint32_t*                        pDebugInfoSize)        // Debug info size
+// Gets the set of SPIR-V opcodes that are supported by the SPIR-V reader, indexed by opcode.
+static const std::bitset<OpCodeMask + 1>& GetSupportedSpirvOpCodes()
 {
-    Result result = Result::Success;
+    static const std::bitset<OpCodeMask + 1> OpCodes = []()
+    {
+#define _SPIRV_OP(x,...) Op##x,
+        static const Op OpList[] =
+        {
+            #include "SPIRVOpCodeEnum.h"
+        };
+#undef _SPIRV_OP
+        std::bitset<OpCodeMask + 1> opCodes;
+        for (Op opCode : OpList)
+        {
+            opCodes.set(opCode & OpCodeMask);
+        }
+        return opCodes;
+    }();
+
+    return OpCodes;
+}
+
+// =====================================================================================================================
+// Scans the SPIR-V binary in a single pass: verifies that it is valid and supported, collects shader module usage and
+// entry-point names, optionally trims debug instructions, and calculates the hash codes of the original and of the
+// trimmed binary. The trimmed binary is only copied out if a buffer is given for it.
+//
+// NOTE: Hashing and copying are done in chunks as the scan goes, so that each part of the binary is read from memory
+// only once while it is still in cache.
+Result ShaderModuleHelper::ScanSpirvBinary(
+    const BinaryData*             pSpvBin,              // [in] SPIR-V binary
+    ShaderModuleUsage*            pShaderModuleUsage,   // [out] Shader module usage info
+    std::vector<ShaderEntryName>& shaderEntryNames,     // [out] Entry names for this shader module
+    bool                          trimDebugInfo,        // Whether to trim debug instructions
+    void*                         pTrimSpvBin,          // [out] Buffer (at least as large as the SPIR-V binary) that
+                                                        //       receives the binary without debug instructions
+                                                        //       (optional)
+    uint32_t*                     pTrimSize,            // [out] Byte size of the (possibly trimmed) SPIR-V binary
+    MetroHash::Hash*              pHash,                // [out] Hash code of the SPIR-V binary
+    MetroHash::Hash*              pTrimHash)            // [out] Hash code of the (possibly trimmed) SPIR-V binary
+{
+    // Maximum number of pending words before they are hashed and copied out
+    static const size_t MaxPendingWordCount = 1024;
 
-    const uint32_t* pCode = reinterpret_cast<const uint32_t*>(pSpvBinCode->pCode);
-    const uint32_t* pEnd = pCode + pSpvBinCode->codeSize / sizeof(uint32_t);
+    Result result = Result::Success;
+    const std::bitset<OpCodeMask + 1>& supportedOpCodes = GetSupportedSpirvOpCodes();
 
+    const uint32_t* pCode = reinterpret_cast<const uint32_t*>(pSpvBin->pCode);
+    const uint32_t* pEnd = pCode + pSpvBin->codeSize / sizeof(uint32_t);
     const uint32_t* pCodePos = pCode + sizeof(SpirvHeader) / sizeof(uint32_t);
 
-    // Parse SPIR-V instructions
-    std::unordered_set<uint32_t> capabilities;
+    // Start of the scanned words that have not been hashed and copied out yet. These never include debug instructions
+    // when trimming.
+    const uint32_t* pPending = pCode;
+    uint32_t* pTrimCodePos = reinterpret_cast<uint32_t*>(pTrimSpvBin);
+    size_t trimWordCount = 0;
+
+    MetroHash64 hasher;
+    MetroHash64 trimHasher;
+
+    // Hashes and copies out the pending words up to the specified position.
+    auto flushPending = [&](const uint32_t* pFlushEnd)
+    {
+        const size_t byteSize = (pFlushEnd - pPending) * sizeof(uint32_t);
+        hasher.Update(reinterpret_cast<const uint8_t*>(pPending), byteSize);
+        if (trimDebugInfo)
+        {
+            trimHasher.Update(reinterpret_cast<const uint8_t*>(pPending), byteSize);
+            if (pTrimCodePos != nullptr)
+            {
+                memcpy(pTrimCodePos, pPending, byteSize);
+                pTrimCodePos += pFlushEnd - pPending;
+            }
+            trimWordCount += pFlushEnd - pPending;
+        }
+        pPending = pFlushEnd;
+    };
+
+    bool useVarPtrStorageBuf = false;
+    bool useVarPtr = false;
 
     while (pCodePos < pEnd)
     {
         uint32_t opCode = (pCodePos[0] & OpCodeMask);
         uint32_t wordCount = (pCodePos[0] >> WordCountShift);
 
-        if ((wordCount == 0) || (pCodePos + wordCount > pEnd))
+        if ((wordCount == 0) || (pCodePos + wordCount > pEnd) || (supportedOpCodes[opCode] == false))
         {
             LLPC_ERRS("Invalid SPIR-V binary\n");
             result = Result::ErrorInvalidShader;
@@ -73,13 +137,15 @@ Result ShaderModuleHelper::CollectInfoFromSpirvBinary(
         }
 
         // Parse each instruction and find those we are interested in
+        bool isDebugInst = false;
         switch (opCode)
         {
         case OpCapability:
             {
                 assert(wordCount == 2);
                 auto capability = static_cast<Capability>(pCodePos[1]);
-                capabilities.insert(capability);
+                useVarPtrStorageBuf |= (capability == CapabilityVariablePointersStorageBuffer);
+                useVarPtr |= (capability == CapabilityVariablePointers);
                 break;
             }
         case OpDPdx:
@@ -110,7 +176,7 @@ Result ShaderModuleHelper::CollectInfoFromSpirvBinary(
         case OpNoLine:
         case OpModuleProcessed:
             {
-                *pDebugInfoSize += wordCount * sizeof(uint32_t);
+                isDebugInst = true;
                 break;
             }
         case OpSpecConstantTrue:
@@ -136,78 +202,51 @@ Result ShaderModuleHelper::CollectInfoFromSpirvBinary(
                 break;
             }
         }
+
+        if (trimDebugInfo && isDebugInst)
+        {
+            // Flush the preceding instructions, then hash the debug instruction into the original hash only.
+            flushPending(pCodePos);
+            hasher.Update(reinterpret_cast<const uint8_t*>(pCodePos), wordCount * sizeof(uint32_t));
+            pPending = pCodePos + wordCount;
+        }
+        else if (static_cast<size_t>(pCodePos + wordCount - pPending) >= MaxPendingWordCount)
+        {
+            flushPending(pCodePos + wordCount);
+        }
+
         pCodePos += wordCount;
     }
 
-    if (capabilities.find(CapabilityVariablePointersStorageBuffer) != capabilities.end())
+    if (result == Result::Success)
     {
-        pShaderModuleUsage->enableVarPtrStorageBuf = true;
-    }
+        flushPending(pEnd);
 
-    if (capabilities.find(CapabilityVariablePointers) != capabilities.end())
-    {
-        pShaderModuleUsage->enableVarPtr = true;
+        pShaderModuleUsage->enableVarPtrStorageBuf |= useVarPtrStorageBuf;
+        pShaderModuleUsage->enableVarPtr |= useVarPtr;
     }
 
-    return result;
-}
+    // Hash whatever is left (the tail of an invalid binary, or trailing bytes that do not form a whole word), so that
+    // the hash code of the original binary is always complete.
+    const size_t tailSize = pSpvBin->codeSize - VoidPtrDiff(pPending, pCode);
+    hasher.Update(reinterpret_cast<const uint8_t*>(pPending), tailSize);
 
-// =====================================================================================================================
-// Removes all debug instructions for SPIR-V binary.
-void ShaderModuleHelper::TrimSpirvDebugInfo(
-    const BinaryData* pSpvBin,       // [in] SPIR-V binay code
-    uint32_t          bufferSize,    // Output buffer size in bytes
-    void*             pTrimSpvBin)   // [out] Trimmed SPIR-V binary code
-{
-    assert(bufferSize > sizeof(SpirvHeader));
+    *pHash = {};
+    hasher.Finalize(pHash->bytes);
 
-    const uint32_t* pCode = reinterpret_cast<const uint32_t*>(pSpvBin->pCode);
-    const uint32_t* pEnd = pCode + pSpvBin->codeSize / sizeof(uint32_t);
-    const uint32_t* pCodePos = pCode + sizeof(SpirvHeader) / sizeof(uint32_t);
-
-    uint32_t* pTrimEnd = reinterpret_cast<uint32_t*>(VoidPtrInc(pTrimSpvBin, bufferSize));
-    (void(pTrimEnd)); // unused
-    uint32_t* pTrimCodePos = reinterpret_cast<uint32_t*>(VoidPtrInc(pTrimSpvBin, sizeof(SpirvHeader)));
-
-    // Copy SPIR-V header
-    memcpy(pTrimSpvBin, pCode, sizeof(SpirvHeader));
-
-    // Copy SPIR-V instructions
-    while (pCodePos < pEnd)
+    if (trimDebugInfo)
     {
-        uint32_t opCode = (pCodePos[0] & OpCodeMask);
-        uint32_t wordCount = (pCodePos[0] >> WordCountShift);
-        switch (opCode)
-        {
-        case OpString:
-        case OpSource:
-        case OpSourceContinued:
-        case OpSourceExtension:
-        case OpName:
-        case OpMemberName:
-        case OpLine:
-        case OpNop:
-        case OpNoLine:
-        case OpModuleProcessed:
-            {
-                // Skip debug instructions
-                break;
-            }
-        default:
-            {
-                // Copy other instructions
-                assert(pCodePos + wordCount <= pEnd);
-                assert(pTrimCodePos + wordCount <= pTrimEnd);
-                memcpy(pTrimCodePos, pCodePos, wordCount * sizeof(uint32_t));
-                pTrimCodePos += wordCount;
-                break;
-            }
-        }
-
-        pCodePos += wordCount;
+        *pTrimSize = static_cast<uint32_t>(trimWordCount * sizeof(uint32_t));
+        *pTrimHash = {};
+        trimHasher.Finalize(pTrimHash->bytes);
+    }
+    else
+    {
+        *pTrimSize = pSpvBin->codeSize;
+        *pTrimHash = *pHash;
     }
 
-    assert(pTrimCodePos == pTrimEnd);
+    return result;
 }
 
 // =====================================================================================================================
@@ -396,13 +435,7 @@ Result ShaderModuleHelper::VerifySpirvBinary(
 {
     Result result = Result::Success;
 
-#define _SPIRV_OP(x,...) Op##x,
-    static const std::set<Op> OpSet{
-       {
-        #include "SPIRVOpCodeEnum.h"
-       }
-    };
-#undef _SPIRV_OP
+    const std::bitset<OpCodeMask + 1>& supportedOpCodes = GetSupportedSpirvOpCodes();
 
     const uint32_t* pCode = reinterpret_cast<const uint32_t*>(pSpvBin->pCode);
     const uint32_t* pEnd = pCode + pSpvBin->codeSize / sizeof(uint32_t);
@@ -412,7 +445,7 @@ Result ShaderModuleHelper::VerifySpirvBinary(
 
     while (pCodePos < pEnd)
     {
-        Op opCode = static_cast<Op>(pCodePos[0] & OpCodeMask);
+        uint32_t opCode = (pCodePos[0] & OpCodeMask);
         uint32_t wordCount = (pCodePos[0] >> WordCountShift);
 
         if ((wordCount == 0) || (pCodePos + wordCount > pEnd))
@@ -421,7 +454,7 @@ Result ShaderModuleHelper::VerifySpirvBinary(
             break;
         }
 
-        if (OpSet.find(opCode) == OpSet.end())
+        if (supportedOpCodes[opCode] == false)
         {
             result = Result::ErrorInvalidShader;
             break;
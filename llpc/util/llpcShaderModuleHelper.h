@@ -32,6 +32,7 @@
 #pragma once
 #include <vector>
 #include "llpc.h"
+#include "llpcMetroHash.h"
 
 namespace Llpc
 {
@@ -67,16 +68,15 @@ struct ShaderEntryName
 class ShaderModuleHelper
 {
 public:
-    static Result CollectInfoFromSpirvBinary(
-        const BinaryData*             pSpvBinCode,
+    static Result ScanSpirvBinary(
+        const BinaryData*             pSpvBin,
         ShaderModuleUsage*            pShaderModuleUsage,
         std::vector<ShaderEntryName>& shaderEntryNames,
-        uint32_t*                     pDebugInfoSize);
-
-    static void TrimSpirvDebugInfo(
-        const BinaryData* pSpvBin,
-        uint32_t          bufferSize,
-        void*             pTrimSpvBin);
+        bool                          trimDebugInfo,
+        void*                         pTrimSpvBin,
+        uint32_t*                     pTrimSize,
+        MetroHash::Hash*              pHash,
+        MetroHash::Hash*              pTrimHash);
 
     static Result OptimizeSpirv(
         const BinaryData* pSpirvBinIn,
@@ -0,0 +1,253 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+ /**
+ ***********************************************************************************************************************
+ @file llpcThreadPool.cpp
+ @brief LLPC source file: contains implementation of class Llpc::ThreadPool.
+ ***********************************************************************************************************************
+*/
+#include "llpcThreadPool.h"
+#include <algorithm>
+#include <cassert>
+
+#define DEBUG_TYPE "llpc-thread-pool"
+
+namespace Llpc
+{
+
+// =====================================================================================================================
+// Runs the job on the calling thread, if it has not been started or cancelled yet.
+// Returns true if this call ran the job.
+bool ThreadPoolJob::TryRun()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_state != State::Pending)
+        {
+            return false;
+        }
+        m_state = State::Running;
+    }
+
+    m_task();
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_state = State::Finished;
+    }
+    m_stateCond.notify_all();
+    return true;
+}
+
+// =====================================================================================================================
+// Cancels the job, if it has not been started yet. Returns true if the job was cancelled.
+bool ThreadPoolJob::Cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_state != State::Pending)
+        {
+            return false;
+        }
+        m_state = State::Cancelled;
+    }
+    m_stateCond.notify_all();
+    return true;
+}
+
+// =====================================================================================================================
+// Waits for the job to finish or be cancelled. If it has not been started yet, it is run on the calling thread.
+void ThreadPoolJob::Wait()
+{
+    if (TryRun() == false)
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_stateCond.wait(lock, [this]{ return (m_state == State::Finished) || (m_state == State::Cancelled); });
+    }
+}
+
+// =====================================================================================================================
+ThreadPool::ThreadPool(
+    uint32_t threadCount)   // Count of worker threads, 0 to use the count of hardware threads
+    :
+    m_nextQueue(0)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        m_queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue));
+    }
+
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        m_workers.push_back(std::thread([this, i]{ RunWorker(i); }));
+    }
+}
+
+// =====================================================================================================================
+// Shuts down the worker threads. Jobs that have not started yet are cancelled.
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_idleLock);
+        m_shutdown = true;
+    }
+    m_idleCond.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+
+    for (auto& queue : m_queues)
+    {
+        for (auto& jobs : queue->jobs)
+        {
+            for (auto& job : jobs)
+            {
+                job->Cancel();
+            }
+        }
+    }
+}
+
+// =====================================================================================================================
+// Submits a job to run on a worker thread.
+void ThreadPool::Submit(
+    std::shared_ptr<ThreadPoolJob>  job,        // [in] Job to run
+    JobPriority                     priority)   // Priority of the job
+{
+    assert(priority < JobPriority::Count);
+
+    WorkerQueue& queue = *m_queues[m_nextQueue++ % m_queues.size()];
+    {
+        // NOTE: The job is queued and counted under the idle lock, so that it is always counted before a worker can
+        // take it.
+        std::lock_guard<std::mutex> idleLock(m_idleLock);
+        {
+            std::lock_guard<std::mutex> lock(queue.lock);
+            queue.jobs[static_cast<uint32_t>(priority)].push_back(std::move(job));
+        }
+        ++m_queuedCount;
+    }
+    m_idleCond.notify_one();
+}
+
+// =====================================================================================================================
+// Checks whether the calling thread is one of the pool's worker threads. A job that runs on a worker thread should run
+// the jobs it waits for itself, rather than submit them and wait for the other workers.
+bool ThreadPool::IsWorkerThread() const
+{
+    const std::thread::id threadId = std::this_thread::get_id();
+    for (const auto& worker : m_workers)
+    {
+        if (worker.get_id() == threadId)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// =====================================================================================================================
+// Takes the next job for the specified worker, from its own queue or by stealing from another worker's queue.
+// Returns nullptr if there are no queued jobs.
+std::shared_ptr<ThreadPoolJob> ThreadPool::TakeJob(
+    uint32_t workerIndex)   // Index of the worker thread
+{
+    const uint32_t queueCount = m_queues.size();
+    std::shared_ptr<ThreadPoolJob> job;
+    for (uint32_t priority = static_cast<uint32_t>(JobPriority::Count); (job == nullptr) && (priority-- > 0);)
+    {
+        for (uint32_t i = 0; (job == nullptr) && (i < queueCount); ++i)
+        {
+            WorkerQueue& queue = *m_queues[(workerIndex + i) % queueCount];
+            std::lock_guard<std::mutex> lock(queue.lock);
+            auto& jobs = queue.jobs[priority];
+            if (jobs.empty() == false)
+            {
+                if (i == 0)
+                {
+                    // Own queue: take the oldest job.
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                else
+                {
+                    // Another worker's queue: steal the newest job.
+                    job = std::move(jobs.back());
+                    jobs.pop_back();
+                }
+            }
+        }
+    }
+
+    if (job != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(m_idleLock);
+        assert(m_queuedCount > 0);
+        --m_queuedCount;
+    }
+    return job;
+}
+
+// =====================================================================================================================
+// Main loop of a worker thread.
+void ThreadPool::RunWorker(
+    uint32_t workerIndex)   // Index of the worker thread
+{
+    while (true)
+    {
+        {
+            // Stop as soon as the pool is shutting down; the destructor cancels the jobs that are still queued.
+            std::lock_guard<std::mutex> lock(m_idleLock);
+            if (m_shutdown)
+            {
+                break;
+            }
+        }
+
+        std::shared_ptr<ThreadPoolJob> job = TakeJob(workerIndex);
+        if (job != nullptr)
+        {
+            // This does nothing if the job was cancelled, or was run by a thread that waited for it.
+            job->TryRun();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_idleLock);
+        m_idleCond.wait(lock, [this]{ return m_shutdown || (m_queuedCount > 0); });
+        if (m_shutdown)
+        {
+            break;
+        }
+    }
+}
+
+} // Llpc
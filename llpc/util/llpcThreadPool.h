@@ -0,0 +1,143 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ @file llpcThreadPool.h
+ @brief LLPC header file: contains declaration of class Llpc::ThreadPool.
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Llpc
+{
+
+// Enumerates priorities of thread pool jobs. A job of higher priority is always started before a job of lower
+// priority, wherever in the pool it is queued.
+enum class JobPriority : uint32_t
+{
+    Low = 0,        // Low priority
+    Normal,         // Normal priority
+    High,           // High priority
+    Count
+};
+
+// =====================================================================================================================
+// Represents a job that is run by ThreadPool. A job that has not started yet can be cancelled, or can be run by
+// whichever thread waits for it first, rather than waiting for a worker thread to get to it.
+class ThreadPoolJob
+{
+public:
+    ThreadPoolJob(std::function<void()> task) : m_task(std::move(task)) {}
+
+    bool TryRun();
+    bool Cancel();
+    void Wait();
+
+    // Checks whether the job has finished running
+    bool IsFinished()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_state == State::Finished;
+    }
+
+    // Checks whether the job was cancelled before it started
+    bool IsCancelled()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_state == State::Cancelled;
+    }
+
+private:
+    ThreadPoolJob() = delete;
+    ThreadPoolJob(const ThreadPoolJob&) = delete;
+    ThreadPoolJob& operator=(const ThreadPoolJob&) = delete;
+
+    // Enumerates states of a job
+    enum class State : uint32_t
+    {
+        Pending,    // Not started yet
+        Running,    // Being run by some thread
+        Finished,   // Finished running
+        Cancelled,  // Cancelled before it started
+    };
+
+    std::function<void()>   m_task;                     // Task to run
+    std::mutex              m_lock;                     // Lock for the job state
+    std::condition_variable m_stateCond;                // Signalled when the job finishes or is cancelled
+    State                   m_state = State::Pending;   // Job state
+};
+
+// =====================================================================================================================
+// Represents a pool of worker threads with a work-stealing job queue. Each worker has its own queue per priority, and
+// submitted jobs are spread over the workers' queues. A worker takes jobs from the front of its own queue, and when
+// that has nothing of the current priority, it steals from the back of the other workers' queues, before moving on to
+// the next lower priority.
+class ThreadPool
+{
+public:
+    ThreadPool(uint32_t threadCount);
+    ~ThreadPool();
+
+    void Submit(std::shared_ptr<ThreadPoolJob> job, JobPriority priority);
+    bool IsWorkerThread() const;
+
+private:
+    ThreadPool() = delete;
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Job queues of one worker thread
+    struct WorkerQueue
+    {
+        std::mutex                                  lock;   // Lock for the queues
+        std::deque<std::shared_ptr<ThreadPoolJob>>  jobs[static_cast<uint32_t>(JobPriority::Count)]; // Per-priority
+                                                                                                       //  job queues
+    };
+
+    void RunWorker(uint32_t workerIndex);
+    std::shared_ptr<ThreadPoolJob> TakeJob(uint32_t workerIndex);
+
+    // -----------------------------------------------------------------------------------------------------------------
+
+    std::vector<std::unique_ptr<WorkerQueue>>   m_queues;           // Job queues, one per worker thread
+    std::vector<std::thread>                    m_workers;          // Worker threads
+    std::atomic<uint32_t>                       m_nextQueue;        // Queue to submit the next job to
+    uint32_t                                    m_queuedCount = 0;  // Count of jobs in all queues, guarded by
+                                                                    //  m_idleLock
+    std::mutex                                  m_idleLock;         // Lock for idle workers
+    std::condition_variable                     m_idleCond;         // Signalled when a job is submitted
+    bool                                        m_shutdown = false; // Whether the pool is shutting down
+};
+
+} // Llpc
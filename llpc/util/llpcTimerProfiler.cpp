@@ -134,6 +134,13 @@ TimerProfiler::~TimerProfiler()
     }
 }
 
+// =====================================================================================================================
+// Checks whether timer profiling is enabled.
+bool TimerProfiler::IsEnabled()
+{
+    return (TimePassesIsEnabled || cl::EnableTimerProfile);
+}
+
 // =====================================================================================================================
 // Adds pass to start or stop timer in PassManager
 void TimerProfiler::AddTimerStartStopPass(
@@ -72,6 +72,8 @@ public:
 
     static const llvm::StringMap<llvm::TimeRecord>& GetDummyTimeRecords();
 
+    static bool IsEnabled();
+
     // -----------------------------------------------------------------------------------------------------------------
 
     static const uint32_t PipelineTimerEnableMask = ((1 << TimerCount) - 1);
@@ -49,6 +49,9 @@ static const uint32_t DescRelocMagic        = 0xA5A5A500;
 static const uint32_t DescRelocMagicMask    = 0xFFFFFF00;
 static const uint32_t DescSetMask           = 0x000000FF;
 
+// Prefix of the relocation symbols of descriptor offsets in relocatable shader ELF
+static const char DescOffsetRelocPrefix[] = "doff_";
+
 // Gets the name string of shader stage.
 const char* GetShaderStageName(ShaderStage shaderStage);
 